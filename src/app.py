@@ -40,8 +40,10 @@ def result():
         orig_index = lines.index("Original AST:\n") + 1
         opt_index = lines.index("Optimized AST:\n") + 1
 
+        diff_index = lines.index("AST Diff:\n") + 1 if "AST Diff:\n" in lines else len(lines) + 1
+
         orig_ast_text = ''.join(lines[orig_index:opt_index - 1])
-        opt_ast_text = ''.join(lines[opt_index:])
+        opt_ast_text = ''.join(lines[opt_index:diff_index - 1])
 
         # Read original C code
         with open('input.c', 'r') as f:
@@ -1,11 +1,44 @@
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include "ast.h"
+#include "memtrack.h"
+#include "srcloc.h"
+
+
+static int next_node_id = 1;
+static uint32_t current_loc = 0;
+
+
+// Called by the parser before each reduction, so nodes built by a rule's
+// action start at the first token of that rule.
+void ast_set_location(uint32_t loc) {
+    current_loc = loc;
+}
+
+
+// Only once every node has been freed, so ids cannot collide.
+void ast_reset_ids(void) {
+    __atomic_store_n(&next_node_id, 1, __ATOMIC_RELAXED);
+}
+
+
+// Every kind gets left and right; only a for loop needs the slots after them
+static size_t node_size(NodeType type) {
+    int slots = ast_slot_count(type);
+    return offsetof(ASTNode, child) + (slots > 2 ? slots : 2) * sizeof(ASTNode*);
+}
+
+
+static long node_bytes(NodeType type, const char* value) {
+    return (long)node_size(type) + (value ? (long)strlen(value) + 1 : 0);
+}
 
 
 ASTNode* create_node(NodeType type, const char* value) {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
+    size_t size = node_size(type);
+    ASTNode* node = (ASTNode*)malloc(size);
     if (!node) {
         fprintf(stderr, "Memory allocation failed\n");
         exit(1);
@@ -13,25 +46,107 @@ ASTNode* create_node(NodeType type, const char* value) {
     
     node->type = type;
     node->value = value ? strdup(value) : NULL;
-    node->left = NULL;
-    node->right = NULL;
+    memset(node->child, 0, size - offsetof(ASTNode, child));
     node->next = NULL;
+    node->loc = current_loc;
+    node->id = __atomic_fetch_add(&next_node_id, 1, __ATOMIC_RELAXED);
+    node->origin = node->id;
+    node->pass = PASS_PARSE;
+    node->kinds = 0;
+    node->owner = (uint8_t)mem_current();
+    mem_charge(node->owner, 1, node_bytes(type, node->value));
     
     return node;
 }
 
 
+// Replaces the node's text, keeping its owner's byte count right
+void ast_set_value(ASTNode* node, const char* value) {
+    mem_charge(node->owner, 0, node_bytes(node->type, value) - node_bytes(node->type, node->value));
+    free(node->value);
+    node->value = value ? strdup(value) : NULL;
+}
+
+
+int ast_slot_count(NodeType type) {
+    switch (type) {
+        case NODE_FOR:
+            return 4;
+        case NODE_BINOP:
+        case NODE_SEQ:
+        case NODE_IF:
+        case NODE_FUNC_DEF:
+            return 2;
+        case NODE_DECL:
+        case NODE_ASSIGN:
+        case NODE_UNARY:
+        case NODE_RETURN:
+        case NODE_FUNC_CALL:
+        case NODE_EXPR_LIST:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+
+/* Any of a loop's slots may be empty, so print_ast() writes a placeholder
+   line for the empty ones and readers of the output find each slot by
+   position. */
+bool ast_prints_empty_slots(NodeType type) {
+    return type == NODE_FOR;
+}
+
+
+// Kinds whose passes read a name, operator or literal from the value
+bool ast_has_value(NodeType type) {
+    switch (type) {
+        case NODE_IF:
+        case NODE_FOR:
+        case NODE_RETURN:
+        case NODE_EXPR_LIST:
+        case NODE_SEQ:
+            return false;
+        default:
+            return true;
+    }
+}
+
+
+// Records that `node` was produced by `pass` as a rewrite of `from`.
+ASTNode* derive_node(ASTNode* node, ASTNode* from, OptPass pass) {
+    if (!node || !from) return node;
+
+    node->loc = from->loc;
+    node->origin = from->origin;
+    node->pass = pass;
+    return node;
+}
+
+
+void derive_tree(ASTNode* node, OptPass pass) {
+    if (!node) return;
+
+    node->pass = pass;
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        derive_tree(node->child[i], pass);
+    }
+    derive_tree(node->next, pass);
+}
+
+
 void add_child(ASTNode* parent, ASTNode* child) {
     if (!parent || !child) return;
-    
-    if (!parent->left) {
-        parent->left = child;
-    } else if (!parent->right) {
-        parent->right = child;
-    } else {
-       
-        add_sibling(parent->right, child);
+
+    // Fills the first free slot; past the last one, children become a list
+    int slots = ast_slot_count(parent->type);
+    for (int i = 0; i < slots; i++) {
+        if (!parent->child[i]) {
+            parent->child[i] = child;
+            return;
+        }
     }
+    if (slots > 0) add_sibling(parent->child[slots - 1], child);
 }
 
 
@@ -53,12 +168,6 @@ static char* int_to_str(int value) {
 }
 
 
-static char* char_to_str(char c) {
-    char buffer[2] = {c, '\0'};
-    return strdup(buffer);
-}
-
-
 ASTNode* make_int_node(int value) {
     char* val_str = int_to_str(value);
     ASTNode* node = create_node(NODE_INT, val_str);
@@ -77,11 +186,9 @@ ASTNode* make_var_node(char* name) {
 }
 
 
-ASTNode* make_binop_node(char op, ASTNode* left, ASTNode* right) {
-    char* op_str = char_to_str(op);
-    ASTNode* node = create_node(NODE_BINOP, op_str);
-    free(op_str);
-    
+ASTNode* make_binop_node(const char* op, ASTNode* left, ASTNode* right) {
+    ASTNode* node = create_node(NODE_BINOP, op);
+
     node->left = left;
     node->right = right;
     
@@ -103,6 +210,13 @@ ASTNode* make_decl_node(char* name, ASTNode* init_expr) {
 }
 
 
+ASTNode* make_assign_node(char* name, ASTNode* value) {
+    ASTNode* node = create_node(NODE_ASSIGN, name);
+    node->left = value;
+    return node;
+}
+
+
 ASTNode* make_func_call_node(char* name, ASTNode* args) {
     ASTNode* node = create_node(NODE_FUNC_CALL, name);
     node->left = args;  
@@ -110,13 +224,19 @@ ASTNode* make_func_call_node(char* name, ASTNode* args) {
 }
 
 
-ASTNode* make_function_node(char* name, ASTNode* body) {
+ASTNode* make_function_node(char* name, ASTNode* params, ASTNode* body) {
     ASTNode* node = create_node(NODE_FUNC_DEF, name);
     node->left = body; 
+    node->right = params;  
     return node;
 }
 
 
+ASTNode* make_param_node(char* name) {
+    return create_node(NODE_PARAM, name);
+}
+
+
 ASTNode* make_if_node(ASTNode* condition, ASTNode* then_body) {
     ASTNode* node = create_node(NODE_IF, NULL);
     node->left = condition;   
@@ -129,17 +249,10 @@ ASTNode* make_for_node(ASTNode* init, ASTNode* condition, ASTNode* update, ASTNo
     ASTNode* node = create_node(NODE_FOR, NULL);
     
    
-    node->left = init;
-    
-    node->right = condition;
-    
-    if (condition) {
-        add_sibling(condition, update);
-        if (update) {
-            add_sibling(update, body);
-        }
-    }
-    
+    node->child[FOR_INIT] = init;
+    node->child[FOR_COND] = condition;
+    node->child[FOR_UPDATE] = update;
+    node->child[FOR_BODY] = body;
     return node;
 }
 
@@ -187,6 +300,8 @@ const char* get_node_type_str(NodeType type) {
         case NODE_EXPR_LIST: return "EXPR_LIST";
         case NODE_SEQ: return "SEQUENCE";
         case NODE_TYPE: return "TYPE";
+        case NODE_PARAM: return "PARAM";
+        case NODE_ASSIGN: return "ASSIGNMENT";
         default: return "UNKNOWN";
     }
 }
@@ -207,12 +322,11 @@ void print_ast(ASTNode* node, FILE* output, int indent) {
     }
     fprintf(output, "\n");
 
-    if (node->left) {
-        print_ast(node->left, output, indent + 1);
-    }
-    
-    if (node->right) {
-        print_ast(node->right, output, indent + 1);
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        if (!node->child[i] && ast_prints_empty_slots(node->type)) {
+            fprintf(output, "%*s%s\n", 2 * (indent + 1), "", AST_EMPTY_SLOT);
+        }
+        print_ast(node->child[i], output, indent + 1);
     }
     
  
@@ -222,19 +336,93 @@ void print_ast(ASTNode* node, FILE* output, int indent) {
 }
 
 
+const char* get_pass_str(OptPass pass) {
+    switch (pass) {
+        case PASS_PARSE: return "parse";
+        case PASS_FOLD: return "fold";
+        case PASS_DCE: return "dce";
+        case PASS_UNROLL: return "unroll";
+        case PASS_INLINE: return "inline";
+        case PASS_PROPAGATE: return "propagate";
+        case PASS_LICM: return "licm";
+        case PASS_FUSION: return "fusion";
+        case PASS_FISSION: return "fission";
+        case PASS_SIMD: return "simd";
+        default: return "unknown";
+    }
+}
+
+
+static void index_origins(ASTNode* node, int* index_of, int* counter) {
+    if (!node) return;
+
+    if (node->origin > 0 && node->origin < next_node_id) {
+        index_of[node->origin] = *counter;
+    }
+    (*counter)++;
+
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        if (!node->child[i] && ast_prints_empty_slots(node->type)) (*counter)++;
+        index_origins(node->child[i], index_of, counter);
+    }
+    index_origins(node->next, index_of, counter);
+}
+
+
+static void print_derived(ASTNode* node, int* index_of, int* counter, FILE* output) {
+    if (!node) return;
+
+    int index = (*counter)++;
+    if (node->pass != PASS_PARSE) {
+        int origin = node->origin > 0 && node->origin < next_node_id ? index_of[node->origin] : -1;
+        int line = 0;
+        int column = 0;
+        srcloc_lookup(node->loc, &line, &column);
+        fprintf(output, "%d %s %d %d:%d\n", index, get_pass_str(node->pass),
+                origin, line, column);
+    }
+
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        if (!node->child[i] && ast_prints_empty_slots(node->type)) (*counter)++;
+        print_derived(node->child[i], index_of, counter, output);
+    }
+    print_derived(node->next, index_of, counter, output);
+}
+
+
+/* One line per optimized node that a pass produced:
+   "<optimized index> <pass> <original index> <line>:<column>", indices
+   counting lines of the print_ast() sections and -1 for an origin that no
+   longer appears in the original tree. */
+void print_provenance(ASTNode* original, ASTNode* optimized, FILE* output) {
+    int* index_of = (int*)malloc(next_node_id * sizeof(int));
+    if (!index_of) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < next_node_id; i++) {
+        index_of[i] = -1;
+    }
+
+    int counter = 0;
+    index_origins(original, index_of, &counter);
+
+    counter = 0;
+    print_derived(optimized, index_of, &counter, output);
+    free(index_of);
+}
+
+
 void free_ast(ASTNode* node) {
     if (!node) return;
     
+    mem_charge(node->owner, -1, -node_bytes(node->type, node->value));
     if (node->value) {
         free(node->value);
     }
     
-    if (node->left) {
-        free_ast(node->left);
-    }
-    
-    if (node->right) {
-        free_ast(node->right);
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        free_ast(node->child[i]);
     }
     
     if (node->next) {
@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 
 typedef enum {
@@ -20,16 +22,66 @@ typedef enum {
     NODE_RETURN,
     NODE_EXPR_LIST,
     NODE_SEQ,
-    NODE_TYPE
+    NODE_TYPE,
+    NODE_PARAM,
+    NODE_ASSIGN
 } NodeType;
 
 
+typedef enum {
+    PASS_PARSE,
+    PASS_FOLD,
+    PASS_DCE,
+    PASS_UNROLL,
+    PASS_INLINE,
+    PASS_PROPAGATE,
+    PASS_LICM,
+    PASS_FUSION,
+    PASS_FISSION,
+    PASS_SIMD
+} OptPass;
+
+#define OPT_PASS_COUNT (PASS_SIMD + 1)
+
+
+/* Children live in fixed slots, `left` and `right` naming the first two.
+   A for loop is the only kind using more than two:
+     FOR         init, cond, update, body
+     IF          left = condition, right = body
+     FUNC_DEF    left = body, right = parameters
+     FUNC_CALL   left = arguments
+     BINOP, SEQ  left, right
+     DECL, ASSIGN, UNARY, RETURN, EXPR_LIST    left
+   `next` only links the entries of a list: statements, parameters and
+   arguments. Slots come last and only a for loop is allocated with all
+   four, so other kinds have just left and right. */
+#define AST_SLOTS 4
+
+enum {
+    FOR_INIT,
+    FOR_COND,
+    FOR_UPDATE,
+    FOR_BODY
+};
+
+
 typedef struct ASTNode {
     NodeType type;
+    uint32_t loc;          // source offset of the node's first token, see srcloc.h
     char* value;           
-    struct ASTNode* left;  
-    struct ASTNode* right; 
     struct ASTNode* next;  
+    int id;                // unique per node
+    int origin;            // id of the parsed node this one derives from
+    OptPass pass;          // pass that produced the node
+    uint16_t kinds;        // kinds in the subtree, 0 until computed; see visitor.h
+    uint8_t owner;         // MemSubsystem the node is charged to, see memtrack.h
+    union {
+        struct ASTNode* child[AST_SLOTS];   // the first ast_slot_count() are in use
+        struct {
+            struct ASTNode* left;
+            struct ASTNode* right;
+        };
+    };
 } ASTNode;
 
 
@@ -40,15 +92,19 @@ ASTNode* make_string_node(char* value);
 
 ASTNode* make_var_node(char* name);
 
-ASTNode* make_binop_node(char op, ASTNode* left, ASTNode* right);
+ASTNode* make_binop_node(const char* op, ASTNode* left, ASTNode* right);
 
 ASTNode* make_unary_node(char* op, ASTNode* expr);
 
 ASTNode* make_decl_node(char* name, ASTNode* init_expr);
 
+ASTNode* make_assign_node(char* name, ASTNode* value);
+
 ASTNode* make_func_call_node(char* name, ASTNode* args);
 
-ASTNode* make_function_node(char* name, ASTNode* body);
+ASTNode* make_function_node(char* name, ASTNode* params, ASTNode* body);
+
+ASTNode* make_param_node(char* name);
 
 
 ASTNode* make_if_node(ASTNode* condition, ASTNode* then_body);
@@ -68,10 +124,54 @@ ASTNode* make_type_node(char* type_name);
 
 ASTNode* create_node(NodeType type, const char* value);
 
+void ast_set_value(ASTNode* node, const char* value);
+
+int ast_slot_count(NodeType type);
+
+#define AST_EMPTY_SLOT "EMPTY"
+
+bool ast_prints_empty_slots(NodeType type);
+
+bool ast_has_value(NodeType type);
+
+void ast_set_location(uint32_t loc);
+
+void ast_reset_ids(void);
+
+ASTNode* derive_node(ASTNode* node, ASTNode* from, OptPass pass);
+
+void derive_tree(ASTNode* node, OptPass pass);
+
+const char* get_pass_str(OptPass pass);
+
 ASTNode* optimize_ast(ASTNode* root);
 
+ASTNode* optimize_ast_cached(ASTNode* root, const char* cache_path);
+
+/* Totals since the last reset_opt_stats(); pass times are summed over the
+   worker threads, `seconds` is the wall time spent in optimize_ast(). */
+typedef struct {
+    double seconds;
+    double pass_seconds[OPT_PASS_COUNT];
+    unsigned long folded;       // operators replaced by their constant value
+    unsigned long eliminated;   // nodes removed as dead or unreachable code
+    unsigned long unrolled;     // loops replaced by copies of their body
+    unsigned long copied;       // nodes created by deep_copy_ast()
+    long peak_nodes;            // most AST nodes alive at once, see reset_mem_peaks()
+} OptStats;
+
+void reset_opt_stats(void);
+
+void get_opt_stats(OptStats* stats);
+
+void print_opt_stats_json(const OptStats* stats, FILE* output, int indent);
+
 ASTNode* deep_copy_ast(ASTNode* node);
 
+bool eval_binop(const char* op, int left, int right, int* result);
+
+ASTNode* fold_constants(ASTNode* node);
+
 void add_child(ASTNode* parent, ASTNode* child);
 void add_sibling(ASTNode* node, ASTNode* sibling);
 
@@ -80,4 +180,6 @@ void free_ast(ASTNode* node);
 
 void print_ast(ASTNode* node, FILE* output, int indent);
 
+void print_provenance(ASTNode* original, ASTNode* optimized, FILE* output);
+
 #endif
\ No newline at end of file
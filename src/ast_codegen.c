@@ -3,25 +3,25 @@
 #include <string.h>
 
 #define MAX_CHILDREN 10
-#define MAX_LINE 512
 
 typedef enum {
     NODE_FUNCTION_DEF, NODE_SEQUENCE, NODE_DECLARATION,
     NODE_INT, NODE_VAR, NODE_STRING,
     NODE_BINARY_EXPR, NODE_UNARY_EXPR,
     NODE_IF_STMT, NODE_FOR_STMT, NODE_FUNCTION_CALL,
-    NODE_EXPR_LIST, NODE_RETURN_STMT,
-    NODE_UNKNOWN
+    NODE_EXPR_LIST, NODE_RETURN_STMT, NODE_PARAM, NODE_ASSIGNMENT,
+    NODE_EMPTY, NODE_UNKNOWN
 } NodeType;
 
 typedef struct ASTNode {
     NodeType type;
-    char name[64];              // For VAR, FUNC names
+    char name[64];              // For VAR, FUNC names and operators
     char string_value[128];     // For STRING ("...")
     int int_value;              // For INT (n)
     struct ASTNode *children[MAX_CHILDREN];
     int child_count;
     int indent;
+    struct ASTNode *next;       // Next top-level function
 } ASTNode;
 
 // Helper to detect node type
@@ -39,6 +39,9 @@ NodeType get_node_type(const char *line) {
     if (strstr(line, "FUNCTION_CALL")) return NODE_FUNCTION_CALL;
     if (strstr(line, "EXPR_LIST")) return NODE_EXPR_LIST;
     if (strstr(line, "RETURN_STMT")) return NODE_RETURN_STMT;
+    if (strstr(line, "PARAM (")) return NODE_PARAM;
+    if (strstr(line, "ASSIGNMENT (")) return NODE_ASSIGNMENT;
+    if (strcmp(line + strspn(line, " "), "EMPTY\n") == 0) return NODE_EMPTY;
     return NODE_UNKNOWN;
 }
 
@@ -60,7 +63,10 @@ ASTNode *create_node(const char *line) {
     const char *p = strchr(line, '(');
     if (p) {
         if (node->type == NODE_DECLARATION || node->type == NODE_FUNCTION_DEF ||
-            node->type == NODE_FUNCTION_CALL || node->type == NODE_VAR) {
+            node->type == NODE_FUNCTION_CALL || node->type == NODE_VAR ||
+            node->type == NODE_PARAM || node->type == NODE_ASSIGNMENT ||
+            node->type == NODE_BINARY_EXPR || node->type == NODE_UNARY_EXPR ||
+            node->type == NODE_FOR_STMT) {
             sscanf(p + 1, "%[^)]", node->name);
         } else if (node->type == NODE_STRING) {
             sscanf(p + 1, " \"%[^\"]", node->string_value);
@@ -79,13 +85,18 @@ void add_child(ASTNode *parent, ASTNode *child) {
 }
 
 ASTNode *parse_ast(FILE *fp) {
-    char line[MAX_LINE];
-    ASTNode *stack[100];
+    char *line = NULL;
+    size_t line_size = 0;
+    int capacity = 100;
+    ASTNode **stack = malloc(capacity * sizeof(ASTNode *));
     int top = -1;
 
     int in_optimized_ast = 0;
+    ASTNode *root = NULL;
+    ASTNode *last = NULL;
 
-    while (fgets(line, sizeof(line), fp)) {
+    // Indentation grows with nesting, so lines have no fixed bound
+    while (getline(&line, &line_size, fp) != -1) {
         if (!in_optimized_ast) {
             if (strstr(line, "Optimized AST:")) {
                 in_optimized_ast = 1;
@@ -93,6 +104,8 @@ ASTNode *parse_ast(FILE *fp) {
             continue;
         }
 
+        if (strstr(line, "AST Diff:")) break; // end of the optimized tree
+
         if (strlen(line) < 2) continue; // skip blank lines
 
         ASTNode *node = create_node(line);
@@ -102,11 +115,22 @@ ASTNode *parse_ast(FILE *fp) {
 
         if (top >= 0)
             add_child(stack[top], node);
-
+        else if (last)
+            last = last->next = node;
+        else
+            root = last = node;
+
+        // Long statement lists nest one SEQUENCE per statement
+        if (top + 1 == capacity) {
+            capacity *= 2;
+            stack = realloc(stack, capacity * sizeof(ASTNode *));
+        }
         stack[++top] = node;
     }
 
-    return (top >= 0) ? stack[0] : NULL;
+    free(stack);
+    free(line);
+    return root;
 }
 
 // Utility for indentation
@@ -115,6 +139,19 @@ void print_indent(int level) {
         printf("    ");
 }
 
+void print_expr(ASTNode *node);
+
+// Calls hold one EXPR_LIST child per argument
+void print_call(ASTNode *node) {
+    printf("%s(", node->name);
+    for (int i = 0; i < node->child_count; ++i) {
+        if (i > 0)
+            printf(", ");
+        print_expr(node->children[i]);
+    }
+    printf(")");
+}
+
 // Expression printer
 void print_expr(ASTNode *node) {
     if (!node) return;
@@ -132,14 +169,21 @@ void print_expr(ASTNode *node) {
         case NODE_BINARY_EXPR:
             printf("(");
             print_expr(node->children[0]);
-            printf(" + "); // simplified
+            printf(" %s ", node->name);
             print_expr(node->children[1]);
             printf(")");
             break;
         case NODE_UNARY_EXPR:
-            printf("++");
+            print_expr(node->children[0]);
+            printf("%s", node->name);
+            break;
+        case NODE_ASSIGNMENT:
+            printf("%s = ", node->name);
             print_expr(node->children[0]);
             break;
+        case NODE_FUNCTION_CALL:
+            print_call(node);
+            break;
         case NODE_EXPR_LIST:
             for (int i = 0; i < node->child_count; ++i) {
                 print_expr(node->children[i]);
@@ -152,17 +196,90 @@ void print_expr(ASTNode *node) {
     }
 }
 
+// Loop header clauses: a declaration, an assignment or a plain expression.
+// The outermost operator is printed bare, which is the canonical loop form
+// OpenMP requires for `#pragma omp simd`.
+void print_clause(ASTNode *node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case NODE_DECLARATION:
+            printf("int %s", node->name);
+            if (node->child_count > 0) {
+                printf(" = ");
+                print_clause(node->children[0]);
+            }
+            break;
+        case NODE_ASSIGNMENT:
+            printf("%s = ", node->name);
+            print_clause(node->children[0]);
+            break;
+        case NODE_BINARY_EXPR:
+            print_expr(node->children[0]);
+            printf(" %s ", node->name);
+            print_expr(node->children[1]);
+            break;
+        default:
+            print_expr(node);
+            break;
+    }
+}
+
+// Loops proven free of dependences are labelled "simd", followed by one
+// "<op>:<var>" entry per reduction variable
+void print_simd_pragma(ASTNode *node, int indent) {
+    if (strncmp(node->name, "simd", 4) != 0) return;
+
+    print_indent(indent);
+    printf("#pragma omp simd");
+    char clauses[64];
+    strcpy(clauses, node->name + 4);
+    for (char *clause = strtok(clauses, " "); clause; clause = strtok(NULL, " "))
+        printf(" reduction(%s)", clause);
+    printf("\n");
+}
+
+void generate_code(ASTNode *node, int indent);
+
+// A FOR_STMT has init, condition, update and body in that order, each of
+// them an EMPTY line when missing
+void generate_for(ASTNode *node, int indent) {
+    if (node->child_count != 4) return;
+
+    print_simd_pragma(node, indent);
+    print_indent(indent);
+    printf("for (");
+    print_clause(node->children[0]);
+    printf("; ");
+    print_clause(node->children[1]);
+    printf("; ");
+    print_clause(node->children[2]);
+    printf(") {\n");
+    generate_code(node->children[3], indent + 1);
+    print_indent(indent);
+    printf("}\n");
+}
+
 // Code generator
 void generate_code(ASTNode *node, int indent) {
     if (!node) return;
 
     switch (node->type) {
-        case NODE_FUNCTION_DEF:
-            printf("int %s() {\n", node->name);
-            for (int i = 0; i < node->child_count; ++i)
-                generate_code(node->children[i], indent + 1);
+        case NODE_FUNCTION_DEF: {
+            int params = 0;
+            printf("int %s(", node->name);
+            for (int i = 0; i < node->child_count; ++i) {
+                if (node->children[i]->type == NODE_PARAM)
+                    printf("%sint %s", params++ ? ", " : "", node->children[i]->name);
+            }
+            printf(") {\n");
+            for (int i = 0; i < node->child_count; ++i) {
+                if (node->children[i]->type != NODE_PARAM)
+                    generate_code(node->children[i], indent + 1);
+            }
             printf("}\n");
             break;
+        }
 
         case NODE_SEQUENCE:
             for (int i = 0; i < node->child_count; ++i)
@@ -171,17 +288,31 @@ void generate_code(ASTNode *node, int indent) {
 
         case NODE_DECLARATION:
             print_indent(indent);
-            printf("int %s = ", node->name);
-            print_expr(node->children[0]);
+            print_clause(node);
             printf(";\n");
             break;
 
+        case NODE_IF_STMT:
+            print_indent(indent);
+            printf("if (");
+            print_expr(node->children[0]);
+            printf(") {\n");
+            for (int i = 1; i < node->child_count; ++i)
+                generate_code(node->children[i], indent + 1);
+            print_indent(indent);
+            printf("}\n");
+            break;
+
+        case NODE_FOR_STMT:
+            generate_for(node, indent);
+            break;
+
         case NODE_FUNCTION_CALL:
+        case NODE_ASSIGNMENT:
+        case NODE_UNARY_EXPR:
             print_indent(indent);
-            printf("%s(", node->name);
-            if (node->child_count > 0)
-                print_expr(node->children[0]);
-            printf(");\n");
+            print_expr(node);
+            printf(";\n");
             break;
 
         case NODE_RETURN_STMT:
@@ -212,6 +343,7 @@ int main() {
         return 1;
     }
 
-    generate_code(root, 0);
+    for (ASTNode *node = root; node; node = node->next)
+        generate_code(node, 0);
     return 0;
 }
@@ -0,0 +1,470 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ast_diff.h"
+
+/* GumTree-style matcher. Both trees are flattened in print_ast() order so
+   every subtree is a contiguous span, then:
+     1. identical subtrees (by structural hash) are matched top-down, tallest
+        first,
+     2. containers are matched bottom-up from their matched children,
+     3. leftover children of matched parents are paired by type.
+   Each node is queued, looked up and opened once, so apart from sorting
+   each height's queue the whole thing is linear. */
+
+#define MIN_HEIGHT 2
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+
+typedef struct {
+    ASTNode** nodes;
+    int* parent;
+    int* size;
+    int* height;
+    uint64_t* hash;
+    int* match;
+    int* line;              // in the print_ast() section, placeholders included
+    int count;
+    int capacity;
+    int lines;
+} DiffTree;
+
+
+static void* diff_alloc(void* ptr, size_t size) {
+    void* mem = realloc(ptr, size);
+    if (!mem) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return mem;
+}
+
+
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t len) {
+    const unsigned char* p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+
+static int same_value(ASTNode* a, ASTNode* b) {
+    if (!a->value || !b->value) return a->value == b->value;
+    return strcmp(a->value, b->value) == 0;
+}
+
+
+static int flatten(DiffTree* tree, ASTNode* node, int parent) {
+    if (tree->count == tree->capacity) {
+        tree->capacity = tree->capacity ? tree->capacity * 2 : 64;
+        tree->nodes = diff_alloc(tree->nodes, tree->capacity * sizeof(ASTNode*));
+        tree->parent = diff_alloc(tree->parent, tree->capacity * sizeof(int));
+        tree->size = diff_alloc(tree->size, tree->capacity * sizeof(int));
+        tree->height = diff_alloc(tree->height, tree->capacity * sizeof(int));
+        tree->hash = diff_alloc(tree->hash, tree->capacity * sizeof(uint64_t));
+        tree->match = diff_alloc(tree->match, tree->capacity * sizeof(int));
+        tree->line = diff_alloc(tree->line, tree->capacity * sizeof(int));
+    }
+
+    int index = tree->count++;
+    tree->nodes[index] = node;
+    tree->parent[index] = parent;
+    tree->match[index] = -1;
+    tree->line[index] = tree->lines++;
+
+    uint64_t h = hash_bytes(FNV_OFFSET, &node->type, sizeof(node->type));
+    if (node->value) {
+        h = hash_bytes(h, node->value, strlen(node->value));
+    }
+
+    int size = 1;
+    int height = 1;
+    for (int k = 0; k < ast_slot_count(node->type); k++) {
+        if (!node->child[k] && ast_prints_empty_slots(node->type)) tree->lines++;
+        for (ASTNode* child = node->child[k]; child; child = child->next) {
+            int c = flatten(tree, child, index);
+            size += tree->size[c];
+            if (tree->height[c] >= height) height = tree->height[c] + 1;
+            h = hash_bytes(h, &tree->hash[c], sizeof(uint64_t));
+        }
+    }
+
+    tree->size[index] = size;
+    tree->height[index] = height;
+    tree->hash[index] = h;
+    return index;
+}
+
+
+static void free_tree(DiffTree* tree) {
+    free(tree->nodes);
+    free(tree->parent);
+    free(tree->size);
+    free(tree->height);
+    free(tree->hash);
+    free(tree->match);
+    free(tree->line);
+}
+
+
+static void link_nodes(DiffTree* a, int i, DiffTree* b, int j) {
+    a->match[i] = j;
+    b->match[j] = i;
+}
+
+
+/* True when both spans hold the same shape and labels and no node of the
+   original span has been claimed yet. */
+static int same_subtree(DiffTree* a, int i, DiffTree* b, int j) {
+    if (a->size[i] != b->size[j] || a->hash[i] != b->hash[j]) return 0;
+
+    for (int k = 0; k < a->size[i]; k++) {
+        ASTNode* x = a->nodes[i + k];
+        ASTNode* y = b->nodes[j + k];
+        if (a->match[i + k] >= 0 || x->type != y->type || !same_value(x, y)) return 0;
+        if (k > 0 && a->parent[i + k] - i != b->parent[j + k] - j) return 0;
+    }
+    return 1;
+}
+
+
+/* Subtrees waiting to be compared, one list per height. A node is queued
+   once every ancestor has failed to match. */
+typedef struct {
+    int* first;             // by height
+    int* next;              // by node
+    int* nodes;             // one height's nodes, in tree order
+} HeightQueue;
+
+
+static void queue_init(HeightQueue* queue, DiffTree* tree, int max_height) {
+    queue->first = diff_alloc(NULL, (max_height + 1) * sizeof(int));
+    queue->next = diff_alloc(NULL, (tree->count ? tree->count : 1) * sizeof(int));
+    queue->nodes = diff_alloc(NULL, (tree->count ? tree->count : 1) * sizeof(int));
+    for (int h = 0; h <= max_height; h++) queue->first[h] = -1;
+}
+
+
+static void queue_push(HeightQueue* queue, DiffTree* tree, int i) {
+    int h = tree->height[i];
+    if (h < MIN_HEIGHT) return;
+    queue->next[i] = queue->first[h];
+    queue->first[h] = i;
+}
+
+
+static int compare_ints(const void* x, const void* y) {
+    return *(const int*)x - *(const int*)y;
+}
+
+
+static int queue_take(HeightQueue* queue, int h) {
+    int count = 0;
+    for (int i = queue->first[h]; i >= 0; i = queue->next[i]) queue->nodes[count++] = i;
+    queue->first[h] = -1;
+    qsort(queue->nodes, count, sizeof(int), compare_ints);
+    return count;
+}
+
+
+// Queues the children of each node of the height that did not match
+static void queue_open(HeightQueue* queue, DiffTree* tree, int count) {
+    for (int n = 0; n < count; n++) {
+        int i = queue->nodes[n];
+        if (tree->match[i] >= 0) continue;
+        for (int c = i + 1; c < i + tree->size[i]; c += tree->size[c]) {
+            queue_push(queue, tree, c);
+        }
+    }
+}
+
+
+static void free_queue(HeightQueue* queue) {
+    free(queue->first);
+    free(queue->next);
+    free(queue->nodes);
+}
+
+
+/* Candidates of one height, chained by hash bucket. A bucket left over from
+   an earlier height is recognised by its stamp and counts as empty;
+   candidates are unlinked once matched, so no chain is walked twice. */
+typedef struct {
+    int* head;
+    int* stamp;
+    int* next;
+    int mask;
+} Buckets;
+
+
+static void buckets_init(Buckets* buckets, int count) {
+    int slots = 1;
+    while (slots < count * 2) slots <<= 1;
+    buckets->head = diff_alloc(NULL, slots * sizeof(int));
+    buckets->stamp = diff_alloc(NULL, slots * sizeof(int));
+    buckets->next = diff_alloc(NULL, (count ? count : 1) * sizeof(int));
+    buckets->mask = slots - 1;
+    for (int s = 0; s < slots; s++) buckets->stamp[s] = -1;
+}
+
+
+static int* bucket(Buckets* buckets, uint64_t key, int height) {
+    int s = (int)(key & (uint64_t)buckets->mask);
+    if (buckets->stamp[s] != height) {
+        buckets->stamp[s] = height;
+        buckets->head[s] = -1;
+    }
+    return &buckets->head[s];
+}
+
+
+static void free_buckets(Buckets* buckets) {
+    free(buckets->head);
+    free(buckets->stamp);
+    free(buckets->next);
+}
+
+
+static uint64_t parent_key(DiffTree* tree, int i) {
+    int p = tree->parent[i];
+    uint64_t parent = p < 0 ? FNV_OFFSET : tree->hash[p];
+    return tree->hash[i] ^ (parent * FNV_PRIME);
+}
+
+
+static uint64_t plain_key(DiffTree* tree, int i) {
+    return tree->hash[i];
+}
+
+
+// First unmatched candidate in the chain that `key` and `j` agree with
+static int find_candidate(Buckets* buckets, uint64_t key, int height, DiffTree* a, DiffTree* b, int j,
+                          uint64_t (*key_of)(DiffTree*, int)) {
+    int* link = bucket(buckets, key, height);
+    while (*link >= 0) {
+        int i = *link;
+        if (a->match[i] >= 0) {
+            *link = buckets->next[i];
+            continue;
+        }
+        if (key_of(a, i) == key && same_subtree(a, i, b, j)) return i;
+        link = &buckets->next[i];
+    }
+    return -1;
+}
+
+
+static void match_top_down(DiffTree* a, DiffTree* b) {
+    int max_height = 0;
+    for (int i = 0; i < a->count; i += a->size[i]) {
+        if (a->height[i] > max_height) max_height = a->height[i];
+    }
+    for (int j = 0; j < b->count; j += b->size[j]) {
+        if (b->height[j] > max_height) max_height = b->height[j];
+    }
+
+    HeightQueue qa, qb;
+    queue_init(&qa, a, max_height);
+    queue_init(&qb, b, max_height);
+    for (int i = 0; i < a->count; i += a->size[i]) queue_push(&qa, a, i);
+    for (int j = 0; j < b->count; j += b->size[j]) queue_push(&qb, b, j);
+
+    // A copy under a similar parent is preferred, then the first in tree order
+    Buckets by_parent, by_hash;
+    buckets_init(&by_parent, a->count);
+    buckets_init(&by_hash, a->count);
+
+    for (int h = max_height; h >= MIN_HEIGHT; h--) {
+        int count_a = queue_take(&qa, h);
+        int count_b = queue_take(&qb, h);
+
+        if (count_a > 0 && count_b > 0) {
+            for (int n = count_a - 1; n >= 0; n--) {
+                int i = qa.nodes[n];
+                int* head = bucket(&by_parent, parent_key(a, i), h);
+                by_parent.next[i] = *head;
+                *head = i;
+                head = bucket(&by_hash, a->hash[i], h);
+                by_hash.next[i] = *head;
+                *head = i;
+            }
+
+            for (int n = 0; n < count_b; n++) {
+                int j = qb.nodes[n];
+                int i = find_candidate(&by_parent, parent_key(b, j), h, a, b, j, parent_key);
+                if (i < 0) i = find_candidate(&by_hash, b->hash[j], h, a, b, j, plain_key);
+                if (i < 0) continue;
+                for (int k = 0; k < b->size[j]; k++) {
+                    link_nodes(a, i + k, b, j + k);
+                }
+            }
+        }
+
+        queue_open(&qa, a, count_a);
+        queue_open(&qb, b, count_b);
+    }
+
+    free_queue(&qa);
+    free_queue(&qb);
+    free_buckets(&by_parent);
+    free_buckets(&by_hash);
+}
+
+
+static void match_bottom_up(DiffTree* a, DiffTree* b) {
+    for (int j = b->count - 1; j >= 0; j--) {
+        if (b->match[j] >= 0) continue;
+
+        int best = -1;
+        int best_votes = 0;
+        for (int c = j + 1; c < j + b->size[j]; c += b->size[c]) {
+            if (b->match[c] < 0) continue;
+            int candidate = a->parent[b->match[c]];
+            if (candidate < 0 || a->match[candidate] >= 0 ||
+                a->nodes[candidate]->type != b->nodes[j]->type) continue;
+
+            int votes = 0;
+            for (int d = j + 1; d < j + b->size[j]; d += b->size[d]) {
+                if (b->match[d] >= 0 && a->parent[b->match[d]] == candidate) votes++;
+            }
+            if (votes > best_votes) {
+                best = candidate;
+                best_votes = votes;
+            }
+        }
+
+        if (best >= 0) link_nodes(a, best, b, j);
+    }
+}
+
+
+// Pairs b's node `c` with an unmatched node among a's subtrees in [first, end)
+static void pair_leftover(DiffTree* a, int first, int end, DiffTree* b, int c) {
+    int best = -1;
+    for (int d = first; d < end; d += a->size[d]) {
+        if (a->match[d] >= 0 || a->nodes[d]->type != b->nodes[c]->type) continue;
+        if (best < 0) best = d;
+        if (same_value(a->nodes[d], b->nodes[c])) {
+            best = d;
+            break;
+        }
+    }
+    if (best >= 0) link_nodes(a, best, b, c);
+}
+
+
+static void match_leftovers(DiffTree* a, DiffTree* b) {
+    // The top-level functions pair up as children of one implicit root
+    for (int c = 0; c < b->count; c += b->size[c]) {
+        if (b->match[c] < 0) pair_leftover(a, 0, a->count, b, c);
+    }
+
+    for (int j = 0; j < b->count; j++) {
+        int i = b->match[j];
+        if (i < 0) continue;
+
+        for (int c = j + 1; c < j + b->size[j]; c += b->size[c]) {
+            if (b->match[c] < 0) pair_leftover(a, i + 1, i + a->size[i], b, c);
+        }
+    }
+}
+
+
+static DiffEntry* make_entries(DiffTree* tree) {
+    DiffEntry* entries = diff_alloc(NULL, (tree->count ? tree->count : 1) * sizeof(DiffEntry));
+    for (int i = 0; i < tree->count; i++) {
+        entries[i].node = tree->nodes[i];
+        entries[i].partner = tree->match[i];
+        entries[i].line = tree->line[i];
+        entries[i].kind = DIFF_NONE;
+    }
+    return entries;
+}
+
+
+ASTDiff* diff_ast(ASTNode* original, ASTNode* optimized) {
+    DiffTree a = {0};
+    DiffTree b = {0};
+    // Top-level functions are a list, each flattened as a root of its own
+    for (ASTNode* node = original; node; node = node->next) flatten(&a, node, -1);
+    for (ASTNode* node = optimized; node; node = node->next) flatten(&b, node, -1);
+
+    match_top_down(&a, &b);
+    match_bottom_up(&a, &b);
+    match_leftovers(&a, &b);
+
+    ASTDiff* diff = diff_alloc(NULL, sizeof(ASTDiff));
+    diff->original = make_entries(&a);
+    diff->original_count = a.count;
+    diff->optimized = make_entries(&b);
+    diff->optimized_count = b.count;
+
+    for (int i = 0; i < a.count; i++) {
+        if (a.match[i] < 0) diff->original[i].kind = DIFF_DELETE;
+    }
+
+    for (int j = 0; j < b.count; j++) {
+        int i = b.match[j];
+        DiffKind kind = DIFF_NONE;
+
+        if (i < 0) {
+            kind = DIFF_INSERT;
+        } else if (!same_value(a.nodes[i], b.nodes[j])) {
+            kind = DIFF_UPDATE;
+        } else if (b.parent[j] >= 0 && b.match[b.parent[j]] != a.parent[i]) {
+            kind = DIFF_MOVE;
+        }
+
+        diff->optimized[j].kind = kind;
+        if (i >= 0) diff->original[i].kind = kind;
+    }
+
+    free_tree(&a);
+    free_tree(&b);
+    return diff;
+}
+
+
+const char* get_diff_kind_str(DiffKind kind) {
+    switch (kind) {
+        case DIFF_INSERT: return "insert";
+        case DIFF_DELETE: return "delete";
+        case DIFF_UPDATE: return "update";
+        case DIFF_MOVE: return "move";
+        default: return "none";
+    }
+}
+
+
+/* One line per changed node: "<kind> <original index> <optimized index>",
+   indices counting lines of the corresponding print_ast() section and -1
+   standing in for the side that has no node. */
+void print_ast_diff(ASTDiff* diff, FILE* output) {
+    if (!diff) return;
+
+    for (int i = 0; i < diff->original_count; i++) {
+        if (diff->original[i].kind == DIFF_DELETE) {
+            fprintf(output, "%s %d -1\n", get_diff_kind_str(DIFF_DELETE), diff->original[i].line);
+        }
+    }
+
+    for (int j = 0; j < diff->optimized_count; j++) {
+        DiffEntry* entry = &diff->optimized[j];
+        if (entry->kind == DIFF_NONE) continue;
+        int partner = entry->partner >= 0 ? diff->original[entry->partner].line : -1;
+        fprintf(output, "%s %d %d\n", get_diff_kind_str(entry->kind), partner, entry->line);
+    }
+}
+
+
+void free_ast_diff(ASTDiff* diff) {
+    if (!diff) return;
+    free(diff->original);
+    free(diff->optimized);
+    free(diff);
+}
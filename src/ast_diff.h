@@ -0,0 +1,44 @@
+#ifndef AST_DIFF_H
+#define AST_DIFF_H
+
+#include <stdio.h>
+#include "ast.h"
+
+
+typedef enum {
+    DIFF_NONE,
+    DIFF_INSERT,
+    DIFF_DELETE,
+    DIFF_UPDATE,
+    DIFF_MOVE
+} DiffKind;
+
+
+/* One entry per node, in print_ast() order. `partner` is the index of the
+   matched node in the other tree, or -1 when the node has no match, and
+   `line` the node's line in its print_ast() section. */
+typedef struct {
+    ASTNode* node;
+    int partner;
+    int line;
+    DiffKind kind;
+} DiffEntry;
+
+
+typedef struct {
+    DiffEntry* original;
+    int original_count;
+    DiffEntry* optimized;
+    int optimized_count;
+} ASTDiff;
+
+
+ASTDiff* diff_ast(ASTNode* original, ASTNode* optimized);
+
+void print_ast_diff(ASTDiff* diff, FILE* output);
+
+const char* get_diff_kind_str(DiffKind kind);
+
+void free_ast_diff(ASTDiff* diff);
+
+#endif
@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast_store.h"
+
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME  16777619u
+
+
+static void* store_alloc(void* ptr, size_t size) {
+    void* mem = realloc(ptr, size ? size : 1);
+    if (!mem) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return mem;
+}
+
+
+static uint32_t hash_string(const char* s) {
+    uint32_t hash = FNV_OFFSET;
+    for (; *s; s++) {
+        hash ^= (unsigned char)*s;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+
+static void grow_intern(ASTStore* store) {
+    uint32_t capacity = store->intern_capacity ? store->intern_capacity * 2 : 64;
+    uint32_t* intern = store_alloc(NULL, capacity * sizeof(uint32_t));
+    memset(intern, 0xff, capacity * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < store->intern_capacity; i++) {
+        uint32_t offset = store->intern[i];
+        if (offset == AST_NONE) continue;
+        uint32_t j = hash_string(store->strings + offset) & (capacity - 1);
+        while (intern[j] != AST_NONE) j = (j + 1) & (capacity - 1);
+        intern[j] = offset;
+    }
+    free(store->intern);
+    store->intern = intern;
+    store->intern_capacity = capacity;
+}
+
+
+static uint32_t intern_string(ASTStore* store, const char* s) {
+    if (!s) return AST_NONE;
+    if ((store->intern_count + 1) * 2 > store->intern_capacity) grow_intern(store);
+
+    uint32_t mask = store->intern_capacity - 1;
+    uint32_t j = hash_string(s) & mask;
+    for (; store->intern[j] != AST_NONE; j = (j + 1) & mask) {
+        if (strcmp(store->strings + store->intern[j], s) == 0) return store->intern[j];
+    }
+
+    uint32_t length = (uint32_t)strlen(s) + 1;
+    if (store->string_size + length > store->string_capacity) {
+        uint32_t capacity = store->string_capacity ? store->string_capacity : 256;
+        while (store->string_size + length > capacity) capacity *= 2;
+        store->strings = store_alloc(store->strings, capacity);
+        store->string_capacity = capacity;
+    }
+    uint32_t offset = store->string_size;
+    memcpy(store->strings + offset, s, length);
+    store->string_size += length;
+    store->intern[j] = offset;
+    store->intern_count++;
+    return offset;
+}
+
+
+static void resize_nodes(ASTStore* store, uint32_t capacity) {
+    store->kinds = store_alloc(store->kinds, capacity * sizeof(uint8_t));
+    store->flags = store_alloc(store->flags, capacity * sizeof(uint8_t));
+    store->passes = store_alloc(store->passes, capacity * sizeof(uint8_t));
+    store->payloads = store_alloc(store->payloads, capacity * sizeof(uint32_t));
+    store->first_child = store_alloc(store->first_child, capacity * sizeof(uint32_t));
+    store->next_sibling = store_alloc(store->next_sibling, capacity * sizeof(uint32_t));
+    store->locs = store_alloc(store->locs, capacity * sizeof(uint32_t));
+    store->origins = store_alloc(store->origins, capacity * sizeof(uint32_t));
+    store->capacity = capacity;
+}
+
+
+static uint32_t add_entry(ASTStore* store, ASTNode* node, uint8_t flags) {
+    if (store->count == store->capacity) {
+        resize_nodes(store, store->capacity ? store->capacity * 2 : 256);
+    }
+
+    uint32_t i = store->count++;
+    store->kinds[i] = (uint8_t)node->type;
+    store->flags[i] = flags;
+    store->passes[i] = (uint8_t)node->pass;
+    if (node->type == NODE_INT && node->value) {
+        store->payloads[i] = (uint32_t)atoi(node->value);
+    } else {
+        store->payloads[i] = intern_string(store, node->value);
+    }
+    store->first_child[i] = AST_NONE;
+    store->next_sibling[i] = AST_NONE;
+    store->locs[i] = node->loc;
+    store->origins[i] = (uint32_t)node->origin;
+    return i;
+}
+
+
+static uint32_t store_chain(ASTStore* store, ASTNode* node, uint8_t flags, uint32_t* last);
+
+
+static uint32_t store_node(ASTStore* store, ASTNode* node, uint8_t flags) {
+    uint32_t i = add_entry(store, node, flags);
+    uint32_t last = AST_NONE;
+    for (int k = 0; k < ast_slot_count(node->type); k++) {
+        uint32_t chain_last;
+        uint32_t chain = store_chain(store, node->child[k], AST_SLOT_START | k, &chain_last);
+        if (chain == AST_NONE) continue;
+        if (last != AST_NONE) store->next_sibling[last] = chain;
+        else store->first_child[i] = chain;
+        last = chain_last;
+    }
+    return i;
+}
+
+
+static uint32_t store_chain(ASTStore* store, ASTNode* node, uint8_t flags, uint32_t* last) {
+    uint32_t first = AST_NONE;
+    uint32_t prev = AST_NONE;
+    for (; node; node = node->next) {
+        uint32_t i = store_node(store, node, first == AST_NONE ? flags : 0);
+        if (prev != AST_NONE) store->next_sibling[prev] = i;
+        else first = i;
+        prev = i;
+    }
+    if (last) *last = prev;
+    return first;
+}
+
+
+ASTStore* ast_store_from_tree(ASTNode* root) {
+    ASTStore* store = store_alloc(NULL, sizeof(ASTStore));
+    memset(store, 0, sizeof(ASTStore));
+    store_chain(store, root, 0, NULL);
+    return store;
+}
+
+
+const char* ast_store_string(const ASTStore* store, uint32_t node) {
+    if (store->kinds[node] == NODE_INT) return NULL;
+    uint32_t offset = store->payloads[node];
+    return offset == AST_NONE ? NULL : store->strings + offset;
+}
+
+
+static ASTNode* load_chain(const ASTStore* store, uint32_t first);
+
+
+static ASTNode* load_node(const ASTStore* store, uint32_t i) {
+    ASTNode* node;
+    if (store->kinds[i] == NODE_INT) {
+        node = make_int_node((int32_t)store->payloads[i]);
+    } else {
+        node = create_node((NodeType)store->kinds[i], ast_store_string(store, i));
+    }
+    node->loc = store->locs[i];
+    node->origin = (int)store->origins[i];
+    node->pass = (OptPass)store->passes[i];
+
+    for (uint32_t child = store->first_child[i]; child != AST_NONE; child = store->next_sibling[child]) {
+        if (store->flags[child] & AST_SLOT_START) {
+            node->child[store->flags[child] & AST_SLOT_MASK] = load_chain(store, child);
+        }
+    }
+    return node;
+}
+
+
+// Stops where the next slot's chain starts
+static ASTNode* load_chain(const ASTStore* store, uint32_t first) {
+    ASTNode* head = NULL;
+    ASTNode** tail = &head;
+    for (uint32_t i = first; i != AST_NONE; i = store->next_sibling[i]) {
+        if (i != first && (store->flags[i] & AST_SLOT_START)) break;
+        *tail = load_node(store, i);
+        tail = &(*tail)->next;
+    }
+    return head;
+}
+
+
+ASTNode* ast_store_to_tree(const ASTStore* store, uint32_t first) {
+    if (first >= store->count) return NULL;
+    return load_chain(store, first);
+}
+
+
+/* Children always sit after their parent, so one backwards scan sees every
+   operand folded before the operation using it. Folded operands stay in
+   the arrays unreferenced until the next ast_store_compact(). */
+uint32_t ast_store_fold_constants(ASTStore* store) {
+    uint32_t folded = 0;
+    for (uint32_t i = store->count; i-- > 0;) {
+        if (store->kinds[i] != NODE_BINOP) continue;
+
+        uint32_t left = store->first_child[i];
+        if (left == AST_NONE || store->kinds[left] != NODE_INT ||
+            store->flags[left] != AST_SLOT_START) continue;
+        uint32_t right = store->next_sibling[left];
+        if (right == AST_NONE || store->kinds[right] != NODE_INT ||
+            store->flags[right] != (AST_SLOT_START | 1) || store->next_sibling[right] != AST_NONE) continue;
+
+        int result;
+        if (!eval_binop(ast_store_string(store, i), (int32_t)store->payloads[left],
+                        (int32_t)store->payloads[right], &result)) {
+            continue;
+        }
+
+        store->kinds[i] = NODE_INT;
+        store->payloads[i] = (uint32_t)result;
+        store->passes[i] = PASS_FOLD;
+        store->first_child[i] = AST_NONE;
+        folded++;
+    }
+    return folded;
+}
+
+
+/* Dropping whole subtrees from a preorder sequence leaves it in preorder,
+   so compaction marks what is still reachable from node 0 in one forward
+   scan and slides the survivors down. */
+void ast_store_compact(ASTStore* store) {
+    if (store->count == 0) return;
+
+    uint32_t* remap = store_alloc(NULL, store->count * sizeof(uint32_t));
+    memset(remap, 0xff, store->count * sizeof(uint32_t));
+    for (uint32_t i = 0; i != AST_NONE; i = store->next_sibling[i]) remap[i] = 0;
+    for (uint32_t i = 0; i < store->count; i++) {
+        if (remap[i] == AST_NONE) continue;
+        for (uint32_t c = store->first_child[i]; c != AST_NONE; c = store->next_sibling[c]) {
+            remap[c] = 0;
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < store->count; i++) {
+        if (remap[i] != AST_NONE) remap[i] = count++;
+    }
+
+    for (uint32_t i = 0; i < store->count; i++) {
+        uint32_t to = remap[i];
+        if (to == AST_NONE) continue;
+        store->kinds[to] = store->kinds[i];
+        store->flags[to] = store->flags[i];
+        store->passes[to] = store->passes[i];
+        store->payloads[to] = store->payloads[i];
+        store->locs[to] = store->locs[i];
+        store->origins[to] = store->origins[i];
+        uint32_t child = store->first_child[i];
+        uint32_t sibling = store->next_sibling[i];
+        store->first_child[to] = child == AST_NONE ? AST_NONE : remap[child];
+        store->next_sibling[to] = sibling == AST_NONE ? AST_NONE : remap[sibling];
+    }
+    store->count = count;
+    free(remap);
+}
+
+
+size_t ast_store_bytes(const ASTStore* store) {
+    size_t per_node = 3 * sizeof(uint8_t) + 5 * sizeof(uint32_t);
+    return sizeof(ASTStore) + (size_t)store->capacity * per_node +
+           store->string_capacity + store->intern_capacity * sizeof(uint32_t);
+}
+
+
+/* Arrays are written as they are in memory, so a store is only read back
+   on the kind of machine that wrote it. The intern index is not kept. */
+bool ast_store_write(const ASTStore* store, FILE* output) {
+    uint32_t header[2] = { store->count, store->string_size };
+    return fwrite(header, sizeof(header), 1, output) == 1 &&
+           fwrite(store->kinds, 1, store->count, output) == store->count &&
+           fwrite(store->flags, 1, store->count, output) == store->count &&
+           fwrite(store->passes, 1, store->count, output) == store->count &&
+           fwrite(store->payloads, sizeof(uint32_t), store->count, output) == store->count &&
+           fwrite(store->first_child, sizeof(uint32_t), store->count, output) == store->count &&
+           fwrite(store->next_sibling, sizeof(uint32_t), store->count, output) == store->count &&
+           fwrite(store->locs, sizeof(uint32_t), store->count, output) == store->count &&
+           fwrite(store->origins, sizeof(uint32_t), store->count, output) == store->count &&
+           fwrite(store->strings, 1, store->string_size, output) == store->string_size;
+}
+
+
+/* A store read from a client must also be a tree the passes can walk:
+   no node reached twice, a value for every kind that has one, and
+   children only in the parent's own slots, each slot once and in order.
+   Links have been checked to point forward, so there are no cycles. */
+static bool check_tree(const ASTStore* store) {
+    uint8_t* linked = store_alloc(NULL, store->count);
+    memset(linked, 0, store->count);
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < store->count; i++) {
+        uint32_t links[2] = { store->first_child[i], store->next_sibling[i] };
+        for (int k = 0; ok && k < 2; k++) {
+            if (links[k] == AST_NONE) continue;
+            ok = !linked[links[k]];
+            linked[links[k]] = 1;
+        }
+    }
+    free(linked);
+
+    // With one parent per node, walking every child list is linear
+    for (uint32_t i = 0; ok && i < store->count; i++) {
+        NodeType kind = (NodeType)store->kinds[i];
+        ok = kind == NODE_INT || !ast_has_value(kind) || store->payloads[i] != AST_NONE;
+
+        int slot = -1;
+        for (uint32_t c = store->first_child[i]; ok && c != AST_NONE; c = store->next_sibling[c]) {
+            if (store->flags[c] & AST_SLOT_START) {
+                int next = store->flags[c] & AST_SLOT_MASK;
+                ok = next > slot && next < ast_slot_count(kind);
+                slot = next;
+            } else {
+                ok = slot >= 0;
+            }
+        }
+    }
+    return ok;
+}
+
+
+ASTStore* ast_store_read(FILE* input) {
+    uint32_t header[2];
+    if (fread(header, sizeof(header), 1, input) != 1) return NULL;
+
+    // Sizes come from the file, so check it can hold them before allocating
+    long here = ftell(input);
+    if (here >= 0 && fseek(input, 0, SEEK_END) == 0) {
+        long end = ftell(input);
+        if (fseek(input, here, SEEK_SET) != 0) return NULL;
+        uint64_t entry_bytes = 3 * sizeof(uint8_t) + 5 * sizeof(uint32_t);
+        if ((uint64_t)header[0] * entry_bytes + header[1] > (uint64_t)(end - here)) return NULL;
+    }
+
+    ASTStore* store = store_alloc(NULL, sizeof(ASTStore));
+    memset(store, 0, sizeof(ASTStore));
+    uint32_t count = header[0];
+    resize_nodes(store, count);
+    store->strings = store_alloc(NULL, header[1]);
+    store->string_capacity = header[1];
+
+    bool ok = fread(store->kinds, 1, count, input) == count &&
+              fread(store->flags, 1, count, input) == count &&
+              fread(store->passes, 1, count, input) == count &&
+              fread(store->payloads, sizeof(uint32_t), count, input) == count &&
+              fread(store->first_child, sizeof(uint32_t), count, input) == count &&
+              fread(store->next_sibling, sizeof(uint32_t), count, input) == count &&
+              fread(store->locs, sizeof(uint32_t), count, input) == count &&
+              fread(store->origins, sizeof(uint32_t), count, input) == count &&
+              fread(store->strings, 1, header[1], input) == header[1];
+    store->count = count;
+    store->string_size = header[1];
+
+    // Links must stay inside the store and strings inside the pool
+    for (uint32_t i = 0; ok && i < count; i++) {
+        ok = store->kinds[i] <= NODE_ASSIGN && store->passes[i] <= PASS_SIMD &&
+             (store->first_child[i] == AST_NONE || (store->first_child[i] > i && store->first_child[i] < count)) &&
+             (store->next_sibling[i] == AST_NONE || (store->next_sibling[i] > i && store->next_sibling[i] < count)) &&
+             (store->kinds[i] == NODE_INT || store->payloads[i] == AST_NONE ||
+              store->payloads[i] < header[1]);
+    }
+    if (ok && header[1] > 0) ok = store->strings[header[1] - 1] == '\0';
+    if (ok) ok = check_tree(store);
+    if (!ok) {
+        free_ast_store(store);
+        return NULL;
+    }
+    return store;
+}
+
+
+void free_ast_store(ASTStore* store) {
+    if (!store) return;
+    free(store->kinds);
+    free(store->flags);
+    free(store->passes);
+    free(store->payloads);
+    free(store->first_child);
+    free(store->next_sibling);
+    free(store->locs);
+    free(store->origins);
+    free(store->strings);
+    free(store->intern);
+    free(store);
+}
@@ -0,0 +1,63 @@
+#ifndef AST_STORE_H
+#define AST_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "ast.h"
+
+
+#define AST_NONE UINT32_MAX
+
+// The first node of each child slot's chain is flagged with the slot
+#define AST_SLOT_START 0x04
+#define AST_SLOT_MASK  0x03
+
+
+/* Compact copy of a tree: one entry per node across parallel arrays,
+   addressed by 32-bit index. Nodes are laid out in preorder, so a subtree
+   occupies the entries after its root and children always come after their
+   parent. The chains in an ASTNode's child slots, in slot order, become
+   the node's children; the top-level chain hangs off node 0 as its siblings.
+   Values are interned in one string pool, except integer literals, which
+   are kept in the payload itself. */
+typedef struct {
+    uint8_t* kinds;         // NodeType
+    uint8_t* flags;
+    uint8_t* passes;        // OptPass
+    uint32_t* payloads;     // INT value, string pool offset, or AST_NONE
+    uint32_t* first_child;
+    uint32_t* next_sibling;
+    uint32_t* locs;
+    uint32_t* origins;
+    uint32_t count;
+    uint32_t capacity;
+    char* strings;
+    uint32_t string_size;
+    uint32_t string_capacity;
+    uint32_t* intern;       // open-addressed string offsets, AST_NONE when free
+    uint32_t intern_capacity;
+    uint32_t intern_count;
+} ASTStore;
+
+
+ASTStore* ast_store_from_tree(ASTNode* root);
+
+ASTNode* ast_store_to_tree(const ASTStore* store, uint32_t first);
+
+const char* ast_store_string(const ASTStore* store, uint32_t node);
+
+uint32_t ast_store_fold_constants(ASTStore* store);
+
+void ast_store_compact(ASTStore* store);
+
+size_t ast_store_bytes(const ASTStore* store);
+
+bool ast_store_write(const ASTStore* store, FILE* output);
+
+ASTStore* ast_store_read(FILE* input);
+
+void free_ast_store(ASTStore* store);
+
+#endif
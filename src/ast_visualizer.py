@@ -1,17 +1,18 @@
 import os
 from graphviz import Digraph
-from PIL import Image
 
-def parse_ast(lines):
-    root = None
+# Top-level functions are siblings, so a section holds a list of trees
+def parse_ast(lines, prefix="n"):
+    roots = []
     stack = []
 
-    for line in lines:
+    for index, line in enumerate(lines):
         if not line.strip(): continue
         indent = len(line) - len(line.lstrip())
         label = line.strip()
 
-        node_id = str(id(label + str(indent)))
+        # Ids must stay unique once both trees share a single graph
+        node_id = f"{prefix}{index}"
         node = {'id': node_id, 'label': label, 'indent': indent}
 
         while stack and stack[-1]['indent'] >= indent:
@@ -21,11 +22,25 @@ def parse_ast(lines):
             parent = stack[-1]
             parent.setdefault('children', []).append(node)
         else:
-            root = node
+            roots.append(node)
 
         stack.append(node)
 
-    return root
+    return roots
+
+SECTION_HEADERS = ("Original AST:", "Optimized AST:", "AST Diff:", "Provenance:")
+
+def split_sections(lines):
+    sections = {}
+    current = None
+    for line in lines:
+        line = line.rstrip()
+        if line in SECTION_HEADERS:
+            current = line
+            sections[current] = []
+        elif current:
+            sections[current].append(line)
+    return sections
 
 def flatten_ast(node):
     flat = set()
@@ -34,12 +49,50 @@ def flatten_ast(node):
         flat.update(flatten_ast(child))
     return flat
 
-def build_graph(graph, node, parent_id=None, color='lightgray'):
-    graph.node(node['id'], node['label'], style='filled', fillcolor=color)
+DIFF_COLORS = {
+    'insert': 'lightgreen',
+    'update': 'khaki',
+    'move': 'lightblue',
+    'delete': 'lightcoral',
+}
+
+def parse_diff(lines):
+    # Each line is "<kind> <original index> <optimized index>", -1 for no node
+    changes = {}
+    for line in lines:
+        parts = line.split()
+        if len(parts) != 3:
+            continue
+        kind, orig_index, opt_index = parts[0], int(parts[1]), int(parts[2])
+        if orig_index >= 0:
+            changes[f"o{orig_index}"] = kind
+        if opt_index >= 0:
+            changes[f"p{opt_index}"] = kind
+    return changes
+
+def parse_provenance(lines):
+    # Each line is "<optimized index> <pass> <original index> <line>:<column>"
+    notes = {}
+    for line in lines:
+        parts = line.split()
+        if len(parts) != 4:
+            continue
+        opt_index, pass_name, orig_index, location = parts
+        origin = f" from #{orig_index}" if int(orig_index) >= 0 else ""
+        notes[f"p{opt_index}"] = f"{pass_name}{origin} @ {location}"
+    return notes
+
+def build_graph(graph, node, parent_id=None, changes=None, notes=None):
+    color = DIFF_COLORS.get((changes or {}).get(node['id']), 'lightgray')
+    label = node['label']
+    note = (notes or {}).get(node['id'])
+    if note:
+        label = f"{label}\n[{note}]"
+    graph.node(node['id'], label, style='filled', fillcolor=color)
     if parent_id:
         graph.edge(parent_id, node['id'])
     for child in node.get('children', []):
-        build_graph(graph, child, node['id'], color)
+        build_graph(graph, child, node['id'], changes, notes)
 
 def highlight_diff_graph(graph, node, parent_id=None, original_set=None):
     label = node['label']
@@ -57,48 +110,40 @@ def run_visualization(input_path="output.txt", output_folder="."):
     with open(input_path, "r") as f:
         lines = f.readlines()
 
-    try:
-        orig_start = lines.index("Original AST:\n") + 1
-        opt_start = lines.index("Optimized AST:\n") + 1
-    except ValueError:
+    sections = split_sections(lines)
+    if "Original AST:" not in sections or "Optimized AST:" not in sections:
         print("❌ Error: 'Original AST:' or 'Optimized AST:' not found in input.")
         return
 
-    orig_ast_lines = [line.rstrip() for line in lines[orig_start:opt_start - 1]]
-    opt_ast_lines = [line.rstrip() for line in lines[opt_start:]]
-
     # Parse ASTs
-    orig_ast = parse_ast(orig_ast_lines)
-    opt_ast = parse_ast(opt_ast_lines)
-
-    # Compare
-    orig_flat = flatten_ast(orig_ast)
-
-    # Build and save original AST
-    g1 = Digraph("OriginalAST", format='png')
-    build_graph(g1, orig_ast)
-    g1.render(filename=os.path.join(output_folder, "original_ast"), cleanup=True)
-
-    # Build and save optimized AST
-    g2 = Digraph("OptimizedAST", format='png')
-    highlight_diff_graph(g2, opt_ast, original_set=orig_flat)
-    g2.render(filename=os.path.join(output_folder, "optimized_ast_highlighted"), cleanup=True)
-
-    # Load and combine both images
-    img1 = Image.open(os.path.join(output_folder, "original_ast.png"))
-    img2 = Image.open(os.path.join(output_folder, "optimized_ast_highlighted.png"))
-
-    max_height = max(img1.height, img2.height)
-    img1 = img1.resize((img1.width, max_height))
-    img2 = img2.resize((img2.width, max_height))
-
-    combined_width = img1.width + img2.width
-    combined_img = Image.new("RGB", (combined_width, max_height), (255, 255, 255))
-    combined_img.paste(img1, (0, 0))
-    combined_img.paste(img2, (img1.width, 0))
-
-    final_path = os.path.join(output_folder, "ast_comparison.png")
-    combined_img.save(final_path)
+    orig_ast = parse_ast(sections["Original AST:"], prefix="o")
+    opt_ast = parse_ast(sections["Optimized AST:"], prefix="p")
+
+    # Files written before the diff section existed end with the optimized tree
+    changes = parse_diff(sections["AST Diff:"]) if "AST Diff:" in sections else None
+    notes = parse_provenance(sections.get("Provenance:", []))
+
+    # Render both trees as clusters of one graph so the comparison
+    # comes out of a single Graphviz pass
+    graph = Digraph("ASTComparison", format='png')
+
+    with graph.subgraph(name='cluster_original') as g1:
+        g1.attr(label='Original AST', style='rounded')
+        for root in orig_ast:
+            build_graph(g1, root, changes=changes)
+
+    with graph.subgraph(name='cluster_optimized') as g2:
+        g2.attr(label='Optimized AST', style='rounded')
+        original_set = set()
+        for root in orig_ast:
+            original_set.update(flatten_ast(root))
+        for root in opt_ast:
+            if changes is not None:
+                build_graph(g2, root, changes=changes, notes=notes)
+            else:
+                highlight_diff_graph(g2, root, original_set=original_set)
+
+    final_path = graph.render(filename=os.path.join(output_folder, "ast_comparison"), cleanup=True)
 
     print("✅ AST comparison image saved as:", final_path)
 
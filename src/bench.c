@@ -0,0 +1,535 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "ast.h"
+#include "ast_diff.h"
+#include "ast_store.h"
+#include "ir.h"
+#include "memtrack.h"
+#include "srcloc.h"
+#include "parser.tab.h"
+
+extern ASTNode* ast_root;
+extern int parse_error_count;
+int yylex(void);
+int parse_program(void);
+void lexer_set_text(const char* text, size_t length);
+
+
+/* Allocations made by the pipeline's code come through here, so a phase's
+   count is the difference of the totals around it. The linker routes them
+   with -Wl,--wrap (see the README build line); what the C library
+   allocates for itself, such as stdio buffers, is not counted. */
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+char* __real_strdup(const char* text);
+
+static uint64_t allocations = 0;
+static uint64_t allocated_bytes = 0;
+static uint64_t written_bytes = 0;      // by the phases, through open_sink()
+
+static void count_allocation(size_t size) {
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&allocated_bytes, size, __ATOMIC_RELAXED);
+}
+
+void* __wrap_malloc(size_t size) {
+    count_allocation(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    count_allocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    count_allocation(size);
+    return __real_realloc(ptr, size);
+}
+
+char* __wrap_strdup(const char* text) {
+    count_allocation(strlen(text) + 1);
+    return __real_strdup(text);
+}
+
+
+typedef struct {
+    int functions;
+    int statements;     // per function, besides the loops
+    int depth;          // levels of binary operators in each expression
+    int loops;          // per function
+    int constants;      // percent of expression leaves that are literals
+    unsigned seed;
+} BenchShape;
+
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+} Source;
+
+typedef enum {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_FOLD,
+    PHASE_STORE_FOLD,
+    PHASE_OPTIMIZE,
+    PHASE_PRINT,
+    PHASE_DIFF,
+    PHASE_PROVENANCE,
+    PHASE_IR_LOWER,
+    PHASE_IR_OPTIMIZE,
+    PHASE_IR_EMIT,
+    PHASE_COUNT
+} Phase;
+
+static const char* phase_names[PHASE_COUNT] = {
+    "lex", "parse", "fold", "store_fold", "optimize", "print", "diff", "provenance",
+    "ir_lower", "ir_optimize", "ir_emit"
+};
+
+typedef struct {
+    uint64_t nanos;             // best over the repeats
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    uint64_t output_bytes;
+    long peak_rss_kb;           // of the process so far
+} PhaseResult;
+
+typedef struct {
+    uint64_t start;
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    uint64_t written_bytes;
+} PhaseClock;
+
+
+static void emit(Source* source, const char* format, ...) {
+    va_list args;
+    for (;;) {
+        va_start(args, format);
+        size_t room = source->capacity - source->length;
+        int n = vsnprintf(source->text + source->length, room, format, args);
+        va_end(args);
+        if (n >= 0 && (size_t)n < room) {
+            source->length += (size_t)n;
+            return;
+        }
+        source->capacity = source->capacity * 2 + (n > 0 ? (size_t)n : 0);
+        source->text = realloc(source->text, source->capacity);
+        if (!source->text) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+}
+
+
+static unsigned next_random(unsigned* state) {
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+
+/* Leaves read the parameters, `z` once it is declared, and `local`, a loop
+   variable in scope or NULL. */
+static void emit_expr(Source* out, const BenchShape* shape, unsigned* rng, int depth,
+                      int function, bool has_z, const char* local) {
+    static const char* operators[] = { "+", "-", "*" };
+    static const char* variables[] = { "x", "y", "z" };
+
+    if (depth > 0) {
+        emit_expr(out, shape, rng, depth - 1, function, has_z, local);
+        emit(out, " %s ", operators[next_random(rng) % 3]);
+        emit_expr(out, shape, rng, depth - 1, function, has_z, local);
+        return;
+    }
+
+    unsigned pick = next_random(rng);
+    if ((int)(pick % 100) < shape->constants) {
+        emit(out, "%u", next_random(rng) % 100);
+    } else if (function > 0 && pick % 16 == 0) {
+        // Calls to earlier functions keep the call graph acyclic
+        emit(out, "f%u(x, y)", next_random(rng) % function);
+    } else if (local && pick % 4 == 0) {
+        emit(out, "%s", local);
+    } else {
+        emit(out, "%s", variables[pick % (has_z ? 3 : 2)]);
+    }
+}
+
+
+static Source generate_program(const BenchShape* shape) {
+    Source out = { malloc(4096), 0, 4096 };
+    if (!out.text) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    unsigned rng = shape->seed ? shape->seed : 1;
+
+    for (int f = 0; f < shape->functions; f++) {
+        emit(&out, "int f%d(int x, int y) {\n    int z = ", f);
+        emit_expr(&out, shape, &rng, shape->depth, f, false, NULL);
+        emit(&out, ";\n");
+
+        for (int s = 0; s < shape->statements; s++) {
+            switch (s % 3) {
+                case 0:
+                    emit(&out, "    z = ");
+                    emit_expr(&out, shape, &rng, shape->depth, f, true, NULL);
+                    emit(&out, ";\n");
+                    break;
+                case 1:
+                    emit(&out, "    if (");
+                    emit_expr(&out, shape, &rng, shape->depth, f, true, NULL);
+                    emit(&out, " < ");
+                    emit_expr(&out, shape, &rng, shape->depth, f, true, NULL);
+                    emit(&out, ") { z = ");
+                    emit_expr(&out, shape, &rng, shape->depth, f, true, NULL);
+                    emit(&out, "; }\n");
+                    break;
+                default:
+                    emit(&out, "    int t%d = ", s);
+                    emit_expr(&out, shape, &rng, shape->depth, f, true, NULL);
+                    emit(&out, ";\n    z = z - t%d;\n", s);
+                    break;
+            }
+        }
+
+        for (int l = 0; l < shape->loops; l++) {
+            char local[16];
+            snprintf(local, sizeof(local), "i%d", l);
+            emit(&out, "    for (int %s = 0; %s < %u; %s = %s + 1) { z = z + ",
+                 local, local, 4 + next_random(&rng) % 29, local, local);
+            emit_expr(&out, shape, &rng, shape->depth, f, true, local);
+            emit(&out, "; }\n");
+        }
+
+        emit(&out, "    return z + ");
+        emit_expr(&out, shape, &rng, shape->depth, f, true, NULL);
+        emit(&out, ";\n}\n");
+    }
+    return out;
+}
+
+
+static uint64_t now_nanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+
+static ssize_t count_written(void* cookie, const char* data, size_t size) {
+    (void)cookie;
+    (void)data;
+    written_bytes += size;
+    return (ssize_t)size;
+}
+
+
+// Output is counted and dropped, so printing costs what formatting does
+static FILE* open_sink(void) {
+    cookie_io_functions_t io = { NULL, count_written, NULL, NULL };
+    FILE* sink = fopencookie(NULL, "w", io);
+    if (!sink) {
+        perror("fopencookie");
+        exit(1);
+    }
+    return sink;
+}
+
+
+static PhaseClock phase_begin(void) {
+    PhaseClock clock = {
+        now_nanos(),
+        __atomic_load_n(&allocations, __ATOMIC_RELAXED),
+        __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED),
+        written_bytes
+    };
+    return clock;
+}
+
+
+static void phase_end(PhaseResult* result, PhaseClock clock) {
+    fflush(NULL);
+    uint64_t nanos = now_nanos() - clock.start;
+    if (result->nanos == 0 || nanos < result->nanos) result->nanos = nanos;
+    result->allocations = __atomic_load_n(&allocations, __ATOMIC_RELAXED) - clock.allocations;
+    result->allocated_bytes = __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED) - clock.allocated_bytes;
+    result->output_bytes = written_bytes - clock.written_bytes;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result->peak_rss_kb = usage.ru_maxrss;
+}
+
+
+static int count_tree(ASTNode* node) {
+    int count = 0;
+    for (; node; node = node->next) {
+        count++;
+        for (int i = 0; i < ast_slot_count(node->type); i++) {
+            count += count_tree(node->child[i]);
+        }
+    }
+    return count;
+}
+
+
+typedef struct {
+    PhaseResult phases[PHASE_COUNT];
+    OptStats passes;            // from the fastest optimize run
+    int tokens;
+    int nodes;
+    int optimized_nodes;
+    int parse_errors;
+} BenchResult;
+
+
+/* Constant folding alone, over a copy of the parsed tree and over an
+   ASTStore built from it; neither copy is timed. */
+static void run_folding(ASTNode* parsed, BenchResult* result) {
+    ASTNode* copy = deep_copy_ast(parsed);
+    PhaseClock clock = phase_begin();
+    copy = fold_constants(copy);
+    phase_end(&result->phases[PHASE_FOLD], clock);
+    free_ast(copy);
+
+    ASTStore* store = ast_store_from_tree(parsed);
+    clock = phase_begin();
+    ast_store_fold_constants(store);
+    ast_store_compact(store);
+    phase_end(&result->phases[PHASE_STORE_FOLD], clock);
+    free_ast_store(store);
+}
+
+
+/* Without `report` the printing, diff and provenance phases of output.txt
+   are skipped, leaving parsing, optimization and code generation. */
+static void run_pipeline(const Source* source, BenchResult* result, bool report, bool fold) {
+    FILE* sink = open_sink();
+    reset_mem_peaks();
+
+    PhaseClock clock = phase_begin();
+    lexer_set_text(source->text, source->length);
+    int tokens = 0;
+    int token;
+    while ((token = yylex()) != 0) {
+        if (token == IDENTIFIER || token == STRING) mem_free_string(MEM_LEXER, yylval.str);
+        tokens++;
+    }
+    phase_end(&result->phases[PHASE_LEX], clock);
+    result->tokens = tokens;
+
+    ast_reset_ids();
+    ast_root = NULL;
+    parse_error_count = 0;
+    srcloc_set_text("bench.c", source->text, source->length);
+    clock = phase_begin();
+    lexer_set_text(source->text, source->length);
+    parse_program();
+    phase_end(&result->phases[PHASE_PARSE], clock);
+    result->parse_errors = parse_error_count;
+    result->nodes = count_tree(ast_root);
+    if (fold) run_folding(ast_root, result);
+
+    ASTNode* original = report ? deep_copy_ast(ast_root) : NULL;
+    uint64_t best = result->phases[PHASE_OPTIMIZE].nanos;
+    reset_opt_stats();
+    clock = phase_begin();
+    ASTNode* root = optimize_ast(ast_root);
+    phase_end(&result->phases[PHASE_OPTIMIZE], clock);
+    if (result->phases[PHASE_OPTIMIZE].nanos != best) get_opt_stats(&result->passes);
+    result->optimized_nodes = count_tree(root);
+
+    if (report) {
+        clock = phase_begin();
+        print_ast(original, sink, 0);
+        print_ast(root, sink, 0);
+        phase_end(&result->phases[PHASE_PRINT], clock);
+
+        clock = phase_begin();
+        ASTDiff* diff = diff_ast(original, root);
+        print_ast_diff(diff, sink);
+        free_ast_diff(diff);
+        phase_end(&result->phases[PHASE_DIFF], clock);
+
+        clock = phase_begin();
+        print_provenance(original, root, sink);
+        phase_end(&result->phases[PHASE_PROVENANCE], clock);
+    }
+
+    clock = phase_begin();
+    IRModule* ir = lower_to_ir(root);
+    phase_end(&result->phases[PHASE_IR_LOWER], clock);
+
+    clock = phase_begin();
+    optimize_ir(ir);
+    phase_end(&result->phases[PHASE_IR_OPTIMIZE], clock);
+
+    clock = phase_begin();
+    print_ir(ir, sink);
+    emit_ir_c(ir, sink);
+    phase_end(&result->phases[PHASE_IR_EMIT], clock);
+
+    free_ir(ir);
+    free_ast(original);
+    free_ast(root);
+    ast_root = NULL;
+    fclose(sink);
+}
+
+
+static void print_json(FILE* output, const BenchShape* shape, const Source* source,
+                       const BenchResult* result, int repeat) {
+    fprintf(output, "{\n");
+    if (shape) {
+        fprintf(output, "  \"shape\": {\"functions\": %d, \"statements\": %d, \"depth\": %d, "
+                "\"loops\": %d, \"constants\": %d, \"seed\": %u},\n",
+                shape->functions, shape->statements, shape->depth, shape->loops,
+                shape->constants, shape->seed);
+    } else {
+        fprintf(output, "  \"shape\": null,\n");
+    }
+    fprintf(output, "  \"source_bytes\": %zu,\n  \"tokens\": %d,\n  \"nodes\": %d,\n"
+            "  \"optimized_nodes\": %d,\n  \"parse_errors\": %d,\n  \"repeat\": %d,\n",
+            source->length, result->tokens, result->nodes, result->optimized_nodes,
+            result->parse_errors, repeat);
+
+    // Phases left out by --no-report never ran
+    fprintf(output, "  \"phases\": {");
+    const char* separator = "\n";
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        const PhaseResult* phase = &result->phases[p];
+        if (phase->nanos == 0) continue;
+        fprintf(output, "%s    \"%s\": {\"ns\": %llu, \"ns_per_node\": %.2f, \"allocations\": %llu, "
+                "\"allocated_bytes\": %llu, \"output_bytes\": %llu, \"peak_rss_kb\": %ld}",
+                separator, phase_names[p], (unsigned long long)phase->nanos,
+                result->nodes ? (double)phase->nanos / result->nodes : 0.0,
+                (unsigned long long)phase->allocations,
+                (unsigned long long)phase->allocated_bytes,
+                (unsigned long long)phase->output_bytes, phase->peak_rss_kb);
+        separator = ",\n";
+    }
+    fprintf(output, "\n  },\n");
+
+    // Pass times are summed over worker threads, so they can add up to more than the phase
+    fprintf(output, "  \"optimizer\": ");
+    print_opt_stats_json(&result->passes, output, 2);
+
+    // High-water marks of the last run; anything still alive leaked
+    fprintf(output, ",\n  \"memory\": ");
+    print_mem_usage_json(output, 2);
+    fprintf(output, "\n}\n");
+}
+
+
+static Source read_source(const char* path) {
+    Source source = { NULL, 0, 0 };
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    source.capacity = 4096;
+    source.text = malloc(source.capacity);
+    size_t n;
+    while (source.text && (n = fread(source.text + source.length, 1, source.capacity - source.length, file)) > 0) {
+        source.length += n;
+        if (source.length == source.capacity) {
+            source.capacity *= 2;
+            source.text = realloc(source.text, source.capacity);
+        }
+    }
+    fclose(file);
+    if (!source.text) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return source;
+}
+
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--functions N] [--statements N] [--depth N] [--loops N]\n"
+            "          [--constants PERCENT] [--seed N] [--repeat N]\n"
+            "          [--source FILE | --dump FILE] [--no-report] [--fold]\n", program);
+}
+
+
+int main(int argc, char** argv) {
+    BenchShape shape = { 1000, 6, 3, 2, 30, 1 };
+    int repeat = 3;
+    bool report = true;
+    bool fold = false;
+    const char* source_path = NULL;
+    const char* dump_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-report") == 0) {
+            report = false;
+            continue;
+        }
+        if (strcmp(argv[i], "--fold") == 0) {
+            fold = true;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--functions") == 0) shape.functions = atoi(value);
+        else if (strcmp(argv[i], "--statements") == 0) shape.statements = atoi(value);
+        else if (strcmp(argv[i], "--depth") == 0) shape.depth = atoi(value);
+        else if (strcmp(argv[i], "--loops") == 0) shape.loops = atoi(value);
+        else if (strcmp(argv[i], "--constants") == 0) shape.constants = atoi(value);
+        else if (strcmp(argv[i], "--seed") == 0) shape.seed = (unsigned)strtoul(value, NULL, 10);
+        else if (strcmp(argv[i], "--repeat") == 0) repeat = atoi(value);
+        else if (strcmp(argv[i], "--source") == 0) source_path = value;
+        else if (strcmp(argv[i], "--dump") == 0) dump_path = value;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    if (shape.functions < 0 || shape.statements < 0 || shape.loops < 0 ||
+        shape.depth < 0 || shape.depth > 12 || repeat < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Source source = source_path ? read_source(source_path) : generate_program(&shape);
+    if (dump_path) {
+        FILE* dump = fopen(dump_path, "w");
+        if (!dump) {
+            perror(dump_path);
+            return 1;
+        }
+        fwrite(source.text, 1, source.length, dump);
+        fclose(dump);
+    }
+
+    BenchResult result;
+    memset(&result, 0, sizeof(result));
+    for (int run = 0; run < repeat; run++) {
+        run_pipeline(&source, &result, report, fold);
+    }
+
+    print_json(stdout, source_path ? NULL : &shape, &source, &result, repeat);
+    free(source.text);
+    return result.parse_errors > 0;
+}
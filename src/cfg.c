@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cfg.h"
+
+
+#define CFG_EXIT_NODE 1
+
+
+static void* cfg_alloc(void* ptr, size_t size) {
+    void* mem = realloc(ptr, size ? size : 1);
+    if (!mem) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return mem;
+}
+
+
+static int* filled_ints(int count, int value) {
+    int* ints = cfg_alloc(NULL, count * sizeof(int));
+    for (int i = 0; i < count; i++) ints[i] = value;
+    return ints;
+}
+
+
+// Both edges of a branch may lead to the same node; that counts once
+static int successor(const FlowGraph* g, int n, int k) {
+    if (k == 1 && g->succ[n][1] == g->succ[n][0]) return -1;
+    return g->succ[n][k];
+}
+
+
+static int intersect(const FlowGraph* g, int a, int b) {
+    while (a != b) {
+        while (g->order[a] > g->order[b]) a = g->idom[a];
+        while (g->order[b] > g->order[a]) b = g->idom[b];
+    }
+    return a;
+}
+
+
+/* Dominators follow Cooper, Harvey and Kennedy's "A Simple, Fast
+   Dominance Algorithm": iterate idom over reverse postorder until it
+   settles, walking up the partial tree to intersect predecessors. */
+void flow_analyze(FlowGraph* g) {
+    int n = g->count;
+    g->order = filled_ints(n, -1);
+    g->rpo = cfg_alloc(NULL, n * sizeof(int));
+
+    // Iterative DFS; order[] doubles as the visited mark until numbering
+    int* stack = cfg_alloc(NULL, n * sizeof(int));
+    int* cursor = filled_ints(n, 0);
+    int top = 0;
+    int post = 0;
+    if (n > 0) {
+        stack[top++] = 0;
+        g->order[0] = 0;
+    }
+    while (top > 0) {
+        int node = stack[top - 1];
+        if (cursor[node] < 2) {
+            int s = successor(g, node, cursor[node]++);
+            if (s >= 0 && g->order[s] < 0) {
+                g->order[s] = 0;
+                stack[top++] = s;
+            }
+        } else {
+            g->rpo[n - 1 - post++] = node;
+            top--;
+        }
+    }
+    memmove(g->rpo, g->rpo + n - post, post * sizeof(int));
+    g->rpo_count = post;
+    for (int i = 0; i < n; i++) g->order[i] = -1;
+    for (int i = 0; i < post; i++) g->order[g->rpo[i]] = i;
+
+    g->pred_start = filled_ints(n + 1, 0);
+    int edges = 0;
+    for (int i = 0; i < post; i++) {
+        for (int k = 0; k < 2; k++) {
+            int s = successor(g, g->rpo[i], k);
+            if (s < 0) continue;
+            g->pred_start[s + 1]++;
+            edges++;
+        }
+    }
+    for (int i = 0; i < n; i++) g->pred_start[i + 1] += g->pred_start[i];
+    g->preds = cfg_alloc(NULL, edges * sizeof(int));
+    memcpy(cursor, g->pred_start, n * sizeof(int));
+    for (int i = 0; i < post; i++) {
+        for (int k = 0; k < 2; k++) {
+            int s = successor(g, g->rpo[i], k);
+            if (s >= 0) g->preds[cursor[s]++] = g->rpo[i];
+        }
+    }
+
+    g->idom = filled_ints(n, -1);
+    if (n > 0) g->idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < post; i++) {
+            int node = g->rpo[i];
+            int idom = -1;
+            for (int p = g->pred_start[node]; p < g->pred_start[node + 1]; p++) {
+                int pred = g->preds[p];
+                if (g->idom[pred] < 0) continue;
+                idom = idom < 0 ? pred : intersect(g, pred, idom);
+            }
+            if (g->idom[node] != idom) {
+                g->idom[node] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    g->child_start = filled_ints(n + 1, 0);
+    for (int i = 1; i < post; i++) g->child_start[g->idom[g->rpo[i]] + 1]++;
+    for (int i = 0; i < n; i++) g->child_start[i + 1] += g->child_start[i];
+    // Every reachable node but the entry has a parent
+    g->children = cfg_alloc(NULL, (post > 0 ? post - 1 : 0) * sizeof(int));
+    memcpy(cursor, g->child_start, n * sizeof(int));
+    for (int i = 1; i < n; i++) {
+        if (g->order[i] > 0) g->children[cursor[g->idom[i]]++] = i;
+    }
+
+    free(stack);
+    free(cursor);
+}
+
+
+bool flow_dominates(const FlowGraph* g, int a, int b) {
+    if (a < 0 || b < 0 || g->order[a] < 0 || g->order[b] < 0) return false;
+
+    // Dominators of b all come before it in reverse postorder
+    while (g->order[b] > g->order[a]) b = g->idom[b];
+    return a == b;
+}
+
+
+void flow_free(FlowGraph* g) {
+    free(g->succ);
+    free(g->pred_start);
+    free(g->preds);
+    free(g->rpo);
+    free(g->order);
+    free(g->idom);
+    free(g->child_start);
+    free(g->children);
+    memset(g, 0, sizeof(FlowGraph));
+}
+
+
+/* Edges still waiting for the next statement, encoded as node * 2 + slot. */
+typedef struct {
+    int* edges;
+    int count;
+    int capacity;
+} OpenEdges;
+
+
+static void add_edge(OpenEdges* open, int node, int slot) {
+    if (open->count == open->capacity) {
+        open->capacity = open->capacity ? open->capacity * 2 : 8;
+        open->edges = cfg_alloc(open->edges, open->capacity * sizeof(int));
+    }
+    open->edges[open->count++] = node * 2 + slot;
+}
+
+
+static void link_to(CFG* cfg, OpenEdges* open, int target) {
+    for (int i = 0; i < open->count; i++) {
+        cfg->graph.succ[open->edges[i] / 2][open->edges[i] % 2] = target;
+    }
+    open->count = 0;
+}
+
+
+static unsigned int slot_of(int id, int capacity) {
+    return ((unsigned int)id * 2654435761u) & (unsigned int)(capacity - 1);
+}
+
+
+static void index_node(CFG* cfg, ASTNode* stmt, int at) {
+    if ((cfg->graph.count + 1) * 2 > cfg->index_capacity) {
+        int capacity = cfg->index_capacity ? cfg->index_capacity * 2 : 64;
+        int* index = filled_ints(capacity, -1);
+        for (int i = 0; i < cfg->index_capacity; i++) {
+            int node = cfg->index[i];
+            if (node < 0) continue;
+            unsigned int j = slot_of(cfg->nodes[node]->id, capacity);
+            while (index[j] >= 0) j = (j + 1) & (capacity - 1);
+            index[j] = node;
+        }
+        free(cfg->index);
+        cfg->index = index;
+        cfg->index_capacity = capacity;
+    }
+
+    unsigned int j = slot_of(stmt->id, cfg->index_capacity);
+    while (cfg->index[j] >= 0) j = (j + 1) & (cfg->index_capacity - 1);
+    cfg->index[j] = at;
+}
+
+
+static int add_node(CFG* cfg, ASTNode* stmt, CFGKind kind) {
+    if (cfg->graph.count == cfg->capacity) {
+        cfg->capacity = cfg->capacity ? cfg->capacity * 2 : 32;
+        cfg->nodes = cfg_alloc(cfg->nodes, cfg->capacity * sizeof(ASTNode*));
+        cfg->kinds = cfg_alloc(cfg->kinds, cfg->capacity * sizeof(uint8_t));
+        cfg->graph.succ = cfg_alloc(cfg->graph.succ, cfg->capacity * sizeof(int[2]));
+    }
+
+    int at = cfg->graph.count;
+    if (stmt) index_node(cfg, stmt, at);
+    cfg->nodes[at] = stmt;
+    cfg->kinds[at] = (uint8_t)kind;
+    cfg->graph.succ[at][0] = -1;
+    cfg->graph.succ[at][1] = -1;
+    cfg->graph.count++;
+    return at;
+}
+
+
+// 0 or 1 for a constant condition, -1 otherwise
+static int constant_condition(ASTNode* cond) {
+    if (!cond) return 1;
+    if (cond->type != NODE_INT) return -1;
+    return atoi(cond->value) != 0;
+}
+
+
+static void build_stmts(CFG* cfg, ASTNode* node, OpenEdges* open);
+
+
+static void build_stmt(CFG* cfg, ASTNode* node, OpenEdges* open) {
+    switch (node->type) {
+        case NODE_SEQ:
+            build_stmts(cfg, node->left, open);
+            build_stmts(cfg, node->right, open);
+            break;
+
+        case NODE_IF: {
+            int branch = add_node(cfg, node, CFG_BRANCH);
+            link_to(cfg, open, branch);
+            int cond = constant_condition(node->left);
+            if (cond != 0) add_edge(open, branch, 0);
+            build_stmts(cfg, node->right, open);
+            if (cond != 1) add_edge(open, branch, 1);
+            break;
+        }
+
+        case NODE_FOR: {
+            int init = add_node(cfg, node, CFG_STMT);
+            link_to(cfg, open, init);
+
+            int header = add_node(cfg, node->child[FOR_COND], CFG_BRANCH);
+            cfg->graph.succ[init][0] = header;
+            int cond = constant_condition(node->child[FOR_COND]);
+            if (cond != 0) add_edge(open, header, 0);
+            build_stmts(cfg, node->child[FOR_BODY], open);
+
+            int latch = add_node(cfg, node->child[FOR_UPDATE], CFG_UPDATE);
+            link_to(cfg, open, latch);
+            cfg->graph.succ[latch][0] = header;
+            if (cond != 1) add_edge(open, header, 1);
+            break;
+        }
+
+        case NODE_RETURN: {
+            int ret = add_node(cfg, node, CFG_STMT);
+            link_to(cfg, open, ret);
+            cfg->graph.succ[ret][0] = CFG_EXIT_NODE;
+            break;
+        }
+
+        default: {
+            int stmt = add_node(cfg, node, CFG_STMT);
+            link_to(cfg, open, stmt);
+            add_edge(open, stmt, 0);
+            break;
+        }
+    }
+}
+
+
+static void build_stmts(CFG* cfg, ASTNode* node, OpenEdges* open) {
+    for (; node; node = node->next) {
+        build_stmt(cfg, node, open);
+    }
+}
+
+
+CFG* build_cfg(ASTNode* function) {
+    CFG* cfg = cfg_alloc(NULL, sizeof(CFG));
+    memset(cfg, 0, sizeof(CFG));
+
+    OpenEdges open = {0};
+    int entry = add_node(cfg, NULL, CFG_ENTRY);
+    add_node(cfg, NULL, CFG_EXIT);
+    add_edge(&open, entry, 0);
+    if (function && function->type == NODE_FUNC_DEF) {
+        build_stmts(cfg, function->left, &open);
+    }
+    link_to(cfg, &open, CFG_EXIT_NODE);
+    free(open.edges);
+
+    flow_analyze(&cfg->graph);
+    return cfg;
+}
+
+
+int cfg_node(const CFG* cfg, ASTNode* stmt) {
+    if (!stmt || !cfg->index_capacity) return -1;
+
+    unsigned int j = slot_of(stmt->id, cfg->index_capacity);
+    for (; cfg->index[j] >= 0; j = (j + 1) & (cfg->index_capacity - 1)) {
+        if (cfg->nodes[cfg->index[j]] == stmt) return cfg->index[j];
+    }
+    return -1;
+}
+
+
+bool cfg_reachable(const CFG* cfg, ASTNode* stmt) {
+    int at = cfg_node(cfg, stmt);
+    return at >= 0 && cfg->graph.order[at] >= 0;
+}
+
+
+bool cfg_dominates(const CFG* cfg, ASTNode* a, ASTNode* b) {
+    return flow_dominates(&cfg->graph, cfg_node(cfg, a), cfg_node(cfg, b));
+}
+
+
+void free_cfg(CFG* cfg) {
+    if (!cfg) return;
+    flow_free(&cfg->graph);
+    free(cfg->nodes);
+    free(cfg->kinds);
+    free(cfg->index);
+    free(cfg);
+}
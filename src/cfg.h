@@ -0,0 +1,66 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+
+/* A graph whose nodes have at most two successors, node 0 being the entry.
+   flow_analyze() fills in predecessors, reverse postorder and immediate
+   dominators; nodes not reachable from the entry get order -1 and no
+   dominator. The graph owns `succ`. */
+typedef struct {
+    int count;
+    int (*succ)[2];     // -1 when absent
+    int* pred_start;    // predecessors of n are preds[pred_start[n] .. pred_start[n + 1])
+    int* preds;
+    int* rpo;
+    int rpo_count;
+    int* order;         // position in rpo
+    int* idom;
+    int* child_start;   // dominator tree, laid out like preds
+    int* children;
+} FlowGraph;
+
+
+void flow_analyze(FlowGraph* graph);
+
+bool flow_dominates(const FlowGraph* graph, int a, int b);
+
+void flow_free(FlowGraph* graph);
+
+
+/* Statement-level control flow of one function. Every statement is a
+   node; the condition of an if or for is a branch node and a for update is
+   a node of its own. Branches on constant conditions only get the edge
+   that can be taken. */
+typedef enum {
+    CFG_ENTRY,
+    CFG_EXIT,
+    CFG_STMT,
+    CFG_BRANCH,
+    CFG_UPDATE
+} CFGKind;
+
+
+typedef struct {
+    ASTNode** nodes;    // statement behind each node, NULL for entry and exit
+    uint8_t* kinds;     // CFGKind
+    FlowGraph graph;
+    int capacity;
+    int* index;         // open-addressed by node id
+    int index_capacity;
+} CFG;
+
+
+CFG* build_cfg(ASTNode* function);
+
+int cfg_node(const CFG* cfg, ASTNode* stmt);
+
+bool cfg_reachable(const CFG* cfg, ASTNode* stmt);
+
+bool cfg_dominates(const CFG* cfg, ASTNode* a, ASTNode* b);
+
+void free_cfg(CFG* cfg);
+
+#endif
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "daemon.h"
+
+
+/* The parser, node ids and source locations are process-wide, so requests
+   go through the pipeline one at a time. Clients still read and write
+   their frames concurrently, and each request's optimization is itself
+   spread over the worker threads. */
+static pthread_mutex_t pipeline_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    int fd;
+    DaemonHandler handler;
+} Client;
+
+
+static void* daemon_alloc(void* ptr, size_t size) {
+    void* mem = realloc(ptr, size ? size : 1);
+    if (!mem) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return mem;
+}
+
+
+static bool read_all(int fd, void* data, size_t size) {
+    char* bytes = (char*)data;
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+
+static bool write_all(int fd, const void* data, size_t size) {
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+
+static bool write_u32(int fd, uint32_t value) {
+    uint32_t wire = htonl(value);
+    return write_all(fd, &wire, sizeof(wire));
+}
+
+
+static bool read_u32(int fd, uint32_t* value) {
+    uint32_t wire;
+    if (!read_all(fd, &wire, sizeof(wire))) return false;
+    *value = ntohl(wire);
+    return true;
+}
+
+
+// Returns the frame in a malloc'ed buffer, or NULL at end of stream
+static char* read_frame(int fd, uint32_t* length) {
+    if (!read_u32(fd, length) || *length > DAEMON_MAX_FRAME) return NULL;
+
+    char* frame = daemon_alloc(NULL, *length);
+    if (!read_all(fd, frame, *length)) {
+        free(frame);
+        return NULL;
+    }
+    return frame;
+}
+
+
+static uint64_t reply_length(size_t lengths[REPLY_SECTIONS]) {
+    uint64_t length = 1;
+    for (int s = 0; s < REPLY_SECTIONS; s++) {
+        length += sizeof(uint32_t) + lengths[s];
+    }
+    return length;
+}
+
+
+// Replaces the sections with a message for the client to show
+static int error_reply(char* sections[REPLY_SECTIONS], size_t lengths[REPLY_SECTIONS], const char* message) {
+    for (int s = 0; s < REPLY_SECTIONS; s++) {
+        free(sections[s]);
+        sections[s] = NULL;
+        lengths[s] = 0;
+    }
+    sections[REPLY_DIAGNOSTICS] = strdup(message);
+    lengths[REPLY_DIAGNOSTICS] = sections[REPLY_DIAGNOSTICS] ? strlen(message) : 0;
+    return DAEMON_ERROR;
+}
+
+
+static bool send_reply(int fd, int status, char* sections[REPLY_SECTIONS], size_t lengths[REPLY_SECTIONS]) {
+    uint64_t length = reply_length(lengths);
+    if (length > DAEMON_MAX_FRAME) return false;
+
+    uint8_t status_byte = (uint8_t)status;
+    if (!write_u32(fd, (uint32_t)length) || !write_all(fd, &status_byte, 1)) return false;
+    for (int s = 0; s < REPLY_SECTIONS; s++) {
+        if (!write_u32(fd, (uint32_t)lengths[s]) || !write_all(fd, sections[s], lengths[s])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static int run_request(DaemonHandler handler, const DaemonRequest* request,
+                       char* sections[REPLY_SECTIONS], size_t lengths[REPLY_SECTIONS]) {
+    FILE* streams[REPLY_SECTIONS];
+    for (int s = 0; s < REPLY_SECTIONS; s++) {
+        sections[s] = NULL;
+        streams[s] = open_memstream(&sections[s], &lengths[s]);
+        if (!streams[s]) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+
+    pthread_mutex_lock(&pipeline_lock);
+    int status = handler(request, streams);
+    pthread_mutex_unlock(&pipeline_lock);
+
+    for (int s = 0; s < REPLY_SECTIONS; s++) {
+        fclose(streams[s]);
+    }
+    return status;
+}
+
+
+static void* serve_client(void* arg) {
+    Client* client = (Client*)arg;
+    uint32_t length;
+    char* frame;
+
+    while ((frame = read_frame(client->fd, &length)) != NULL) {
+        char* sections[REPLY_SECTIONS];
+        size_t lengths[REPLY_SECTIONS];
+        int status;
+
+        if (length < 2 || (frame[0] != DAEMON_SOURCE && frame[0] != DAEMON_AST)) {
+            for (int s = 0; s < REPLY_SECTIONS; s++) {
+                sections[s] = NULL;
+            }
+            status = error_reply(sections, lengths, "Bad request\n");
+        } else {
+            DaemonRequest request = { (uint8_t)frame[0], (uint8_t)frame[1], frame + 2, length - 2 };
+            status = run_request(client->handler, &request, sections, lengths);
+        }
+        free(frame);
+
+        // Clients refuse frames over the limit, so say why instead
+        uint64_t reply = reply_length(lengths);
+        if (reply > DAEMON_MAX_FRAME) {
+            char message[128];
+            snprintf(message, sizeof(message), "Reply of %llu bytes exceeds the %u MB frame limit\n",
+                     (unsigned long long)reply, DAEMON_MAX_FRAME >> 20);
+            status = error_reply(sections, lengths, message);
+        }
+
+        bool sent = send_reply(client->fd, status, sections, lengths);
+        for (int s = 0; s < REPLY_SECTIONS; s++) {
+            free(sections[s]);
+        }
+        if (!sent) break;
+    }
+
+    close(client->fd);
+    free(client);
+    return NULL;
+}
+
+
+static bool make_address(const char* socket_path, struct sockaddr_un* address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", socket_path);
+        return false;
+    }
+    strcpy(address->sun_path, socket_path);
+    return true;
+}
+
+
+int run_daemon(const char* socket_path, DaemonHandler handler) {
+    struct sockaddr_un address;
+    if (!make_address(socket_path, &address)) return 1;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    // A socket left behind by an earlier daemon is replaced, anything else kept
+    struct stat existing;
+    if (lstat(socket_path, &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            fprintf(stderr, "%s: exists and is not a socket\n", socket_path);
+            close(listener);
+            return 1;
+        }
+        unlink(socket_path);
+    }
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        perror(socket_path);
+        close(listener);
+        return 1;
+    }
+
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            close(listener);
+            return 1;
+        }
+
+        Client* client = daemon_alloc(NULL, sizeof(Client));
+        client->fd = fd;
+        client->handler = handler;
+
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serve_client, client) != 0) {
+            close(fd);
+            free(client);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+
+int daemon_request(const char* socket_path, const DaemonRequest* request,
+                   char* sections[REPLY_SECTIONS], size_t lengths[REPLY_SECTIONS]) {
+    for (int s = 0; s < REPLY_SECTIONS; s++) {
+        sections[s] = NULL;
+        lengths[s] = 0;
+    }
+
+    struct sockaddr_un address;
+    if (!make_address(socket_path, &address)) return -1;
+    if (request->length + 2 > DAEMON_MAX_FRAME) {
+        fprintf(stderr, "%s: request too large\n", socket_path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        perror(socket_path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    uint8_t head[2] = { request->kind, request->flags };
+    uint32_t length;
+    char* reply = NULL;
+    bool ok = write_u32(fd, (uint32_t)(request->length + 2)) && write_all(fd, head, 2) &&
+              write_all(fd, request->body, request->length) &&
+              (reply = read_frame(fd, &length)) != NULL && length >= 1;
+    close(fd);
+
+    // Sections are copied out of the frame so each can be freed on its own
+    int status = ok ? (uint8_t)reply[0] : -1;
+    size_t at = 1;
+    for (int s = 0; ok && s < REPLY_SECTIONS; s++) {
+        uint32_t wire;
+        ok = at + sizeof(wire) <= length;
+        if (!ok) break;
+        memcpy(&wire, reply + at, sizeof(wire));
+        at += sizeof(wire);
+        lengths[s] = ntohl(wire);
+        ok = lengths[s] <= length - at;
+        if (!ok) break;
+        sections[s] = daemon_alloc(NULL, lengths[s]);
+        memcpy(sections[s], reply + at, lengths[s]);
+        at += lengths[s];
+    }
+    free(reply);
+
+    if (!ok) {
+        for (int s = 0; s < REPLY_SECTIONS; s++) {
+            free(sections[s]);
+            sections[s] = NULL;
+            lengths[s] = 0;
+        }
+        fprintf(stderr, "%s: no valid reply from the daemon\n", socket_path);
+        return -1;
+    }
+    return status;
+}
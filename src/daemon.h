@@ -0,0 +1,59 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/* Local socket protocol. Every message is a frame: a 32-bit length in
+   network byte order followed by that many bytes. A client may send any
+   number of requests on one connection and reads one reply per request.
+
+   Request:  u8 kind, u8 flags, body (C source, or an ASTStore as written
+             by ast_store_write() for DAEMON_AST)
+   Reply:    u8 status (what `./ast` would exit with), then each section
+             as a 32-bit length and its bytes, in ReplySection order.
+             A DAEMON_ERROR reply has only a message in REPLY_DIAGNOSTICS:
+             the request was malformed or its reply over DAEMON_MAX_FRAME. */
+
+#define DAEMON_SOURCE 1
+#define DAEMON_AST    2
+
+#define DAEMON_WANT_IR     0x01
+#define DAEMON_INCREMENTAL 0x02
+#define DAEMON_STATS       0x04
+
+#define DAEMON_MAX_FRAME (64u << 20)
+
+#define DAEMON_ERROR 2
+
+typedef enum {
+    REPLY_OUTPUT,           // output.txt
+    REPLY_DIAGNOSTICS,      // parse errors
+    REPLY_IR,               // ir.txt, with DAEMON_WANT_IR
+    REPLY_IR_CODE,          // ir_output.c, with DAEMON_WANT_IR
+    REPLY_STATS,            // stats.json, with DAEMON_STATS
+    REPLY_SECTIONS
+} ReplySection;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t flags;
+    const char* body;
+    size_t length;
+} DaemonRequest;
+
+/* Runs one request, writing each section to its stream, and returns the
+   status. Handlers are called one at a time. */
+typedef int (*DaemonHandler)(const DaemonRequest* request, FILE* sections[REPLY_SECTIONS]);
+
+
+// Serves until the process is killed; returns only if the socket cannot be set up
+int run_daemon(const char* socket_path, DaemonHandler handler);
+
+// Sends one request and fills `sections` with malloc'ed copies of the reply
+int daemon_request(const char* socket_path, const DaemonRequest* request,
+                   char* sections[REPLY_SECTIONS], size_t lengths[REPLY_SECTIONS]);
+
+#endif
@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "dependence.h"
+
+/* Def/use facts are computed bottom-up and cached by node id, one cache per
+   thread since functions are optimized in parallel. Passes that rewrite
+   the tree call dependence_invalidate(), which bumps the cache epoch so
+   every entry is recomputed on its next query. Node ids are never reused,
+   so an entry can only ever describe the node it was computed for. */
+
+typedef struct {
+    int id;
+    unsigned epoch;
+    DefUse* facts;
+} CacheEntry;
+
+typedef struct {
+    CacheEntry* entries;
+    int capacity;
+    int count;
+    char** names;
+    int name_capacity;
+    int name_count;
+    unsigned epoch;
+} DependenceCache;
+
+static __thread DependenceCache cache;
+
+
+static void* dep_alloc(void* ptr, size_t size) {
+    void* mem = realloc(ptr, size ? size : 1);
+    if (!mem) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return mem;
+}
+
+
+static unsigned long hash_string(const char* name) {
+    unsigned long h = 5381;
+    while (*name) {
+        h = h * 33 + (unsigned char)*name++;
+    }
+    return h;
+}
+
+
+static const char* intern(const char* name, bool create) {
+    if (create && (cache.name_count + 1) * 2 > cache.name_capacity) {
+        int capacity = cache.name_capacity ? cache.name_capacity * 2 : 64;
+        char** names = dep_alloc(NULL, capacity * sizeof(char*));
+        memset(names, 0, capacity * sizeof(char*));
+        for (int i = 0; i < cache.name_capacity; i++) {
+            if (!cache.names[i]) continue;
+            int j = (int)(hash_string(cache.names[i]) & (capacity - 1));
+            while (names[j]) j = (j + 1) & (capacity - 1);
+            names[j] = cache.names[i];
+        }
+        free(cache.names);
+        cache.names = names;
+        cache.name_capacity = capacity;
+    }
+    if (!cache.name_capacity) return NULL;
+
+    int mask = cache.name_capacity - 1;
+    for (int i = (int)(hash_string(name) & mask); ; i = (i + 1) & mask) {
+        if (!cache.names[i]) {
+            if (!create) return NULL;
+            cache.names[i] = strdup(name);
+            if (!cache.names[i]) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            cache.name_count++;
+            return cache.names[i];
+        }
+        if (strcmp(cache.names[i], name) == 0) return cache.names[i];
+    }
+}
+
+
+static int compare_names(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)*(const char* const*)a;
+    uintptr_t y = (uintptr_t)*(const char* const*)b;
+    return (x > y) - (x < y);
+}
+
+
+/* Sets are assembled from the node's own names plus its children's sets,
+   then sorted and deduplicated once. */
+typedef struct {
+    const char** names;
+    int count;
+    int capacity;
+} NameBuffer;
+
+
+static void buffer_add(NameBuffer* buffer, const char* name) {
+    if (buffer->count == buffer->capacity) {
+        buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 8;
+        buffer->names = dep_alloc(buffer->names, buffer->capacity * sizeof(char*));
+    }
+    buffer->names[buffer->count++] = name;
+}
+
+
+static void buffer_add_set(NameBuffer* buffer, const NameSet* set) {
+    for (int i = 0; i < set->count; i++) {
+        buffer_add(buffer, set->names[i]);
+    }
+}
+
+
+static NameSet buffer_to_set(NameBuffer* buffer) {
+    NameSet set = { buffer->names, 0 };
+    if (buffer->count == 0) {
+        free(buffer->names);
+        set.names = NULL;
+        return set;
+    }
+
+    qsort(buffer->names, buffer->count, sizeof(char*), compare_names);
+    for (int i = 0; i < buffer->count; i++) {
+        if (set.count == 0 || set.names[set.count - 1] != buffer->names[i]) {
+            set.names[set.count++] = buffer->names[i];
+        }
+    }
+    return set;
+}
+
+
+static void free_def_use(DefUse* facts) {
+    if (!facts) return;
+    free(facts->reads.names);
+    free(facts->writes.names);
+    free(facts->decls.names);
+    free(facts);
+}
+
+
+static CacheEntry* cache_slot(int id) {
+    if ((cache.count + 1) * 2 > cache.capacity) {
+        // Entries from older epochs are dropped while rehashing
+        int capacity = cache.capacity ? cache.capacity * 2 : 256;
+        CacheEntry* entries = dep_alloc(NULL, capacity * sizeof(CacheEntry));
+        memset(entries, 0, capacity * sizeof(CacheEntry));
+        cache.count = 0;
+        for (int i = 0; i < cache.capacity; i++) {
+            CacheEntry* entry = &cache.entries[i];
+            if (!entry->facts) continue;
+            if (entry->epoch != cache.epoch) {
+                free_def_use(entry->facts);
+                continue;
+            }
+            int j = (int)((unsigned)entry->id * 2654435761u) & (capacity - 1);
+            while (entries[j].facts) j = (j + 1) & (capacity - 1);
+            entries[j] = *entry;
+            cache.count++;
+        }
+        free(cache.entries);
+        cache.entries = entries;
+        cache.capacity = capacity;
+    }
+
+    int mask = cache.capacity - 1;
+    for (int i = (int)((unsigned)id * 2654435761u) & mask; ; i = (i + 1) & mask) {
+        CacheEntry* entry = &cache.entries[i];
+        if (!entry->facts || entry->id == id) return entry;
+    }
+}
+
+
+static DefUse* compute_def_use(ASTNode* node) {
+    DefUse* facts = dep_alloc(NULL, sizeof(DefUse));
+    memset(facts, 0, sizeof(DefUse));
+    NameBuffer reads = {0};
+    NameBuffer writes = {0};
+    NameBuffer decls = {0};
+
+    switch (node->type) {
+        case NODE_VAR:
+            buffer_add(&reads, intern(node->value, true));
+            break;
+        case NODE_DECL:
+            buffer_add(&decls, intern(node->value, true));
+            break;
+        case NODE_ASSIGN:
+            buffer_add(&writes, intern(node->value, true));
+            break;
+        case NODE_UNARY:
+            if (node->left && node->left->type == NODE_VAR) {
+                buffer_add(&writes, intern(node->left->value, true));
+            }
+            break;
+        case NODE_FUNC_CALL:
+            facts->calls = true;
+            break;
+        case NODE_RETURN:
+            facts->returns = true;
+            break;
+        case NODE_FOR:
+            facts->loops = true;
+            break;
+        default:
+            break;
+    }
+
+    for (int k = 0; k < ast_slot_count(node->type); k++) {
+        for (ASTNode* child = node->child[k]; child; child = child->next) {
+            const DefUse* sub = def_use(child);
+            buffer_add_set(&reads, &sub->reads);
+            buffer_add_set(&writes, &sub->writes);
+            buffer_add_set(&decls, &sub->decls);
+            facts->calls |= sub->calls;
+            facts->returns |= sub->returns;
+            facts->loops |= sub->loops;
+        }
+    }
+
+    facts->reads = buffer_to_set(&reads);
+    facts->writes = buffer_to_set(&writes);
+    facts->decls = buffer_to_set(&decls);
+    return facts;
+}
+
+
+const DefUse* def_use(ASTNode* node) {
+    static const DefUse empty = {0};
+    if (!node) return &empty;
+
+    CacheEntry* entry = cache_slot(node->id);
+    if (entry->facts && entry->epoch == cache.epoch) return entry->facts;
+
+    DefUse* facts = compute_def_use(node);
+
+    // Computing the children may have grown the table and moved the entry
+    entry = cache_slot(node->id);
+    if (entry->facts) {
+        free_def_use(entry->facts);
+    } else {
+        cache.count++;
+    }
+    entry->id = node->id;
+    entry->epoch = cache.epoch;
+    entry->facts = facts;
+    return facts;
+}
+
+
+bool name_set_has(const NameSet* set, const char* name) {
+    const char* key = intern(name, false);
+    if (!key || set->count == 0) return false;
+    return bsearch(&key, set->names, set->count, sizeof(char*), compare_names) != NULL;
+}
+
+
+bool name_sets_overlap(const NameSet* a, const NameSet* b) {
+    int i = 0;
+    int j = 0;
+    while (i < a->count && j < b->count) {
+        if (a->names[i] == b->names[j]) return true;
+        if ((uintptr_t)a->names[i] < (uintptr_t)b->names[j]) i++;
+        else j++;
+    }
+    return false;
+}
+
+
+bool changes_var(const DefUse* facts, const char* name) {
+    return name_set_has(&facts->writes, name) || name_set_has(&facts->decls, name);
+}
+
+
+static bool changes_any(const DefUse* a, const NameSet* names) {
+    return name_sets_overlap(&a->writes, names) || name_sets_overlap(&a->decls, names);
+}
+
+
+/* Two pieces of code can run in either order, or interleaved, when neither
+   changes a variable the other touches and at most one of them calls out. */
+bool independent(const DefUse* a, const DefUse* b) {
+    if (a->calls && b->calls) return false;
+    return !changes_any(a, &b->reads) && !changes_any(a, &b->writes) && !changes_any(a, &b->decls) &&
+           !changes_any(b, &a->reads);
+}
+
+
+static bool is_named_var(ASTNode* node, const char* name) {
+    return node && node->type == NODE_VAR && strcmp(node->value, name) == 0;
+}
+
+
+static bool is_int(ASTNode* node) {
+    return node && node->type == NODE_INT;
+}
+
+
+// Recognizes i++, i--, i = i + k, i = k + i and i = i - k.
+bool induction_step(ASTNode* update, const char* name, int* step) {
+    if (update->type == NODE_UNARY && is_named_var(update->left, name)) {
+        *step = strcmp(update->value, "++") == 0 ? 1 : -1;
+        return true;
+    }
+    if (update->type != NODE_ASSIGN || strcmp(update->value, name) != 0) return false;
+
+    ASTNode* value = update->left;
+    if (!value || value->type != NODE_BINOP) return false;
+    if (strcmp(value->value, "+") == 0) {
+        if (is_named_var(value->left, name) && is_int(value->right)) *step = atoi(value->right->value);
+        else if (is_int(value->left) && is_named_var(value->right, name)) *step = atoi(value->left->value);
+        else return false;
+    } else if (strcmp(value->value, "-") == 0 && is_named_var(value->left, name) && is_int(value->right)) {
+        *step = -atoi(value->right->value);
+    } else {
+        return false;
+    }
+    return *step != 0;
+}
+
+
+/* The loop test OpenMP accepts: the induction variable on one side of a
+   relational operator, or of != when it steps by one, and a bound on the
+   other side that does not read it. */
+static bool canonical_test(ASTNode* cond, const char* name, int step) {
+    if (cond->type != NODE_BINOP) return false;
+
+    const char* op = cond->value;
+    bool relational = strcmp(op, "<") == 0 || strcmp(op, "<=") == 0 ||
+                      strcmp(op, ">") == 0 || strcmp(op, ">=") == 0;
+    if (!relational && !(strcmp(op, "!=") == 0 && (step == 1 || step == -1))) return false;
+
+    ASTNode* bound;
+    if (is_named_var(cond->left, name)) bound = cond->right;
+    else if (is_named_var(cond->right, name)) bound = cond->left;
+    else return false;
+    return bound && !name_set_has(&def_use(bound)->reads, name);
+}
+
+
+/* `s = s op e` or `s = e op s` with e not reading s; ++ and -- count as
+   sums. Subtraction is a sum of negated terms. */
+static bool reduction_update(ASTNode* node, const char* name, const char** op) {
+    if (node->type == NODE_UNARY) {
+        *op = "+";
+        return true;
+    }
+
+    ASTNode* value = node->left;
+    if (!value || value->type != NODE_BINOP) return false;
+    if (strcmp(value->value, "+") != 0 && strcmp(value->value, "-") != 0 &&
+        strcmp(value->value, "*") != 0) return false;
+
+    ASTNode* other;
+    if (is_named_var(value->left, name)) other = value->right;
+    else if (is_named_var(value->right, name) && strcmp(value->value, "-") != 0) other = value->left;
+    else return false;
+
+    *op = strcmp(value->value, "*") == 0 ? "*" : "+";
+    return !name_set_has(&def_use(other)->reads, name);
+}
+
+
+/* Walks the body checking every write of `name` is a reduction update with
+   the same operator, and counts them along with the reads of `name`. */
+static bool scan_reduction(ASTNode* node, const char* name, const char** op, int* updates, int* reads) {
+    if (!node) return true;
+
+    if (is_named_var(node, name)) (*reads)++;
+
+    bool writes = (node->type == NODE_ASSIGN && strcmp(node->value, name) == 0) ||
+                  (node->type == NODE_UNARY && is_named_var(node->left, name));
+    if (writes) {
+        const char* this_op;
+        if (!reduction_update(node, name, &this_op)) return false;
+        if (*op && strcmp(*op, this_op) != 0) return false;
+        *op = this_op;
+        (*updates)++;
+    }
+
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        if (!scan_reduction(node->child[i], name, op, updates, reads)) return false;
+    }
+    return scan_reduction(node->next, name, op, updates, reads);
+}
+
+
+static void add_loop_var(LoopDeps* deps, const char* name, LoopVarKind kind, const char* op) {
+    deps->vars = dep_alloc(deps->vars, (deps->var_count + 1) * sizeof(LoopVar));
+    deps->vars[deps->var_count].name = name;
+    deps->vars[deps->var_count].kind = kind;
+    deps->vars[deps->var_count].op = op;
+    deps->var_count++;
+}
+
+
+/* Classifies every variable a loop changes. A variable declared in the
+   body is private to an iteration; one only ever accumulated into, and
+   read nowhere else, is a reduction; anything else carries a value from
+   one iteration to the next. Returns false for malformed loops. */
+static int compare_loop_vars(const void* a, const void* b) {
+    return strcmp(((const LoopVar*)a)->name, ((const LoopVar*)b)->name);
+}
+
+
+bool analyze_loop(ASTNode* loop, LoopDeps* deps) {
+    memset(deps, 0, sizeof(LoopDeps));
+    ASTNode* init = loop->child[FOR_INIT];
+    ASTNode* cond = loop->child[FOR_COND];
+    ASTNode* update = loop->child[FOR_UPDATE];
+    ASTNode* body = loop->child[FOR_BODY];
+    if (loop->type != NODE_FOR || !cond || !update) return false;
+
+    const DefUse* facts = def_use(body);
+    if (init && (init->type == NODE_DECL || init->type == NODE_ASSIGN) && init->left &&
+        !name_set_has(&def_use(init->left)->reads, init->value) &&
+        induction_step(update, init->value, &deps->step) &&
+        canonical_test(cond, init->value, deps->step) &&
+        !changes_var(facts, init->value)) {
+        deps->induction = intern(init->value, true);
+        add_loop_var(deps, deps->induction, LOOP_VAR_INDUCTION, NULL);
+    }
+
+    for (int i = 0; i < facts->decls.count; i++) {
+        add_loop_var(deps, facts->decls.names[i], LOOP_VAR_PRIVATE, NULL);
+    }
+    for (int i = 0; i < facts->writes.count; i++) {
+        const char* name = facts->writes.names[i];
+        if (name == deps->induction || name_set_has(&facts->decls, name)) continue;
+
+        const char* op = NULL;
+        int updates = 0;
+        int reads = 0;
+        bool reduction = scan_reduction(body, name, &op, &updates, &reads) && reads == updates;
+        add_loop_var(deps, name, reduction ? LOOP_VAR_REDUCTION : LOOP_VAR_CARRIED, reduction ? op : NULL);
+    }
+
+    // Sets are ordered by address; callers that print want a stable order
+    qsort(deps->vars, deps->var_count, sizeof(LoopVar), compare_loop_vars);
+    return true;
+}
+
+
+void free_loop_deps(LoopDeps* deps) {
+    free(deps->vars);
+    deps->vars = NULL;
+    deps->var_count = 0;
+}
+
+
+void dependence_invalidate(void) {
+    cache.epoch++;
+}
+
+
+void dependence_reset(void) {
+    for (int i = 0; i < cache.capacity; i++) {
+        free_def_use(cache.entries[i].facts);
+    }
+    for (int i = 0; i < cache.name_capacity; i++) {
+        free(cache.names[i]);
+    }
+    free(cache.entries);
+    free(cache.names);
+    memset(&cache, 0, sizeof(cache));
+}
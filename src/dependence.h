@@ -0,0 +1,76 @@
+#ifndef DEPENDENCE_H
+#define DEPENDENCE_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+
+/* Variable names seen by the analysis are interned per thread, so a set is
+   a sorted array of unique pointers and comparing names is comparing
+   pointers. Interned names stay valid until dependence_reset(). */
+typedef struct {
+    const char** names;
+    int count;
+} NameSet;
+
+
+/* What a node and everything below it does, not counting the statements
+   chained after it through `next`. */
+typedef struct {
+    NameSet reads;
+    NameSet writes;     // assignments and ++/--
+    NameSet decls;
+    bool calls;
+    bool returns;
+    bool loops;
+} DefUse;
+
+
+typedef enum {
+    LOOP_VAR_INDUCTION,
+    LOOP_VAR_PRIVATE,
+    LOOP_VAR_REDUCTION,
+    LOOP_VAR_CARRIED
+} LoopVarKind;
+
+
+typedef struct {
+    const char* name;
+    LoopVarKind kind;
+    const char* op;     // "+" or "*" for reductions
+} LoopVar;
+
+
+/* Scalar dependences of one loop. `induction` is set when the header has
+   the canonical form OpenMP requires, `v = start; v op bound; v stepped by
+   a constant` with neither start nor bound reading v and op relational,
+   and `vars` lists every variable the loop changes. */
+typedef struct {
+    const char* induction;
+    int step;
+    LoopVar* vars;
+    int var_count;
+} LoopDeps;
+
+
+const DefUse* def_use(ASTNode* node);
+
+bool name_set_has(const NameSet* set, const char* name);
+
+bool name_sets_overlap(const NameSet* a, const NameSet* b);
+
+bool changes_var(const DefUse* facts, const char* name);
+
+bool independent(const DefUse* a, const DefUse* b);
+
+bool induction_step(ASTNode* update, const char* name, int* step);
+
+bool analyze_loop(ASTNode* loop, LoopDeps* deps);
+
+void free_loop_deps(LoopDeps* deps);
+
+void dependence_invalidate(void);
+
+void dependence_reset(void);
+
+#endif
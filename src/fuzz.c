@@ -0,0 +1,733 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "ast.h"
+#include "ir.h"
+#include "memtrack.h"
+#include "srcloc.h"
+
+extern ASTNode* ast_root;
+extern int parse_error_count;
+extern FILE* parse_error_output;
+int parse_program(void);
+void lexer_set_text(const char* text, size_t length);
+
+
+/* Differential fuzzer. Each case is a random program in the language of
+   parser.y with a main() that prints what its functions compute. The
+   program is optimized in a child process watched for crashes, timeouts,
+   running out of memory and leaked nodes; then the original, the code
+   `regen` writes back from the optimized AST and the C emitted from the
+   IR are compiled with the system compiler and must print the same lines
+   and exit with the same status; the regenerated code is compiled a
+   second time with -fopenmp-simd so its simd loops are checked too.
+   Generated programs stay clear of undefined behaviour: divisors are
+   non-zero literals, variables are initialized and calls only go to
+   earlier functions, and the compiler is asked for wrapping arithmetic.
+   Loops are bounded by constants or by `n`, a parameter every call passes
+   a small literal for, and by loop variables, none of which the program
+   assigns or shadows, so every loop runs a bounded number of times. */
+
+#define MAX_VARS 64
+#define MAX_NAME 16
+
+// Exit codes of the optimizer child
+#define CHILD_PARSE_ERROR 3
+#define CHILD_LEAK 4
+#define CHILD_OUT_OF_MEMORY 1
+
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+} Source;
+
+typedef struct {
+    char name[MAX_NAME];
+    bool fixed;                 // `n` and loop variables: small, never assigned or shadowed
+} Var;
+
+typedef struct {
+    unsigned rng;
+    int functions;
+    int statements;             // most statements per block
+    int depth;                  // most levels of operators per expression
+    int function;               // being generated; calls go to lower numbers
+    int loop_depth;
+    bool called;                // expression already has its call
+    int next_name;
+    Var vars[MAX_VARS];
+    int var_count;
+    int scope;                  // first variable of the innermost block
+    const char* hidden;         // being declared, so its initializer may not read it
+} Generator;
+
+typedef struct {
+    const char* compiler;
+    const char* regen;
+    int timeout;                // seconds per step
+    long memory_mb;             // address space of each step
+} FuzzConfig;
+
+
+static void emit(Source* source, const char* format, ...) {
+    va_list args;
+    for (;;) {
+        va_start(args, format);
+        size_t room = source->capacity - source->length;
+        int n = vsnprintf(source->text + source->length, room, format, args);
+        va_end(args);
+        if (n >= 0 && (size_t)n < room) {
+            source->length += (size_t)n;
+            return;
+        }
+        source->capacity = source->capacity * 2 + (n > 0 ? (size_t)n : 0);
+        source->text = realloc(source->text, source->capacity);
+        if (!source->text) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+}
+
+
+static unsigned next_random(unsigned* state) {
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+
+static int pick(Generator* g, int bound) {
+    return (int)(next_random(&g->rng) % (unsigned)bound);
+}
+
+
+static const char* declare(Generator* g, const char* prefix, bool fixed) {
+    Var* var = &g->vars[g->var_count++];
+    snprintf(var->name, sizeof(var->name), "%s%d", prefix, g->next_name++);
+    var->fixed = fixed;
+    return var->name;
+}
+
+
+// A variable of an enclosing block a new declaration may hide, or NULL
+static const Var* shadowable(Generator* g) {
+    if (g->scope == 0) return NULL;
+    const Var* var = &g->vars[pick(g, g->scope)];
+    if (var->fixed) return NULL;
+    for (int i = g->scope; i < g->var_count; i++) {
+        // Already hidden by this block
+        if (strcmp(g->vars[i].name, var->name) == 0) return NULL;
+    }
+    return var;
+}
+
+
+static const Var* bound_var(Generator* g) {
+    int start = pick(g, g->var_count);
+    for (int i = 0; i < g->var_count; i++) {
+        const Var* var = &g->vars[(start + i) % g->var_count];
+        if (var->fixed) return var;
+    }
+    return NULL;
+}
+
+
+static void emit_indent(Source* out, int level) {
+    emit(out, "%*s", level * 4, "");
+}
+
+
+/* No parentheses in the grammar: operators are laid out flat and the
+   precedence of C, which parser.y shares, groups them. A division is
+   always followed by its literal divisor, so it divides by that. */
+static void emit_expr(Source* out, Generator* g, int depth) {
+    static const char* operators[] = {
+        "+", "-", "*", "/", "<", "<=", ">", ">=", "==", "!="
+    };
+
+    if (depth > 0 && pick(g, 4) != 0) {
+        emit_expr(out, g, depth - 1);
+        const char* op = operators[pick(g, 10)];
+        if (strcmp(op, "/") == 0) {
+            emit(out, " / %d", 1 + pick(g, 9));
+        } else {
+            emit(out, " %s ", op);
+            emit_expr(out, g, depth - 1);
+        }
+        return;
+    }
+
+    int choice = pick(g, 10);
+    if (choice < 3 || g->var_count == 0) {
+        emit(out, "%d", pick(g, 100));
+    } else if (choice == 9 && g->function > 0 && g->loop_depth == 0 && !g->called) {
+        /* Calls stay out of loops so nested calls cannot multiply the run
+           time, and one per expression as C leaves the order of operands
+           unspecified and callees print. */
+        g->called = true;
+        emit(out, "f%d(", pick(g, g->function));
+        emit_expr(out, g, depth > 0 ? depth - 1 : 0);
+        emit(out, ", ");
+        emit_expr(out, g, depth > 0 ? depth - 1 : 0);
+        emit(out, ", %d)", pick(g, 10));
+    } else {
+        const char* name = g->vars[pick(g, g->var_count)].name;
+        if (g->hidden && strcmp(name, g->hidden) == 0) emit(out, "%d", pick(g, 100));
+        else emit(out, "%s", name);
+    }
+}
+
+
+static void emit_value(Source* out, Generator* g) {
+    g->called = false;
+    emit_expr(out, g, g->depth);
+}
+
+
+static const Var* assignable(Generator* g) {
+    int start = g->var_count ? pick(g, g->var_count) : 0;
+    for (int i = 0; i < g->var_count; i++) {
+        const Var* var = &g->vars[(start + i) % g->var_count];
+        if (!var->fixed) return var;
+    }
+    return NULL;
+}
+
+
+static void emit_block(Source* out, Generator* g, int level);
+
+
+/* Writes a loop bound: a constant, or a fixed variable plus or times a
+   small constant. Either is at least zero. Returns whether it was read from
+   a variable. */
+static bool format_bound(Generator* g, char* bound, size_t size, int constant) {
+    const Var* var = pick(g, 2) ? bound_var(g) : NULL;
+    if (!var) {
+        snprintf(bound, size, "%d", constant);
+        return false;
+    }
+    switch (pick(g, 3)) {
+        case 0:
+            snprintf(bound, size, "%s", var->name);
+            break;
+        case 1:
+            snprintf(bound, size, "%s + %d", var->name, pick(g, 5));
+            break;
+        default:
+            snprintf(bound, size, "%s * %d", var->name, 1 + pick(g, 2));
+            break;
+    }
+    return true;
+}
+
+
+static void emit_loop_body(Source* out, Generator* g, int level) {
+    g->loop_depth++;
+    if (pick(g, 5) == 0) {
+        // Dead code elimination leaves the loop without a body
+        emit_indent(out, level);
+        emit(out, "if (0) {\n");
+        emit_block(out, g, level + 1);
+        emit_indent(out, level);
+        emit(out, "}\n");
+    } else {
+        emit_block(out, g, level);
+    }
+    g->loop_depth--;
+}
+
+
+/* Constant bounds get the loop unrolled, symbolic ones keep it for the
+   loop passes. Some loops are followed by a second one with the same
+   header, which fusion may merge. */
+static void emit_loop(Source* out, Generator* g, int level) {
+    int start = pick(g, 10);
+    char bound[MAX_NAME + 8];
+    bool symbolic = format_bound(g, bound, sizeof(bound), start + pick(g, 9));
+    int saved = g->var_count;
+    char header[128];
+    const char* i;
+
+    int form = pick(g, 5);
+    if (form == 4) {
+        // Declared before the loop, so its exit value stays observable
+        i = declare(g, "k", true);
+        emit_indent(out, level);
+        emit(out, "int %s = 0;\n", i);
+        emit_indent(out, level);
+        emit(out, "for (%s = %d; %s < %s; %s++) {\n", i, start, i, bound, i);
+        emit_loop_body(out, g, level + 1);
+        g->var_count = saved + 1;
+        g->vars[saved].fixed = false;
+        emit_indent(out, level);
+        emit(out, "}\n");
+        return;
+    }
+
+    i = declare(g, "i", true);
+    switch (form) {
+        case 0:
+            snprintf(header, sizeof(header), "for (int %s = %d; %s < %s; %s++) {\n", i, start, i, bound, i);
+            break;
+        case 1:
+            snprintf(header, sizeof(header), "for (int %s = %d; %s <= %s; %s = %s + %d) {\n",
+                     i, start, i, bound, i, i, 1 + pick(g, 3));
+            break;
+        case 2:
+            snprintf(header, sizeof(header), "for (int %s = %s; %s > %d; %s--) {\n", i, bound, i, start, i);
+            break;
+        default:
+            // Only a start at or below the bound ever reaches it
+            snprintf(header, sizeof(header), "for (int %s = %d; %s != %s; %s = %s + 1) {\n",
+                     i, symbolic ? 0 : start, i, bound, i, i);
+            break;
+    }
+
+    int copies = pick(g, 4) == 0 ? 2 : 1;
+    for (int copy = 0; copy < copies; copy++) {
+        emit_indent(out, level);
+        emit(out, "%s", header);
+        emit_loop_body(out, g, level + 1);
+        g->var_count = saved + 1;
+        emit_indent(out, level);
+        emit(out, "}\n");
+    }
+    g->var_count = saved;
+}
+
+
+static void emit_stmt(Source* out, Generator* g, int level) {
+    int choice = pick(g, 12);
+    const Var* target = assignable(g);
+
+    if (choice < 3 && g->var_count < MAX_VARS - 4) {
+        // Nested blocks may reuse the name of a variable around them
+        const Var* shadowed = level > 1 && pick(g, 3) == 0 ? shadowable(g) : NULL;
+        const char* name = declare(g, "v", false);
+        if (shadowed) memcpy(g->vars[g->var_count - 1].name, shadowed->name, MAX_NAME);
+
+        // The initializer may not read the variable it declares
+        g->var_count--;
+        g->hidden = name;
+        emit_indent(out, level);
+        emit(out, "int %s = ", name);
+        emit_value(out, g);
+        emit(out, ";\n");
+        g->hidden = NULL;
+        g->var_count++;
+    } else if (choice < 6 && target) {
+        emit_indent(out, level);
+        emit(out, "%s = ", target->name);
+        emit_value(out, g);
+        emit(out, ";\n");
+    } else if (choice == 6 && target) {
+        emit_indent(out, level);
+        emit(out, "%s%s;\n", target->name, pick(g, 2) ? "++" : "--");
+    } else if (choice == 7) {
+        emit_indent(out, level);
+        emit(out, "printf(\"%%d\\n\", ");
+        emit_value(out, g);
+        emit(out, ");\n");
+    } else if (choice == 8 && level < 4) {
+        int saved = g->var_count;
+        emit_indent(out, level);
+        emit(out, "if (");
+        emit_value(out, g);
+        emit(out, ") {\n");
+        if (pick(g, 4) == 0) {
+            emit_indent(out, level + 1);
+            emit(out, "return ");
+            emit_value(out, g);
+            emit(out, ";\n");
+        } else {
+            emit_block(out, g, level + 1);
+        }
+        g->var_count = saved;
+        emit_indent(out, level);
+        emit(out, "}\n");
+    } else if (choice >= 9 && g->loop_depth < 2 && level < 4) {
+        emit_loop(out, g, level);
+    } else {
+        emit_indent(out, level);
+        emit(out, "printf(\"f%d\\n\");\n", g->function);
+    }
+}
+
+
+static void emit_block(Source* out, Generator* g, int level) {
+    int saved = g->scope;
+    g->scope = g->var_count;
+    int count = 1 + pick(g, g->statements);
+    for (int s = 0; s < count; s++) {
+        emit_stmt(out, g, level);
+    }
+    g->scope = saved;
+}
+
+
+static Source generate_program(Generator* g) {
+    Source out = { malloc(4096), 0, 4096 };
+    if (!out.text) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    for (g->function = 0; g->function < g->functions; g->function++) {
+        g->var_count = 0;
+        g->next_name = 0;
+        g->loop_depth = 0;
+        g->scope = 0;
+        emit(&out, "int f%d(int a, int b, int n) {\n", g->function);
+        snprintf(g->vars[g->var_count].name, MAX_NAME, "a");
+        g->vars[g->var_count++].fixed = false;
+        snprintf(g->vars[g->var_count].name, MAX_NAME, "b");
+        g->vars[g->var_count++].fixed = false;
+        snprintf(g->vars[g->var_count].name, MAX_NAME, "n");
+        g->vars[g->var_count++].fixed = true;
+        emit_block(&out, g, 1);
+        emit(&out, "    return ");
+        emit_value(&out, g);
+        emit(&out, ";\n}\n\n");
+    }
+
+    emit(&out, "int main() {\n");
+    for (int f = 0; f < g->functions; f++) {
+        emit(&out, "    printf(\"%%d\\n\", f%d(%d, %d, %d));\n", f, pick(g, 20), pick(g, 20), pick(g, 10));
+    }
+    emit(&out, "    return %d;\n}\n", pick(g, 4));
+    return out;
+}
+
+
+static bool write_text(const char* path, const char* text, size_t length) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    fwrite(text, 1, length, file);
+    fclose(file);
+    return true;
+}
+
+
+static char* read_text(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    size_t capacity = 4096;
+    size_t n;
+    char* text = malloc(capacity);
+    *length = 0;
+    while (text && (n = fread(text + *length, 1, capacity - *length, file)) > 0) {
+        *length += n;
+        if (*length == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+    fclose(file);
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return text;
+}
+
+
+// The compiler only gets the time limit; its memory is not under test
+static void limit_child(const FuzzConfig* config, bool limit_memory) {
+    if (limit_memory) {
+        struct rlimit memory = { (rlim_t)config->memory_mb << 20, (rlim_t)config->memory_mb << 20 };
+        setrlimit(RLIMIT_AS, &memory);
+    }
+    alarm((unsigned)config->timeout);
+}
+
+
+// What the optimizer does for ./ast --ir, minus the diff and provenance
+static int optimize_case(const Source* program) {
+    FILE* out = fopen("output.txt", "w");
+    FILE* code = fopen("ir_output.c", "w");
+    if (!out || !code) return 2;
+
+    srcloc_set_text("input.c", program->text, program->length);
+    lexer_set_text(program->text, program->length);
+    parse_error_output = stderr;
+    int status = parse_program();
+    if (status != 0 || parse_error_count > 0) return CHILD_PARSE_ERROR;
+
+    fprintf(out, "Original AST:\n");
+    print_ast(ast_root, out, 0);
+    ASTNode* root = optimize_ast(ast_root);
+    fprintf(out, "Optimized AST:\n");
+    print_ast(root, out, 0);
+
+    IRModule* ir = lower_to_ir(root);
+    optimize_ir(ir);
+    emit_ir_c(ir, code);
+    free_ir(ir);
+    free_ast(root);
+    fclose(out);
+    fclose(code);
+    return report_mem_leaks(stderr, "optimizer") ? CHILD_LEAK : 0;
+}
+
+
+/* Runs `argv`, or optimize_case() when `argv` is NULL, in a child with the
+   configured limits, its output going to `output_path`. Returns the wait
+   status, or -1 when the child could not be started. */
+static int run_child(const FuzzConfig* config, char* const argv[], const Source* program,
+                     const char* output_path, bool limit_memory) {
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+
+    if (pid == 0) {
+        int fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int quiet = open("/dev/null", O_WRONLY);
+        if (fd < 0 || quiet < 0) _exit(127);
+        dup2(fd, STDOUT_FILENO);
+        if (argv) dup2(quiet, STDERR_FILENO);
+        limit_child(config, limit_memory);
+        if (!argv) _exit(optimize_case(program));
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+    }
+    return status;
+}
+
+
+// NULL when the child exited normally
+static const char* failure_kind(int status, char* buffer, size_t size) {
+    if (status < 0) return "could not start";
+    if (WIFSIGNALED(status)) {
+        if (WTERMSIG(status) == SIGALRM) return "timed out";
+        snprintf(buffer, size, "crashed with signal %d", WTERMSIG(status));
+        return buffer;
+    }
+    return NULL;
+}
+
+
+static bool same_file(const char* a, const char* b) {
+    size_t a_length, b_length;
+    char* a_text = read_text(a, &a_length);
+    char* b_text = read_text(b, &b_length);
+    bool same = a_text && b_text && a_length == b_length && memcmp(a_text, b_text, a_length) == 0;
+    free(a_text);
+    free(b_text);
+    return same;
+}
+
+
+/* With `simd`, optimized and with OpenMP simd pragmas honoured, which also
+   rejects loops that do not have the form OpenMP requires. */
+static bool compile(const FuzzConfig* config, const char* source, const char* binary, bool simd) {
+    char* argv[] = {
+        (char*)config->compiler, "-w", simd ? "-O2" : "-O0", "-fwrapv", "-include", "prelude.h",
+        "-o", (char*)binary, (char*)source, simd ? "-fopenmp-simd" : NULL, NULL
+    };
+    int status = run_child(config, argv, NULL, "compile.log", false);
+    return status >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+/* Runs a compiled program into `output` and appends its exit status so the
+   comparison covers it; returns a failure description or NULL. */
+static const char* execute(const FuzzConfig* config, const char* binary, const char* output,
+                           char* buffer, size_t size) {
+    char path[64];
+    snprintf(path, sizeof(path), "./%s", binary);
+    char* argv[] = { path, NULL };
+    int status = run_child(config, argv, NULL, output, true);
+    const char* failure = failure_kind(status, buffer, size);
+    if (failure) return failure;
+
+    FILE* file = fopen(output, "a");
+    if (file) {
+        fprintf(file, "exit %d\n", WEXITSTATUS(status));
+        fclose(file);
+    }
+    return NULL;
+}
+
+
+// Returns NULL when the case passes, otherwise what went wrong
+static const char* check_case(const FuzzConfig* config, const Source* program, bool* skipped) {
+    static char reason[128];
+    char detail[64];
+    *skipped = false;
+
+    if (!write_text("input.c", program->text, program->length)) return "cannot write input.c";
+
+    // The reference comes first: a case the compiler rejects is the generator's fault
+    if (!compile(config, "input.c", "original", false) ||
+        execute(config, "original", "original.out", detail, sizeof(detail))) {
+        *skipped = true;
+        return "original program does not compile or run";
+    }
+
+    int status = run_child(config, NULL, program, "optimizer.log", true);
+    const char* failure = failure_kind(status, detail, sizeof(detail));
+    if (failure) {
+        snprintf(reason, sizeof(reason), "optimizer %s", failure);
+        return reason;
+    }
+    switch (WEXITSTATUS(status)) {
+        case 0: break;
+        case CHILD_OUT_OF_MEMORY: return "optimizer ran out of memory";
+        case CHILD_PARSE_ERROR: return "parser rejected the program";
+        case CHILD_LEAK: return "optimizer leaked nodes";
+        default:
+            snprintf(reason, sizeof(reason), "optimizer exited with %d", WEXITSTATUS(status));
+            return reason;
+    }
+
+    char* regen[] = { (char*)config->regen, NULL };
+    status = run_child(config, regen, NULL, "regenerated.c", true);
+    failure = failure_kind(status, detail, sizeof(detail));
+    if (failure || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        snprintf(reason, sizeof(reason), "regen %s", failure ? failure : "failed");
+        return reason;
+    }
+
+    static const struct {
+        const char* source;
+        const char* binary;
+        const char* output;
+        bool simd;
+    } variants[] = {
+        { "regenerated.c", "regenerated", "regenerated.out", false },
+        { "regenerated.c", "simd", "simd.out", true },
+        { "ir_output.c", "ir", "ir.out", false },
+    };
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        const char* name = variants[v].source;
+        const char* how = variants[v].simd ? " with -fopenmp-simd" : "";
+        if (!compile(config, name, variants[v].binary, variants[v].simd)) {
+            snprintf(reason, sizeof(reason), "%s does not compile%s", name, how);
+            return reason;
+        }
+        failure = execute(config, variants[v].binary, variants[v].output, detail, sizeof(detail));
+        if (failure) {
+            snprintf(reason, sizeof(reason), "%s%s %s", name, how, failure);
+            return reason;
+        }
+        if (!same_file("original.out", variants[v].output)) {
+            snprintf(reason, sizeof(reason), "%s%s prints different output", name, how);
+            return reason;
+        }
+    }
+    return NULL;
+}
+
+
+static void keep_failure(unsigned seed, const Source* program) {
+    char path[64];
+    mkdir("failures", 0755);
+    snprintf(path, sizeof(path), "failures/seed-%u.c", seed);
+    write_text(path, program->text, program->length);
+}
+
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--runs N] [--seed N] [--functions N] [--statements N] [--depth N]\n"
+            "          [--dir DIR] [--regen PATH] [--cc COMPILER] [--timeout SECONDS]\n"
+            "          [--memory MB]\n", program);
+}
+
+
+int main(int argc, char** argv) {
+    Generator shape = { .functions = 4, .statements = 5, .depth = 2 };
+    FuzzConfig config = { getenv("CC") ? getenv("CC") : "cc", NULL, 10, 1024 };
+    const char* regen = "./regen";
+    const char* dir = "fuzz-work";
+    unsigned seed = 1;
+    int runs = 100;
+
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--runs") == 0) runs = atoi(value);
+        else if (strcmp(argv[i], "--seed") == 0) seed = (unsigned)strtoul(value, NULL, 10);
+        else if (strcmp(argv[i], "--functions") == 0) shape.functions = atoi(value);
+        else if (strcmp(argv[i], "--statements") == 0) shape.statements = atoi(value);
+        else if (strcmp(argv[i], "--depth") == 0) shape.depth = atoi(value);
+        else if (strcmp(argv[i], "--dir") == 0) dir = value;
+        else if (strcmp(argv[i], "--regen") == 0) regen = value;
+        else if (strcmp(argv[i], "--cc") == 0) config.compiler = value;
+        else if (strcmp(argv[i], "--timeout") == 0) config.timeout = atoi(value);
+        else if (strcmp(argv[i], "--memory") == 0) config.memory_mb = atol(value);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    if (runs < 1 || shape.functions < 1 || shape.statements < 1 || shape.depth < 0 ||
+        shape.depth > 8 || config.timeout < 1 || config.memory_mb < 16) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // regen is looked up before moving into the work directory
+    char* regen_path = realpath(regen, NULL);
+    if (!regen_path) {
+        perror(regen);
+        return 1;
+    }
+    config.regen = regen_path;
+    mkdir(dir, 0755);
+    if (chdir(dir) != 0) {
+        perror(dir);
+        return 1;
+    }
+    const char* prelude = "int printf(const char* format, ...);\n";
+    if (!write_text("prelude.h", prelude, strlen(prelude))) return 1;
+
+    int failures = 0;
+    int skipped = 0;
+    for (int run = 0; run < runs; run++) {
+        unsigned case_seed = seed + (unsigned)run;
+        Generator g = shape;
+        g.rng = case_seed ? case_seed : 1;
+        Source program = generate_program(&g);
+
+        bool skip;
+        const char* reason = check_case(&config, &program, &skip);
+        if (reason) {
+            printf("seed %u: %s\n", case_seed, reason);
+            keep_failure(case_seed, &program);
+            if (skip) skipped++;
+            else failures++;
+        }
+        free(program.text);
+    }
+
+    printf("%d run(s), %d failure(s), %d skipped; failing inputs in %s/failures\n",
+           runs, failures, skipped, dir);
+    free(regen_path);
+    return failures > 0 || skipped > 0;
+}
@@ -0,0 +1,550 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "incremental.h"
+#include "ast_store.h"
+
+
+#define CACHE_MAGIC   0x43505643u   // "CVPC"
+#define CACHE_VERSION 2             // bump whenever a pass changes its output
+
+#define FNV64_OFFSET 14695981039346656037ull
+#define FNV64_PRIME  1099511628211ull
+
+/* Stored origins name a parse node as an index into the entry's list of
+   functions and the node's preorder index within that function. */
+#define ORIGIN_INDEX_BITS 20
+#define ORIGIN_INDEX_MASK ((1u << ORIGIN_INDEX_BITS) - 1)
+#define ORIGIN_NO_REF     0xfffu
+
+
+typedef struct {
+    uint64_t key;
+    char** refs;            // functions the origins point into, by name
+    uint32_t ref_count;
+    ASTStore* store;        // origins packed, locs relative to the program start
+} CacheEntry;
+
+typedef struct {
+    char* name;
+    uint64_t hash;          // of the function alone
+    uint64_t key;           // of the function and everything it calls
+    int* ids;               // parse nodes in preorder
+    uint32_t* locs;
+    int size;
+    int capacity;
+    const char** calls;
+    int call_count;
+    int call_capacity;
+    int* callees;
+    int callee_count;
+    CacheEntry* entry;      // loaded or fresh, NULL when not cached
+    CacheEntry fresh;
+} CachedFunction;
+
+struct OptCache {
+    CachedFunction* functions;
+    int count;
+    int* by_name;           // function indices sorted by name
+    int* origin_function;   // by parse node id, -1 outside every function
+    int* origin_index;
+    int max_id;
+    uint32_t base_loc;      // where the program starts
+    bool usable;            // false when two functions share a name
+    CacheEntry* loaded;     // sorted by key
+    uint32_t loaded_count;
+};
+
+
+static void* cache_alloc(void* ptr, size_t size) {
+    void* mem = realloc(ptr, size ? size : 1);
+    if (!mem) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return mem;
+}
+
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV64_PRIME;
+    }
+    return hash;
+}
+
+
+static uint64_t hash_byte(uint64_t hash, unsigned char byte) {
+    return hash_bytes(hash, &byte, 1);
+}
+
+
+// Each chain ends in a byte no node kind uses, so the encoding is unambiguous
+static void scan_chain(CachedFunction* function, ASTNode* node) {
+    for (; node; node = node->next) {
+        if (function->size == function->capacity) {
+            function->capacity = function->capacity ? function->capacity * 2 : 64;
+            function->ids = cache_alloc(function->ids, function->capacity * sizeof(int));
+            function->locs = cache_alloc(function->locs, function->capacity * sizeof(uint32_t));
+        }
+        function->ids[function->size] = node->id;
+        function->locs[function->size] = node->loc;
+        function->size++;
+
+        function->hash = hash_byte(function->hash, (unsigned char)node->type);
+        function->hash = hash_byte(function->hash, node->value != NULL);
+        if (node->value) {
+            function->hash = hash_bytes(function->hash, node->value, strlen(node->value) + 1);
+        }
+
+        if (node->type == NODE_FUNC_CALL && node->value) {
+            if (function->call_count == function->call_capacity) {
+                function->call_capacity = function->call_capacity ? function->call_capacity * 2 : 4;
+                function->calls = cache_alloc(function->calls, function->call_capacity * sizeof(char*));
+            }
+            function->calls[function->call_count++] = node->value;
+        }
+
+        for (int i = 0; i < ast_slot_count(node->type); i++) {
+            scan_chain(function, node->child[i]);
+        }
+        function->hash = hash_byte(function->hash, 0xff);
+    }
+}
+
+
+static OptCache* sorting_cache;
+
+static int compare_by_name(const void* a, const void* b) {
+    return strcmp(sorting_cache->functions[*(const int*)a].name,
+                  sorting_cache->functions[*(const int*)b].name);
+}
+
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+
+static int compare_entries(const void* a, const void* b) {
+    return compare_u64(&((const CacheEntry*)a)->key, &((const CacheEntry*)b)->key);
+}
+
+
+static int find_function(OptCache* cache, const char* name) {
+    int lo = 0;
+    int hi = cache->count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(name, cache->functions[cache->by_name[mid]].name);
+        if (cmp == 0) return cache->by_name[mid];
+        if (cmp < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return -1;
+}
+
+
+/* Mixes in the hash of every function reachable from `root`, in name order
+   so the key does not depend on where they sit in the file. */
+static void compute_key(OptCache* cache, int root, int* rank, int* seen, int* stack, uint64_t* reached) {
+    int reached_count = 0;
+    int depth = 0;
+    seen[root] = root;
+    stack[depth++] = root;
+    while (depth > 0) {
+        CachedFunction* function = &cache->functions[stack[--depth]];
+        for (int i = 0; i < function->callee_count; i++) {
+            int callee = function->callees[i];
+            if (seen[callee] == root) continue;
+            seen[callee] = root;
+            stack[depth++] = callee;
+            reached[reached_count++] = (uint64_t)rank[callee] << 32 | (uint32_t)callee;
+        }
+    }
+    qsort(reached, reached_count, sizeof(uint64_t), compare_u64);
+
+    uint64_t key = hash_bytes(FNV64_OFFSET, &cache->functions[root].hash, sizeof(uint64_t));
+    for (int i = 0; i < reached_count; i++) {
+        key = hash_bytes(key, &cache->functions[(uint32_t)reached[i]].hash, sizeof(uint64_t));
+    }
+    cache->functions[root].key = key;
+}
+
+
+static void free_entry(CacheEntry* entry) {
+    for (uint32_t i = 0; i < entry->ref_count; i++) {
+        free(entry->refs[i]);
+    }
+    free(entry->refs);
+    free_ast_store(entry->store);
+    memset(entry, 0, sizeof(CacheEntry));
+}
+
+
+static bool read_u32(FILE* input, uint32_t* value) {
+    return fread(value, sizeof(uint32_t), 1, input) == 1;
+}
+
+
+static bool read_entry(FILE* input, CacheEntry* entry) {
+    memset(entry, 0, sizeof(CacheEntry));
+    uint32_t ref_count;
+    if (fread(&entry->key, sizeof(uint64_t), 1, input) != 1 || !read_u32(input, &ref_count) ||
+        ref_count > ORIGIN_NO_REF) {
+        return false;
+    }
+
+    entry->refs = cache_alloc(NULL, ref_count * sizeof(char*));
+    for (; entry->ref_count < ref_count; entry->ref_count++) {
+        uint32_t length;
+        if (!read_u32(input, &length) || length > 4096) break;
+        char* name = cache_alloc(NULL, length + 1);
+        if (fread(name, 1, length, input) != length) {
+            free(name);
+            break;
+        }
+        name[length] = '\0';
+        entry->refs[entry->ref_count] = name;
+    }
+    if (entry->ref_count == ref_count) entry->store = ast_store_read(input);
+    if (!entry->store || entry->store->count == 0) {
+        free_entry(entry);
+        return false;
+    }
+    return true;
+}
+
+
+// Returns the rest of the file in a malloc'ed buffer
+static char* read_rest(FILE* input, size_t* length) {
+    size_t capacity = 4096;
+    char* data = cache_alloc(NULL, capacity);
+    *length = 0;
+    size_t n;
+    while ((n = fread(data + *length, 1, capacity - *length, input)) > 0) {
+        *length += n;
+        if (*length == capacity) {
+            capacity *= 2;
+            data = cache_alloc(data, capacity);
+        }
+    }
+    return data;
+}
+
+
+/* A missing, stale or damaged file just leaves the cache empty. The header
+   holds a checksum of everything after it, since a flipped constant would
+   otherwise load as a perfectly valid tree. */
+static void load_entries(OptCache* cache, const char* path) {
+    FILE* input = path ? fopen(path, "rb") : NULL;
+    if (!input) return;
+
+    uint32_t header[3];
+    uint64_t checksum;
+    bool current = fread(header, sizeof(header), 1, input) == 1 &&
+                   fread(&checksum, sizeof(checksum), 1, input) == 1 &&
+                   header[0] == CACHE_MAGIC && header[1] == CACHE_VERSION;
+    size_t length = 0;
+    char* payload = current ? read_rest(input, &length) : NULL;
+    fclose(input);
+    if (!payload || length == 0 || hash_bytes(FNV64_OFFSET, payload, length) != checksum) {
+        free(payload);
+        return;
+    }
+
+    FILE* entries = fmemopen(payload, length, "rb");
+    uint32_t capacity = 0;
+    for (uint32_t i = 0; entries && i < header[2]; i++) {
+        if (cache->loaded_count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            cache->loaded = cache_alloc(cache->loaded, capacity * sizeof(CacheEntry));
+        }
+        if (!read_entry(entries, &cache->loaded[cache->loaded_count])) break;
+        cache->loaded_count++;
+    }
+    if (entries) fclose(entries);
+    free(payload);
+    if (cache->loaded_count > 0) qsort(cache->loaded, cache->loaded_count, sizeof(CacheEntry), compare_entries);
+}
+
+
+OptCache* open_opt_cache(const char* path, ASTNode*** slots, int count) {
+    OptCache* cache = cache_alloc(NULL, sizeof(OptCache));
+    memset(cache, 0, sizeof(OptCache));
+    cache->count = count;
+    cache->functions = cache_alloc(NULL, count * sizeof(CachedFunction));
+    memset(cache->functions, 0, count * sizeof(CachedFunction));
+    cache->by_name = cache_alloc(NULL, count * sizeof(int));
+
+    for (int i = 0; i < count; i++) {
+        CachedFunction* function = &cache->functions[i];
+        function->name = strdup((*slots[i])->value ? (*slots[i])->value : "");
+        if (!function->name) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        function->hash = FNV64_OFFSET;
+        scan_chain(function, *slots[i]);
+        for (int k = 0; k < function->size; k++) {
+            if (function->ids[k] > cache->max_id) cache->max_id = function->ids[k];
+        }
+        cache->by_name[i] = i;
+    }
+    if (count > 0) cache->base_loc = cache->functions[0].locs[0];
+
+    sorting_cache = cache;
+    qsort(cache->by_name, count, sizeof(int), compare_by_name);
+    cache->usable = true;
+    for (int i = 1; i < count; i++) {
+        if (strcmp(cache->functions[cache->by_name[i - 1]].name,
+                   cache->functions[cache->by_name[i]].name) == 0) {
+            cache->usable = false;
+        }
+    }
+
+    cache->origin_function = cache_alloc(NULL, (cache->max_id + 1) * sizeof(int));
+    cache->origin_index = cache_alloc(NULL, (cache->max_id + 1) * sizeof(int));
+    for (int id = 0; id <= cache->max_id; id++) {
+        cache->origin_function[id] = -1;
+    }
+    for (int i = 0; i < count; i++) {
+        CachedFunction* function = &cache->functions[i];
+        for (int k = 0; k < function->size; k++) {
+            cache->origin_function[function->ids[k]] = i;
+            cache->origin_index[function->ids[k]] = k;
+        }
+    }
+    if (!cache->usable) return cache;
+
+    int* rank = cache_alloc(NULL, count * sizeof(int));
+    int* seen = cache_alloc(NULL, count * sizeof(int));
+    int* stack = cache_alloc(NULL, count * sizeof(int));
+    uint64_t* reached = cache_alloc(NULL, count * sizeof(uint64_t));
+    for (int i = 0; i < count; i++) {
+        rank[cache->by_name[i]] = i;
+        seen[i] = -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        CachedFunction* function = &cache->functions[i];
+        function->callees = cache_alloc(NULL, function->call_count * sizeof(int));
+        for (int k = 0; k < function->call_count; k++) {
+            int callee = find_function(cache, function->calls[k]);
+            if (callee >= 0) function->callees[function->callee_count++] = callee;
+        }
+        free(function->calls);
+        function->calls = NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        compute_key(cache, i, rank, seen, stack, reached);
+    }
+    free(rank);
+    free(seen);
+    free(stack);
+    free(reached);
+
+    load_entries(cache, path);
+    for (int i = 0; cache->loaded_count > 0 && i < count; i++) {
+        CacheEntry probe = { cache->functions[i].key, NULL, 0, NULL };
+        cache->functions[i].entry = bsearch(&probe, cache->loaded, cache->loaded_count,
+                                            sizeof(CacheEntry), compare_entries);
+    }
+    return cache;
+}
+
+
+bool opt_cache_hit(const OptCache* cache, int function) {
+    return cache->usable && cache->functions[function].entry != NULL;
+}
+
+
+static void claim_new_origins(ASTNode* node) {
+    for (; node; node = node->next) {
+        if (node->origin == 0) node->origin = node->id;
+        for (int i = 0; i < ast_slot_count(node->type); i++) {
+            claim_new_origins(node->child[i]);
+        }
+    }
+}
+
+
+/* Nodes whose origin was a parse node take that node's id and location in
+   this parse; anything else was created by a pass and is its own origin. */
+ASTNode* opt_cache_restore(OptCache* cache, int function) {
+    CacheEntry* entry = cache->functions[function].entry;
+    ASTStore* store = entry->store;
+
+    int* ref_functions = cache_alloc(NULL, entry->ref_count * sizeof(int));
+    for (uint32_t r = 0; r < entry->ref_count; r++) {
+        ref_functions[r] = find_function(cache, entry->refs[r]);
+    }
+
+    uint32_t* packed_origins = store->origins;
+    uint32_t* packed_locs = store->locs;
+    store->origins = cache_alloc(NULL, store->count * sizeof(uint32_t));
+    store->locs = cache_alloc(NULL, store->count * sizeof(uint32_t));
+    for (uint32_t k = 0; k < store->count; k++) {
+        uint32_t ref = packed_origins[k] >> ORIGIN_INDEX_BITS;
+        uint32_t index = packed_origins[k] & ORIGIN_INDEX_MASK;
+        CachedFunction* from = ref < entry->ref_count && ref_functions[ref] >= 0
+                             ? &cache->functions[ref_functions[ref]] : NULL;
+        if (from && index < (uint32_t)from->size) {
+            store->origins[k] = (uint32_t)from->ids[index];
+            store->locs[k] = from->locs[index];
+        } else {
+            store->origins[k] = 0;
+            store->locs[k] = cache->base_loc + packed_locs[k];
+        }
+    }
+
+    ASTNode* tree = ast_store_to_tree(store, 0);
+    claim_new_origins(tree);
+
+    free(store->origins);
+    free(store->locs);
+    store->origins = packed_origins;
+    store->locs = packed_locs;
+    free(ref_functions);
+    return tree;
+}
+
+
+static uint32_t find_ref(CacheEntry* entry, const char* name) {
+    for (uint32_t r = 0; r < entry->ref_count; r++) {
+        if (strcmp(entry->refs[r], name) == 0) return r;
+    }
+    if (entry->ref_count == ORIGIN_NO_REF) return ORIGIN_NO_REF;
+    entry->refs = cache_alloc(entry->refs, (entry->ref_count + 1) * sizeof(char*));
+    entry->refs[entry->ref_count] = strdup(name);
+    if (!entry->refs[entry->ref_count]) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return entry->ref_count++;
+}
+
+
+// Functions too large to pack their origins are simply not cached
+void opt_cache_update(OptCache* cache, int function, ASTNode* optimized) {
+    if (!cache->usable || !optimized) return;
+
+    CachedFunction* owner = &cache->functions[function];
+    CacheEntry* entry = &owner->fresh;
+    free_entry(entry);
+    entry->key = owner->key;
+    entry->store = ast_store_from_tree(optimized);
+    owner->entry = NULL;
+
+    ASTStore* store = entry->store;
+    for (uint32_t k = 0; k < store->count; k++) {
+        int origin = (int)store->origins[k];
+        int from = origin > 0 && origin <= cache->max_id ? cache->origin_function[origin] : -1;
+        if (from < 0) {
+            store->origins[k] = ORIGIN_NO_REF << ORIGIN_INDEX_BITS;
+            store->locs[k] -= cache->base_loc;
+            continue;
+        }
+
+        uint32_t ref = find_ref(entry, cache->functions[from].name);
+        uint32_t index = (uint32_t)cache->origin_index[origin];
+        if (ref == ORIGIN_NO_REF || index > ORIGIN_INDEX_MASK) {
+            free_entry(entry);
+            return;
+        }
+        store->origins[k] = ref << ORIGIN_INDEX_BITS | index;
+        store->locs[k] = 0;
+    }
+    owner->entry = entry;
+}
+
+
+static bool write_entry(FILE* output, const CacheEntry* entry) {
+    if (fwrite(&entry->key, sizeof(uint64_t), 1, output) != 1 ||
+        fwrite(&entry->ref_count, sizeof(uint32_t), 1, output) != 1) {
+        return false;
+    }
+    for (uint32_t r = 0; r < entry->ref_count; r++) {
+        uint32_t length = (uint32_t)strlen(entry->refs[r]);
+        if (fwrite(&length, sizeof(uint32_t), 1, output) != 1 ||
+            fwrite(entry->refs[r], 1, length, output) != length) {
+            return false;
+        }
+    }
+    return ast_store_write(entry->store, output);
+}
+
+
+// Keeps one entry per current function; older versions are dropped
+bool save_opt_cache(OptCache* cache, const char* path) {
+    if (!cache->usable) return false;
+
+    uint32_t entries = 0;
+    bool changed = false;
+    for (int i = 0; i < cache->count; i++) {
+        CachedFunction* function = &cache->functions[i];
+        if (function->entry) entries++;
+        if (function->entry == &function->fresh) changed = true;
+    }
+    if (!changed && entries == cache->loaded_count) return true;
+
+    // Entries go through memory first so the header can carry their checksum
+    char* payload = NULL;
+    size_t length = 0;
+    FILE* buffer = open_memstream(&payload, &length);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->functions[i].entry) write_entry(buffer, cache->functions[i].entry);
+    }
+    fclose(buffer);
+
+    FILE* output = fopen(path, "wb");
+    if (!output) {
+        perror(path);
+        free(payload);
+        return false;
+    }
+
+    uint32_t header[3] = { CACHE_MAGIC, CACHE_VERSION, entries };
+    uint64_t checksum = hash_bytes(FNV64_OFFSET, payload, length);
+    bool ok = fwrite(header, sizeof(header), 1, output) == 1 &&
+              fwrite(&checksum, sizeof(checksum), 1, output) == 1 &&
+              fwrite(payload, 1, length, output) == length;
+    free(payload);
+    if (fclose(output) != 0) ok = false;
+    if (!ok) {
+        fprintf(stderr, "%s: could not write the optimization cache\n", path);
+        remove(path);
+    }
+    return ok;
+}
+
+
+void free_opt_cache(OptCache* cache) {
+    if (!cache) return;
+    for (int i = 0; i < cache->count; i++) {
+        CachedFunction* function = &cache->functions[i];
+        free(function->name);
+        free(function->ids);
+        free(function->locs);
+        free(function->calls);
+        free(function->callees);
+        free_entry(&function->fresh);
+    }
+    for (uint32_t i = 0; i < cache->loaded_count; i++) {
+        free_entry(&cache->loaded[i]);
+    }
+    free(cache->functions);
+    free(cache->by_name);
+    free(cache->origin_function);
+    free(cache->origin_index);
+    free(cache->loaded);
+    free(cache);
+}
@@ -0,0 +1,31 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+
+/* Optimized functions kept across runs. A function is keyed by a hash of
+   its parsed tree and of every function it calls directly or not, since
+   inlining pulls those in. A function whose key is in the cache gets its
+   optimized tree back without running any pass, with origins and source
+   locations pointing into the current parse.
+
+   The cache must be opened on the freshly parsed functions, before
+   anything rewrites them. */
+typedef struct OptCache OptCache;
+
+
+OptCache* open_opt_cache(const char* path, ASTNode*** slots, int count);
+
+bool opt_cache_hit(const OptCache* cache, int function);
+
+ASTNode* opt_cache_restore(OptCache* cache, int function);
+
+void opt_cache_update(OptCache* cache, int function, ASTNode* optimized);
+
+bool save_opt_cache(OptCache* cache, const char* path);
+
+void free_opt_cache(OptCache* cache);
+
+#endif
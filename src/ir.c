@@ -0,0 +1,1394 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <malloc.h>
+#include "ir.h"
+#include "cfg.h"
+#include "memtrack.h"
+
+
+#define MAX_IR_ROUNDS 8
+
+static const char* binop_symbols[] = { "+", "-", "*", "/", "<", "<=", ">", ">=", "==", "!=" };
+
+#define BINOP_COUNT (int)(sizeof(binop_symbols) / sizeof(binop_symbols[0]))
+
+
+// IR memory is charged to MEM_CODEGEN by its usable size
+static void* ir_alloc(void* ptr, size_t size) {
+    long old_size = ptr ? (long)malloc_usable_size(ptr) : 0;
+    void* mem = realloc(ptr, size ? size : 1);
+    if (!mem) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    mem_charge(MEM_CODEGEN, 0, (long)malloc_usable_size(mem) - old_size);
+    return mem;
+}
+
+
+static void ir_free(void* ptr) {
+    if (!ptr) return;
+    mem_charge(MEM_CODEGEN, 0, -(long)malloc_usable_size(ptr));
+    free(ptr);
+}
+
+
+static char* ir_strdup(const char* text) {
+    size_t size = strlen(text) + 1;
+    char* copy = ir_alloc(NULL, size);
+    memcpy(copy, text, size);
+    return copy;
+}
+
+
+// Only the successor table is ours; flow_analyze() allocated the rest
+static void ir_flow_free(FlowGraph* g) {
+    ir_free(g->succ);
+    g->succ = NULL;
+    flow_free(g);
+}
+
+
+static void* ir_grow(void* ptr, int* capacity, int needed, size_t size) {
+    if (needed <= *capacity) return ptr;
+
+    int grown = *capacity ? *capacity : 16;
+    while (grown < needed) grown *= 2;
+    *capacity = grown;
+    return ir_alloc(ptr, grown * size);
+}
+
+
+static int* filled_ints(int count, int value) {
+    int* ints = ir_alloc(NULL, count * sizeof(int));
+    for (int i = 0; i < count; i++) ints[i] = value;
+    return ints;
+}
+
+
+static int add_instr(IRFunction* fn, IROp op) {
+    fn->instrs = ir_grow(fn->instrs, &fn->instr_capacity, fn->instr_count + 1, sizeof(IRInstr));
+    IRInstr* ins = &fn->instrs[fn->instr_count];
+    memset(ins, 0, sizeof(IRInstr));
+    ins->op = op;
+    ins->a = -1;
+    ins->b = -1;
+    fn->blocks[fn->block_count - 1].count++;
+    return fn->instr_count++;
+}
+
+
+static int add_operands(IRFunction* fn, int count) {
+    fn->operands = ir_grow(fn->operands, &fn->operand_capacity, fn->operand_count + count, sizeof(int32_t));
+    int first = fn->operand_count;
+    fn->operand_count += count;
+    return first;
+}
+
+
+static int add_block(IRFunction* fn) {
+    fn->blocks = ir_grow(fn->blocks, &fn->block_capacity, fn->block_count + 1, sizeof(IRBlock));
+    IRBlock* block = &fn->blocks[fn->block_count];
+    block->first = fn->instr_count;
+    block->count = 0;
+    block->succ[0] = -1;
+    block->succ[1] = -1;
+    return fn->block_count++;
+}
+
+
+static void kill_instr(IRInstr* ins) {
+    ir_free(ins->str);
+    memset(ins, 0, sizeof(IRInstr));
+    ins->op = IR_NOP;
+    ins->a = -1;
+    ins->b = -1;
+}
+
+
+typedef void (*UseVisitor)(int32_t* value, void* data);
+
+// Calls `visit` on every value the instruction reads
+static void visit_uses(IRFunction* fn, IRInstr* ins, UseVisitor visit, void* data) {
+    switch (ins->op) {
+        case IR_BINOP:
+            visit(&ins->a, data);
+            visit(&ins->b, data);
+            break;
+        case IR_COPY:
+        case IR_STORE:
+        case IR_BRANCH:
+            visit(&ins->a, data);
+            break;
+        case IR_RET:
+            if (ins->a >= 0) visit(&ins->a, data);
+            break;
+        case IR_CALL:
+            for (int i = 0; i < ins->nargs; i++) visit(&fn->operands[ins->args + i], data);
+            break;
+        case IR_PHI:
+            for (int i = 1; i < ins->nargs; i += 2) visit(&fn->operands[ins->args + i], data);
+            break;
+        default:
+            break;
+    }
+}
+
+
+/* Lowering. Source variables become numbered slots accessed through
+   IR_LOAD/IR_STORE, and SSA construction replaces those with values. The
+   scope stack maps names to slots so shadowing resolves the way C does. */
+typedef struct {
+    IRFunction* fn;
+    const char** names;
+    int* slots;
+    int count;
+    int capacity;
+} Lowering;
+
+
+static int declare_var(Lowering* lw, const char* name) {
+    if (lw->count == lw->capacity) {
+        lw->capacity = lw->capacity ? lw->capacity * 2 : 16;
+        lw->names = ir_alloc(lw->names, lw->capacity * sizeof(char*));
+        lw->slots = ir_alloc(lw->slots, lw->capacity * sizeof(int));
+    }
+    lw->names[lw->count] = name;
+    lw->slots[lw->count] = lw->fn->slot_count++;
+    return lw->slots[lw->count++];
+}
+
+
+static int lookup_var(Lowering* lw, const char* name) {
+    for (int i = lw->count - 1; i >= 0; i--) {
+        if (strcmp(lw->names[i], name) == 0) return lw->slots[i];
+    }
+    return -1;
+}
+
+
+static int find_binop(const char* op) {
+    for (int i = 0; i < BINOP_COUNT; i++) {
+        if (strcmp(binop_symbols[i], op) == 0) return i;
+    }
+    return -1;
+}
+
+
+static int emit_const(IRFunction* fn, int value) {
+    int v = add_instr(fn, IR_CONST);
+    fn->instrs[v].imm = value;
+    return v;
+}
+
+
+static int emit_load(IRFunction* fn, int slot) {
+    int v = add_instr(fn, IR_LOAD);
+    fn->instrs[v].imm = slot;
+    return v;
+}
+
+
+static void emit_store(IRFunction* fn, int slot, int value) {
+    int v = add_instr(fn, IR_STORE);
+    fn->instrs[v].imm = slot;
+    fn->instrs[v].a = value;
+}
+
+
+static int emit_binop(IRFunction* fn, int binop, int left, int right) {
+    int v = add_instr(fn, IR_BINOP);
+    fn->instrs[v].binop = (uint8_t)binop;
+    fn->instrs[v].a = left;
+    fn->instrs[v].b = right;
+    return v;
+}
+
+
+static void jump_to(IRFunction* fn, int target) {
+    int from = fn->block_count - 1;
+    add_instr(fn, IR_JUMP);
+    fn->blocks[from].succ[0] = target;
+}
+
+
+// Ends the current block with a jump into a fresh one
+static void jump_to_next(IRFunction* fn) {
+    jump_to(fn, fn->block_count);
+    add_block(fn);
+}
+
+
+/* Ends the current block with a branch whose true edge enters a fresh
+   block. Returns the branching block so the false edge can be patched once
+   its target exists. */
+static int branch_on(IRFunction* fn, int cond) {
+    int from = fn->block_count - 1;
+    int v = add_instr(fn, IR_BRANCH);
+    fn->instrs[v].a = cond;
+    fn->blocks[from].succ[0] = fn->block_count;
+    add_block(fn);
+    return from;
+}
+
+
+static int lower_expr(Lowering* lw, ASTNode* node);
+
+
+static int lower_call(Lowering* lw, ASTNode* node) {
+    IRFunction* fn = lw->fn;
+    int count = 0;
+    for (ASTNode* arg = node->left; arg; arg = arg->next) count++;
+
+    int* values = ir_alloc(NULL, count * sizeof(int));
+    int i = 0;
+    for (ASTNode* arg = node->left; arg; arg = arg->next) {
+        values[i++] = lower_expr(lw, arg->type == NODE_EXPR_LIST ? arg->left : arg);
+    }
+
+    int call = add_instr(fn, IR_CALL);
+    int args = add_operands(fn, count);
+    memcpy(fn->operands + args, values, count * sizeof(int32_t));
+    fn->instrs[call].str = ir_strdup(node->value);
+    fn->instrs[call].args = args;
+    fn->instrs[call].nargs = count;
+    ir_free(values);
+    return call;
+}
+
+
+// Every function starts with an IR_UNDEF at index 0 for reads of unknown names
+static int lower_expr(Lowering* lw, ASTNode* node) {
+    IRFunction* fn = lw->fn;
+    if (!node) return 0;
+
+    switch (node->type) {
+        case NODE_INT:
+            return emit_const(fn, atoi(node->value));
+
+        case NODE_STRING: {
+            int v = add_instr(fn, IR_STR);
+            fn->instrs[v].str = ir_strdup(node->value);
+            return v;
+        }
+
+        case NODE_VAR: {
+            int slot = lookup_var(lw, node->value);
+            return slot < 0 ? 0 : emit_load(fn, slot);
+        }
+
+        case NODE_ASSIGN: {
+            int value = lower_expr(lw, node->left);
+            int slot = lookup_var(lw, node->value);
+            if (slot >= 0) emit_store(fn, slot, value);
+            return value;
+        }
+
+        case NODE_UNARY: {
+            if (!node->left || node->left->type != NODE_VAR) return lower_expr(lw, node->left);
+            int slot = lookup_var(lw, node->left->value);
+            if (slot < 0) return 0;
+
+            // Postfix: the expression yields the old value
+            int old = emit_load(fn, slot);
+            int one = emit_const(fn, 1);
+            int binop = strcmp(node->value, "--") == 0 ? IR_SUB : IR_ADD;
+            emit_store(fn, slot, emit_binop(fn, binop, old, one));
+            return old;
+        }
+
+        case NODE_BINOP: {
+            int binop = find_binop(node->value);
+            int left = lower_expr(lw, node->left);
+            int right = lower_expr(lw, node->right);
+            return binop < 0 ? 0 : emit_binop(fn, binop, left, right);
+        }
+
+        case NODE_FUNC_CALL:
+            return lower_call(lw, node);
+
+        default:
+            return 0;
+    }
+}
+
+
+static void lower_stmts(Lowering* lw, ASTNode* node);
+
+
+static void lower_for(Lowering* lw, ASTNode* node) {
+    IRFunction* fn = lw->fn;
+    ASTNode* init = node->child[FOR_INIT];
+    ASTNode* cond = node->child[FOR_COND];
+    ASTNode* update = node->child[FOR_UPDATE];
+    ASTNode* body = node->child[FOR_BODY];
+    int mark = lw->count;
+
+    if (init && init->type == NODE_DECL) {
+        int value = init->left ? lower_expr(lw, init->left) : -1;
+        int slot = declare_var(lw, init->value);
+        if (value >= 0) emit_store(fn, slot, value);
+    } else if (init) {
+        lower_expr(lw, init);
+    }
+
+    jump_to_next(fn);
+    int header = fn->block_count - 1;
+    int from = branch_on(fn, cond ? lower_expr(lw, cond) : emit_const(fn, 1));
+
+    int body_mark = lw->count;
+    lower_stmts(lw, body);
+    lw->count = body_mark;
+
+    jump_to_next(fn);
+    if (update) lower_expr(lw, update);
+    jump_to(fn, header);
+    int exit = add_block(fn);
+    fn->blocks[from].succ[1] = exit;
+    lw->count = mark;
+}
+
+
+static void lower_stmt(Lowering* lw, ASTNode* node) {
+    IRFunction* fn = lw->fn;
+
+    switch (node->type) {
+        case NODE_SEQ:
+            lower_stmts(lw, node->left);
+            lower_stmts(lw, node->right);
+            break;
+
+        case NODE_DECL: {
+            int value = node->left ? lower_expr(lw, node->left) : -1;
+            int slot = declare_var(lw, node->value);
+            if (value >= 0) emit_store(fn, slot, value);
+            break;
+        }
+
+        case NODE_IF: {
+            int from = branch_on(fn, lower_expr(lw, node->left));
+            int mark = lw->count;
+            lower_stmts(lw, node->right);
+            lw->count = mark;
+            jump_to_next(fn);
+            fn->blocks[from].succ[1] = fn->block_count - 1;
+            break;
+        }
+
+        case NODE_FOR:
+            lower_for(lw, node);
+            break;
+
+        case NODE_RETURN: {
+            int value = node->left ? lower_expr(lw, node->left) : -1;
+            int ret = add_instr(fn, IR_RET);
+            fn->instrs[ret].a = value;
+            // Whatever follows is unreachable and goes into a block of its own
+            add_block(fn);
+            break;
+        }
+
+        default:
+            lower_expr(lw, node);
+            break;
+    }
+}
+
+
+static void lower_stmts(Lowering* lw, ASTNode* node) {
+    for (; node; node = node->next) {
+        lower_stmt(lw, node);
+    }
+}
+
+
+static void lower_function(IRFunction* fn, ASTNode* def) {
+    memset(fn, 0, sizeof(IRFunction));
+    fn->name = ir_strdup(def->value);
+    Lowering lw = { fn, NULL, NULL, 0, 0 };
+
+    add_block(fn);
+    add_instr(fn, IR_UNDEF);
+    for (ASTNode* param = def->right; param; param = param->next) {
+        int value = add_instr(fn, IR_PARAM);
+        fn->instrs[value].imm = fn->param_count++;
+        emit_store(fn, declare_var(&lw, param->value), value);
+    }
+
+    lower_stmts(&lw, def->left);
+    add_instr(fn, IR_RET);
+
+    ir_free(lw.names);
+    ir_free(lw.slots);
+}
+
+
+// Both edges of a branch may lead to the same block; that counts once
+static int successor(IRFunction* fn, int b, int k) {
+    IRBlock* block = &fn->blocks[b];
+    if (k == 1 && block->succ[1] == block->succ[0]) return -1;
+    return block->succ[k];
+}
+
+
+// Predecessors, reverse postorder and dominators of the blocks
+static void build_graph(IRFunction* fn, FlowGraph* g) {
+    memset(g, 0, sizeof(FlowGraph));
+    g->count = fn->block_count;
+    g->succ = ir_alloc(NULL, fn->block_count * sizeof(int[2]));
+    for (int b = 0; b < fn->block_count; b++) {
+        g->succ[b][0] = fn->blocks[b].succ[0];
+        g->succ[b][1] = fn->blocks[b].succ[1];
+    }
+    flow_analyze(g);
+}
+
+
+static void remap_use(int32_t* value, void* data) {
+    *value = ((int*)data)[*value];
+}
+
+
+static void resolve_copy(int32_t* value, void* data) {
+    IRFunction* fn = data;
+    int v = *value;
+    while (fn->instrs[v].op == IR_COPY) v = fn->instrs[v].a;
+    *value = v;
+}
+
+
+/* Drops deleted instructions, copies and unreachable blocks, renumbering
+   everything that is left. Uses of a copy are redirected to its source
+   first, and phis forget the predecessors that disappeared. */
+static void compact(IRFunction* fn) {
+    FlowGraph g;
+    build_graph(fn, &g);
+    int n = fn->block_count;
+
+    for (int b = 0; b < n; b++) {
+        if (g.order[b] < 0) continue;
+        IRBlock* block = &fn->blocks[b];
+        for (int i = block->first; i < block->first + block->count; i++) {
+            IRInstr* ins = &fn->instrs[i];
+            if (ins->op == IR_PHI) {
+                int kept = 0;
+                for (int k = 0; k < ins->nargs; k += 2) {
+                    int32_t* pair = &fn->operands[ins->args + k];
+                    if (g.order[pair[0]] < 0) continue;
+                    fn->operands[ins->args + kept] = pair[0];
+                    fn->operands[ins->args + kept + 1] = pair[1];
+                    kept += 2;
+                }
+                ins->nargs = kept;
+            }
+            visit_uses(fn, ins, resolve_copy, fn);
+        }
+    }
+
+    int* block_map = filled_ints(n, -1);
+    int* map = filled_ints(fn->instr_count, -1);
+    IRInstr* instrs = ir_alloc(NULL, fn->instr_count * sizeof(IRInstr));
+    int32_t* operands = ir_alloc(NULL, fn->operand_count * sizeof(int32_t));
+    IRBlock* blocks = ir_alloc(NULL, n * sizeof(IRBlock));
+    int count = 0;
+    int operand_count = 0;
+    int block_count = 0;
+
+    for (int b = 0; b < n; b++) {
+        IRBlock* block = &fn->blocks[b];
+        bool reachable = g.order[b] >= 0;
+        if (reachable) {
+            block_map[b] = block_count;
+            blocks[block_count] = *block;
+            blocks[block_count++].first = count;
+        }
+
+        for (int i = block->first; i < block->first + block->count; i++) {
+            IRInstr* ins = &fn->instrs[i];
+            if (!reachable || ins->op == IR_NOP || ins->op == IR_COPY) {
+                ir_free(ins->str);
+                continue;
+            }
+            instrs[count] = *ins;
+            if (ins->op == IR_CALL || ins->op == IR_PHI) {
+                memcpy(operands + operand_count, fn->operands + ins->args, ins->nargs * sizeof(int32_t));
+                instrs[count].args = operand_count;
+                operand_count += ins->nargs;
+            }
+            map[i] = count++;
+        }
+        if (reachable) blocks[block_count - 1].count = count - blocks[block_count - 1].first;
+    }
+
+    ir_free(fn->instrs);
+    ir_free(fn->operands);
+    ir_free(fn->blocks);
+    fn->instrs = instrs;
+    fn->instr_count = count;
+    fn->instr_capacity = fn->instr_count;
+    fn->operands = operands;
+    fn->operand_count = operand_count;
+    fn->operand_capacity = operand_count;
+    fn->blocks = blocks;
+    fn->block_count = block_count;
+    fn->block_capacity = block_count;
+
+    for (int i = 0; i < count; i++) {
+        IRInstr* ins = &fn->instrs[i];
+        visit_uses(fn, ins, remap_use, map);
+        if (ins->op == IR_PHI) {
+            for (int k = 0; k < ins->nargs; k += 2) {
+                fn->operands[ins->args + k] = block_map[fn->operands[ins->args + k]];
+            }
+        }
+    }
+    for (int b = 0; b < block_count; b++) {
+        for (int k = 0; k < 2; k++) {
+            if (blocks[b].succ[k] >= 0) blocks[b].succ[k] = block_map[blocks[b].succ[k]];
+        }
+    }
+
+    ir_free(map);
+    ir_free(block_map);
+    ir_flow_free(&g);
+}
+
+
+/* SSA construction. Phis go on the iterated dominance frontier of each
+   variable's stores, but only for variables read before being written in
+   some block; everything else never lives across a block boundary. Then a
+   walk of the dominator tree turns loads into copies of the reaching value
+   and deletes the stores. */
+typedef struct {
+    IRFunction* fn;
+    FlowGraph* g;
+    int* current;       // reaching value per slot
+    int* log_slot;      // undo log of `current`, unwound leaving a block
+    int* log_value;
+    int log_count;
+} Renamer;
+
+
+static void define_var(Renamer* r, int slot, int value) {
+    r->log_slot[r->log_count] = slot;
+    r->log_value[r->log_count++] = r->current[slot];
+    r->current[slot] = value;
+}
+
+
+static void rename_block(Renamer* r, int b) {
+    IRFunction* fn = r->fn;
+    IRBlock* block = &fn->blocks[b];
+    int mark = r->log_count;
+
+    for (int i = block->first; i < block->first + block->count; i++) {
+        IRInstr* ins = &fn->instrs[i];
+        if (ins->op == IR_PHI) {
+            define_var(r, ins->imm, i);
+        } else if (ins->op == IR_LOAD) {
+            ins->op = IR_COPY;
+            ins->a = r->current[ins->imm];
+        } else if (ins->op == IR_STORE) {
+            define_var(r, ins->imm, ins->a);
+            kill_instr(ins);
+        }
+    }
+
+    for (int k = 0; k < 2; k++) {
+        int s = successor(fn, b, k);
+        if (s < 0) continue;
+        IRBlock* target = &fn->blocks[s];
+        for (int i = target->first; i < target->first + target->count && fn->instrs[i].op == IR_PHI; i++) {
+            IRInstr* phi = &fn->instrs[i];
+            fn->operands[phi->args + phi->nargs++] = b;
+            fn->operands[phi->args + phi->nargs++] = r->current[phi->imm];
+        }
+    }
+
+    for (int c = r->g->child_start[b]; c < r->g->child_start[b + 1]; c++) {
+        rename_block(r, r->g->children[c]);
+    }
+
+    while (r->log_count > mark) {
+        r->log_count--;
+        r->current[r->log_slot[r->log_count]] = r->log_value[r->log_count];
+    }
+}
+
+
+static void build_ssa(IRFunction* fn) {
+    FlowGraph g;
+    build_graph(fn, &g);
+    int n = fn->block_count;
+    int slots = fn->slot_count;
+
+    // Blocks storing to each slot, grouped by slot
+    bool* global = ir_alloc(NULL, slots * sizeof(bool));
+    memset(global, 0, slots * sizeof(bool));
+    int* written = filled_ints(slots, -1);
+    int* def_start = filled_ints(slots + 1, 0);
+    for (int b = 0; b < n; b++) {
+        if (g.order[b] < 0) continue;
+        IRBlock* block = &fn->blocks[b];
+        for (int i = block->first; i < block->first + block->count; i++) {
+            IRInstr* ins = &fn->instrs[i];
+            if (ins->op == IR_LOAD && written[ins->imm] != b) global[ins->imm] = true;
+            if (ins->op == IR_STORE && written[ins->imm] != b) {
+                written[ins->imm] = b;
+                def_start[ins->imm + 1]++;
+            }
+        }
+    }
+    for (int v = 0; v < slots; v++) def_start[v + 1] += def_start[v];
+    int* def_blocks = ir_alloc(NULL, def_start[slots] * sizeof(int));
+    int* cursor = ir_alloc(NULL, (slots > n ? slots : n) * sizeof(int));
+    memcpy(cursor, def_start, slots * sizeof(int));
+    for (int v = 0; v < slots; v++) written[v] = -1;
+    for (int b = 0; b < n; b++) {
+        if (g.order[b] < 0) continue;
+        IRBlock* block = &fn->blocks[b];
+        for (int i = block->first; i < block->first + block->count; i++) {
+            IRInstr* ins = &fn->instrs[i];
+            if (ins->op == IR_STORE && written[ins->imm] != b) {
+                written[ins->imm] = b;
+                def_blocks[cursor[ins->imm]++] = b;
+            }
+        }
+    }
+
+    // Dominance frontiers, collected as (block, frontier block) pairs
+    int* pairs = NULL;
+    int pair_count = 0;
+    int pair_capacity = 0;
+    for (int i = 0; i < g.rpo_count; i++) {
+        int b = g.rpo[i];
+        if (g.pred_start[b + 1] - g.pred_start[b] < 2) continue;
+        for (int p = g.pred_start[b]; p < g.pred_start[b + 1]; p++) {
+            for (int runner = g.preds[p]; runner != g.idom[b]; runner = g.idom[runner]) {
+                pairs = ir_grow(pairs, &pair_capacity, pair_count + 2, sizeof(int));
+                pairs[pair_count++] = runner;
+                pairs[pair_count++] = b;
+            }
+        }
+    }
+    int* frontier_start = filled_ints(n + 1, 0);
+    for (int i = 0; i < pair_count; i += 2) frontier_start[pairs[i] + 1]++;
+    for (int b = 0; b < n; b++) frontier_start[b + 1] += frontier_start[b];
+    int* frontier = ir_alloc(NULL, (pair_count / 2) * sizeof(int));
+    memcpy(cursor, frontier_start, n * sizeof(int));
+    for (int i = 0; i < pair_count; i += 2) frontier[cursor[pairs[i]]++] = pairs[i + 1];
+
+    // Phi placement on the iterated frontier
+    int* placements = NULL;     // (block, slot) pairs
+    int phi_count = 0;
+    int phi_capacity = 0;
+    int* placed = filled_ints(n, -1);
+    int* queued = filled_ints(n, -1);
+    int* work = ir_alloc(NULL, n * sizeof(int));
+    for (int v = 0; v < slots; v++) {
+        if (!global[v]) continue;
+
+        int top = 0;
+        for (int d = def_start[v]; d < def_start[v + 1]; d++) {
+            queued[def_blocks[d]] = v;
+            work[top++] = def_blocks[d];
+        }
+        while (top > 0) {
+            int b = work[--top];
+            for (int f = frontier_start[b]; f < frontier_start[b + 1]; f++) {
+                int target = frontier[f];
+                if (placed[target] == v) continue;
+                placed[target] = v;
+                placements = ir_grow(placements, &phi_capacity, 2 * phi_count + 2, sizeof(int));
+                placements[2 * phi_count] = target;
+                placements[2 * phi_count + 1] = v;
+                phi_count++;
+                if (queued[target] != v) {
+                    queued[target] = v;
+                    work[top++] = target;
+                }
+            }
+        }
+    }
+    int* phi_start = filled_ints(n + 1, 0);
+    for (int p = 0; p < phi_count; p++) phi_start[placements[2 * p] + 1]++;
+    for (int b = 0; b < n; b++) phi_start[b + 1] += phi_start[b];
+    int* phis = ir_alloc(NULL, phi_count * sizeof(int));
+    memcpy(cursor, phi_start, n * sizeof(int));
+    for (int p = 0; p < phi_count; p++) phis[cursor[placements[2 * p]]++] = placements[2 * p + 1];
+
+    // Rebuild the arrays with the phis at the head of their blocks
+    int operand_total = fn->operand_count;
+    for (int b = 0; b < n; b++) {
+        operand_total += (phi_start[b + 1] - phi_start[b]) * 2 * (g.pred_start[b + 1] - g.pred_start[b]);
+    }
+    int total = fn->instr_count + phi_count;
+    IRInstr* instrs = ir_alloc(NULL, total * sizeof(IRInstr));
+    int32_t* operands = ir_alloc(NULL, operand_total * sizeof(int32_t));
+    int* map = filled_ints(fn->instr_count, -1);
+    int count = 0;
+    int operand_count = 0;
+    for (int b = 0; b < n; b++) {
+        IRBlock* block = &fn->blocks[b];
+        int first = count;
+        for (int p = phi_start[b]; p < phi_start[b + 1]; p++) {
+            IRInstr* phi = &instrs[count++];
+            memset(phi, 0, sizeof(IRInstr));
+            phi->op = IR_PHI;
+            phi->a = -1;
+            phi->b = -1;
+            phi->imm = phis[p];
+            phi->args = operand_count;
+            operand_count += 2 * (g.pred_start[b + 1] - g.pred_start[b]);
+        }
+        for (int i = block->first; i < block->first + block->count; i++) {
+            instrs[count] = fn->instrs[i];
+            if (fn->instrs[i].op == IR_CALL) {
+                memcpy(operands + operand_count, fn->operands + fn->instrs[i].args,
+                       fn->instrs[i].nargs * sizeof(int32_t));
+                instrs[count].args = operand_count;
+                operand_count += fn->instrs[i].nargs;
+            }
+            map[i] = count++;
+        }
+        block->first = first;
+        block->count = count - first;
+    }
+    int undef = map[0];
+    ir_free(fn->instrs);
+    ir_free(fn->operands);
+    fn->instrs = instrs;
+    fn->instr_count = count;
+    fn->instr_capacity = total;
+    fn->operands = operands;
+    fn->operand_count = operand_count;
+    fn->operand_capacity = operand_total;
+    for (int i = 0; i < count; i++) visit_uses(fn, &fn->instrs[i], remap_use, map);
+
+    Renamer r = { fn, &g, filled_ints(slots, undef), NULL, NULL, 0 };
+    r.log_slot = ir_alloc(NULL, count * sizeof(int));
+    r.log_value = ir_alloc(NULL, count * sizeof(int));
+    rename_block(&r, 0);
+    fn->slot_count = 0;
+
+    ir_free(r.current);
+    ir_free(r.log_slot);
+    ir_free(r.log_value);
+    ir_free(map);
+    ir_free(phis);
+    ir_free(phi_start);
+    ir_free(placements);
+    ir_free(placed);
+    ir_free(queued);
+    ir_free(work);
+    ir_free(frontier);
+    ir_free(frontier_start);
+    ir_free(pairs);
+    ir_free(cursor);
+    ir_free(def_blocks);
+    ir_free(def_start);
+    ir_free(written);
+    ir_free(global);
+    ir_flow_free(&g);
+}
+
+
+static void collect_functions(ASTNode* node, IRModule* module, int* capacity) {
+    for (; node; node = node->next) {
+        if (node->type == NODE_SEQ) {
+            collect_functions(node->left, module, capacity);
+            collect_functions(node->right, module, capacity);
+        } else if (node->type == NODE_FUNC_DEF) {
+            IRFunction fn;
+            lower_function(&fn, node);
+            build_ssa(&fn);
+            compact(&fn);
+            module->functions = ir_grow(module->functions, capacity, module->count + 1, sizeof(IRFunction));
+            module->functions[module->count++] = fn;
+        }
+    }
+}
+
+
+IRModule* lower_to_ir(ASTNode* root) {
+    IRModule* module = ir_alloc(NULL, sizeof(IRModule));
+    module->functions = NULL;
+    module->count = 0;
+    int capacity = 0;
+    collect_functions(root, module, &capacity);
+    return module;
+}
+
+
+/* Folding: constant operands, algebraic identities, phis that merge a
+   single value and branches on constants. Operands are read through
+   copies, so values found equal by an earlier pass fold right away. */
+static bool make_const(IRInstr* ins, int value) {
+    ins->op = IR_CONST;
+    ins->imm = value;
+    ins->a = ins->b = -1;
+    ins->nargs = 0;
+    return true;
+}
+
+
+static bool make_copy(IRInstr* ins, int value) {
+    ins->op = IR_COPY;
+    ins->a = value;
+    ins->b = -1;
+    ins->nargs = 0;
+    return true;
+}
+
+
+static bool is_const(IRFunction* fn, int v, int value) {
+    return fn->instrs[v].op == IR_CONST && fn->instrs[v].imm == value;
+}
+
+
+static bool fold_binop(IRFunction* fn, IRInstr* ins) {
+    IRInstr* a = &fn->instrs[ins->a];
+    IRInstr* b = &fn->instrs[ins->b];
+    int result;
+    if (a->op == IR_CONST && b->op == IR_CONST && eval_binop(binop_symbols[ins->binop], a->imm, b->imm, &result)) {
+        return make_const(ins, result);
+    }
+
+    bool same = ins->a == ins->b;
+    switch (ins->binop) {
+        case IR_ADD:
+            if (is_const(fn, ins->a, 0)) return make_copy(ins, ins->b);
+            if (is_const(fn, ins->b, 0)) return make_copy(ins, ins->a);
+            break;
+        case IR_SUB:
+            if (is_const(fn, ins->b, 0)) return make_copy(ins, ins->a);
+            if (same) return make_const(ins, 0);
+            break;
+        case IR_MUL:
+            if (is_const(fn, ins->a, 0) || is_const(fn, ins->b, 0)) return make_const(ins, 0);
+            if (is_const(fn, ins->a, 1)) return make_copy(ins, ins->b);
+            if (is_const(fn, ins->b, 1)) return make_copy(ins, ins->a);
+            break;
+        case IR_DIV:
+            if (is_const(fn, ins->b, 1)) return make_copy(ins, ins->a);
+            break;
+        case IR_EQ:
+        case IR_LE:
+        case IR_GE:
+            if (same) return make_const(ins, 1);
+            break;
+        case IR_NE:
+        case IR_LT:
+        case IR_GT:
+            if (same) return make_const(ins, 0);
+            break;
+    }
+    return false;
+}
+
+
+static bool fold_phi(IRFunction* fn, IRInstr* ins, int self) {
+    int same = -1;
+    for (int k = 1; k < ins->nargs; k += 2) {
+        int v = fn->operands[ins->args + k];
+        if (v == self || v == same) continue;
+        if (same < 0) {
+            same = v;
+        } else if (fn->instrs[same].op != IR_CONST || !is_const(fn, v, fn->instrs[same].imm)) {
+            return false;
+        }
+    }
+
+    if (same < 0) {
+        ins->op = IR_UNDEF;
+        ins->nargs = 0;
+        return true;
+    }
+    if (fn->instrs[same].op == IR_CONST) return make_const(ins, fn->instrs[same].imm);
+    return make_copy(ins, same);
+}
+
+
+static void remove_phi_entries(IRFunction* fn, int block, int pred) {
+    IRBlock* target = &fn->blocks[block];
+    for (int i = target->first; i < target->first + target->count; i++) {
+        IRInstr* phi = &fn->instrs[i];
+        if (phi->op != IR_PHI) continue;
+
+        int kept = 0;
+        for (int k = 0; k < phi->nargs; k += 2) {
+            if (fn->operands[phi->args + k] == pred) continue;
+            fn->operands[phi->args + kept] = fn->operands[phi->args + k];
+            fn->operands[phi->args + kept + 1] = fn->operands[phi->args + k + 1];
+            kept += 2;
+        }
+        phi->nargs = kept;
+    }
+}
+
+
+static bool fold_values(IRFunction* fn) {
+    bool changed = false;
+
+    for (int b = 0; b < fn->block_count; b++) {
+        IRBlock* block = &fn->blocks[b];
+        for (int i = block->first; i < block->first + block->count; i++) {
+            IRInstr* ins = &fn->instrs[i];
+            visit_uses(fn, ins, resolve_copy, fn);
+
+            if (ins->op == IR_BINOP) {
+                changed |= fold_binop(fn, ins);
+            } else if (ins->op == IR_PHI) {
+                changed |= fold_phi(fn, ins, i);
+            } else if (ins->op == IR_BRANCH && fn->instrs[ins->a].op == IR_CONST) {
+                bool taken = fn->instrs[ins->a].imm != 0;
+                int target = block->succ[taken ? 0 : 1];
+                int dropped = block->succ[taken ? 1 : 0];
+                if (dropped != target) remove_phi_entries(fn, dropped, b);
+                ins->op = IR_JUMP;
+                ins->a = -1;
+                block->succ[0] = target;
+                block->succ[1] = -1;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+
+/* Common subexpressions, found with a hash table scoped to the dominator
+   tree: a value is reused only where its definition dominates. Entries
+   form a stack, so leaving a block just pops what it pushed. */
+typedef struct {
+    IRInstr key;
+    int value;
+    int bucket;
+    int next;       // older entry in the same bucket
+} ValueEntry;
+
+
+typedef struct {
+    IRFunction* fn;
+    FlowGraph* g;
+    int* buckets;
+    int mask;
+    ValueEntry* entries;
+    int count;
+    bool changed;
+} ValueTable;
+
+
+static unsigned int hash_value(IRInstr* ins) {
+    unsigned int h = ins->op * 31u + ins->binop;
+    h = h * 2654435761u ^ (unsigned int)ins->a;
+    h = h * 2654435761u ^ (unsigned int)ins->b;
+    h = h * 2654435761u ^ (unsigned int)ins->imm;
+    return h ^ (h >> 15);
+}
+
+
+static void number_block(ValueTable* t, int b) {
+    IRFunction* fn = t->fn;
+    IRBlock* block = &fn->blocks[b];
+    int mark = t->count;
+
+    for (int i = block->first; i < block->first + block->count; i++) {
+        IRInstr* ins = &fn->instrs[i];
+        if (ins->op != IR_CONST && ins->op != IR_BINOP) continue;
+
+        // Commutative operators are keyed with their operands in order
+        if (ins->op == IR_BINOP && ins->a > ins->b &&
+            (ins->binop == IR_ADD || ins->binop == IR_MUL || ins->binop == IR_EQ || ins->binop == IR_NE)) {
+            int swap = ins->a;
+            ins->a = ins->b;
+            ins->b = swap;
+        }
+
+        int bucket = (int)(hash_value(ins) & (unsigned int)t->mask);
+        int found = -1;
+        for (int e = t->buckets[bucket]; e >= 0 && found < 0; e = t->entries[e].next) {
+            IRInstr* key = &t->entries[e].key;
+            if (key->op == ins->op && key->binop == ins->binop && key->a == ins->a &&
+                key->b == ins->b && key->imm == ins->imm) found = t->entries[e].value;
+        }
+
+        if (found >= 0) {
+            make_copy(ins, found);
+            t->changed = true;
+            continue;
+        }
+
+        ValueEntry* entry = &t->entries[t->count];
+        entry->key = *ins;
+        entry->value = i;
+        entry->bucket = bucket;
+        entry->next = t->buckets[bucket];
+        t->buckets[bucket] = t->count++;
+    }
+
+    for (int c = t->g->child_start[b]; c < t->g->child_start[b + 1]; c++) {
+        number_block(t, t->g->children[c]);
+    }
+
+    while (t->count > mark) {
+        t->count--;
+        t->buckets[t->entries[t->count].bucket] = t->entries[t->count].next;
+    }
+}
+
+
+static bool eliminate_common_values(IRFunction* fn) {
+    FlowGraph g;
+    build_graph(fn, &g);
+
+    int slots = 16;
+    while (slots < fn->instr_count * 2) slots <<= 1;
+    ValueTable t = { fn, &g, filled_ints(slots, -1), slots - 1, NULL, 0, false };
+    t.entries = ir_alloc(NULL, fn->instr_count * sizeof(ValueEntry));
+    number_block(&t, 0);
+
+    ir_free(t.buckets);
+    ir_free(t.entries);
+    ir_flow_free(&g);
+    return t.changed;
+}
+
+
+typedef struct {
+    bool* live;
+    int* work;
+    int top;
+} LiveSet;
+
+
+static void mark_live(int32_t* value, void* data) {
+    LiveSet* set = data;
+    if (set->live[*value]) return;
+    set->live[*value] = true;
+    set->work[set->top++] = *value;
+}
+
+
+// Everything not feeding a call, a branch or a return is deleted
+static bool eliminate_dead_values(IRFunction* fn) {
+    LiveSet set = { ir_alloc(NULL, fn->instr_count * sizeof(bool)), ir_alloc(NULL, fn->instr_count * sizeof(int)), 0 };
+    memset(set.live, 0, fn->instr_count * sizeof(bool));
+
+    for (int i = 0; i < fn->instr_count; i++) {
+        int op = fn->instrs[i].op;
+        if (op == IR_CALL || op == IR_JUMP || op == IR_BRANCH || op == IR_RET) {
+            set.live[i] = true;
+            set.work[set.top++] = i;
+        }
+    }
+    while (set.top > 0) {
+        int i = set.work[--set.top];
+        visit_uses(fn, &fn->instrs[i], mark_live, &set);
+    }
+
+    bool changed = false;
+    for (int i = 0; i < fn->instr_count; i++) {
+        if (set.live[i] || fn->instrs[i].op == IR_NOP) continue;
+        kill_instr(&fn->instrs[i]);
+        changed = true;
+    }
+
+    ir_free(set.live);
+    ir_free(set.work);
+    return changed;
+}
+
+
+void optimize_ir(IRModule* module) {
+    if (!module) return;
+
+    for (int f = 0; f < module->count; f++) {
+        IRFunction* fn = &module->functions[f];
+        for (int round = 0; round < MAX_IR_ROUNDS; round++) {
+            bool changed = fold_values(fn);
+            compact(fn);
+            changed |= eliminate_common_values(fn);
+            changed |= eliminate_dead_values(fn);
+            compact(fn);
+            if (!changed) break;
+        }
+    }
+}
+
+
+static void print_operand(IRFunction* fn, int v, FILE* output) {
+    IRInstr* ins = &fn->instrs[v];
+    switch (ins->op) {
+        case IR_CONST:
+            if (ins->imm == INT_MIN) fprintf(output, "(-2147483647 - 1)");
+            else if (ins->imm < 0) fprintf(output, "(%d)", ins->imm);
+            else fprintf(output, "%d", ins->imm);
+            break;
+        case IR_STR: fprintf(output, "%s", ins->str); break;
+        case IR_PARAM: fprintf(output, "p%d", ins->imm); break;
+        case IR_UNDEF: fprintf(output, "0"); break;
+        default: fprintf(output, "v%d", v); break;
+    }
+}
+
+
+static void print_call(IRFunction* fn, IRInstr* ins, FILE* output) {
+    fprintf(output, "%s(", ins->str);
+    for (int k = 0; k < ins->nargs; k++) {
+        if (k > 0) fprintf(output, ", ");
+        print_operand(fn, fn->operands[ins->args + k], output);
+    }
+    fprintf(output, ")");
+}
+
+
+void print_ir(IRModule* module, FILE* output) {
+    if (!module) return;
+
+    for (int f = 0; f < module->count; f++) {
+        IRFunction* fn = &module->functions[f];
+        fprintf(output, "function %s(%d)\n", fn->name, fn->param_count);
+
+        for (int b = 0; b < fn->block_count; b++) {
+            IRBlock* block = &fn->blocks[b];
+            fprintf(output, "bb%d:\n", b);
+
+            for (int i = block->first; i < block->first + block->count; i++) {
+                IRInstr* ins = &fn->instrs[i];
+                switch (ins->op) {
+                    case IR_NOP: continue;
+                    case IR_UNDEF: fprintf(output, "    v%d = undef\n", i); break;
+                    case IR_CONST: fprintf(output, "    v%d = %d\n", i, ins->imm); break;
+                    case IR_STR: fprintf(output, "    v%d = %s\n", i, ins->str); break;
+                    case IR_PARAM: fprintf(output, "    v%d = param %d\n", i, ins->imm); break;
+                    case IR_COPY: fprintf(output, "    v%d = v%d\n", i, ins->a); break;
+                    case IR_LOAD: fprintf(output, "    v%d = load x%d\n", i, ins->imm); break;
+                    case IR_STORE: fprintf(output, "    store x%d, v%d\n", ins->imm, ins->a); break;
+                    case IR_JUMP: fprintf(output, "    jump bb%d\n", block->succ[0]); break;
+                    case IR_BINOP:
+                        fprintf(output, "    v%d = v%d %s v%d\n", i, ins->a, binop_symbols[ins->binop], ins->b);
+                        break;
+                    case IR_CALL:
+                        fprintf(output, "    v%d = call ", i);
+                        print_call(fn, ins, output);
+                        fprintf(output, "\n");
+                        break;
+                    case IR_PHI:
+                        fprintf(output, "    v%d = phi", i);
+                        for (int k = 0; k < ins->nargs; k += 2) {
+                            fprintf(output, " [bb%d v%d]", fn->operands[ins->args + k], fn->operands[ins->args + k + 1]);
+                        }
+                        fprintf(output, "\n");
+                        break;
+                    case IR_BRANCH:
+                        fprintf(output, "    branch v%d, bb%d, bb%d\n", ins->a, block->succ[0], block->succ[1]);
+                        break;
+                    case IR_RET:
+                        if (ins->a >= 0) fprintf(output, "    ret v%d\n", ins->a);
+                        else fprintf(output, "    ret\n");
+                        break;
+                }
+            }
+        }
+        fprintf(output, "\n");
+    }
+}
+
+
+/* C emission. SSA values become locals and blocks become labels; a phi is
+   assigned on each incoming edge, through temporaries whenever one of the
+   copies reads another phi of the same block. */
+// Value a phi takes when entered from `from`, -1 when there is no such edge
+static int phi_entry(IRFunction* fn, IRInstr* phi, int from) {
+    if (phi->op != IR_PHI) return -1;
+    for (int k = 0; k < phi->nargs; k += 2) {
+        if (fn->operands[phi->args + k] == from) return fn->operands[phi->args + k + 1];
+    }
+    return -1;
+}
+
+
+static bool has_phi_entry(IRFunction* fn, int from, int to) {
+    IRBlock* target = &fn->blocks[to];
+    for (int i = target->first; i < target->first + target->count; i++) {
+        if (phi_entry(fn, &fn->instrs[i], from) >= 0) return true;
+    }
+    return false;
+}
+
+
+static void emit_edge(IRFunction* fn, int from, int to, const char* indent, FILE* output) {
+    IRBlock* target = &fn->blocks[to];
+    int end = target->first + target->count;
+
+    bool parallel = false;
+    for (int i = target->first; i < end; i++) {
+        int value = phi_entry(fn, &fn->instrs[i], from);
+        if (value >= target->first && value < end && fn->instrs[value].op == IR_PHI) parallel = true;
+    }
+
+    if (parallel) fprintf(output, "%s{\n", indent);
+    for (int i = target->first; i < end; i++) {
+        int value = phi_entry(fn, &fn->instrs[i], from);
+        if (value < 0) continue;
+        if (parallel) fprintf(output, "%s    int t%d = ", indent, i);
+        else fprintf(output, "%sv%d = ", indent, i);
+        print_operand(fn, value, output);
+        fprintf(output, ";\n");
+    }
+    if (!parallel) return;
+
+    for (int i = target->first; i < end; i++) {
+        if (phi_entry(fn, &fn->instrs[i], from) >= 0) fprintf(output, "%s    v%d = t%d;\n", indent, i, i);
+    }
+    fprintf(output, "%s}\n", indent);
+}
+
+
+static void emit_function(IRFunction* fn, FILE* output) {
+    int* uses = filled_ints(fn->instr_count, 0);
+    bool* labeled = ir_alloc(NULL, (fn->block_count ? fn->block_count : 1) * sizeof(bool));
+    memset(labeled, 0, fn->block_count * sizeof(bool));
+
+    for (int i = 0; i < fn->instr_count; i++) {
+        IRInstr* ins = &fn->instrs[i];
+        if (ins->op == IR_BINOP) {
+            uses[ins->a]++;
+            uses[ins->b]++;
+        } else if (ins->op == IR_CALL) {
+            for (int k = 0; k < ins->nargs; k++) uses[fn->operands[ins->args + k]]++;
+        } else if (ins->op == IR_PHI) {
+            for (int k = 1; k < ins->nargs; k += 2) uses[fn->operands[ins->args + k]]++;
+        } else if (ins->op == IR_BRANCH || ins->op == IR_COPY || (ins->op == IR_RET && ins->a >= 0)) {
+            uses[ins->a]++;
+        }
+    }
+    for (int b = 0; b < fn->block_count; b++) {
+        IRBlock* block = &fn->blocks[b];
+        int op = fn->instrs[block->first + block->count - 1].op;
+        if (op == IR_BRANCH) labeled[block->succ[0]] = true;
+        if ((op == IR_BRANCH || op == IR_JUMP) && block->succ[op == IR_BRANCH ? 1 : 0] != b + 1) {
+            labeled[block->succ[op == IR_BRANCH ? 1 : 0]] = true;
+        }
+    }
+
+    fprintf(output, "int %s(", fn->name);
+    for (int p = 0; p < fn->param_count; p++) {
+        fprintf(output, "%sint p%d", p ? ", " : "", p);
+    }
+    fprintf(output, ") {\n");
+
+    int declared = 0;
+    for (int i = 0; i < fn->instr_count; i++) {
+        int op = fn->instrs[i].op;
+        bool named = op == IR_BINOP || op == IR_PHI || op == IR_COPY || (op == IR_CALL && uses[i] > 0);
+        if (!named) continue;
+        if (declared++ % 8 == 0) fprintf(output, "%s    int v%d", declared > 1 ? ";\n" : "", i);
+        else fprintf(output, ", v%d", i);
+    }
+    if (declared) fprintf(output, ";\n");
+
+    for (int b = 0; b < fn->block_count; b++) {
+        IRBlock* block = &fn->blocks[b];
+        if (labeled[b]) fprintf(output, "bb%d:\n", b);
+
+        for (int i = block->first; i < block->first + block->count; i++) {
+            IRInstr* ins = &fn->instrs[i];
+            switch (ins->op) {
+                case IR_BINOP:
+                    fprintf(output, "    v%d = ", i);
+                    print_operand(fn, ins->a, output);
+                    fprintf(output, " %s ", binop_symbols[ins->binop]);
+                    print_operand(fn, ins->b, output);
+                    fprintf(output, ";\n");
+                    break;
+
+                case IR_COPY:
+                    fprintf(output, "    v%d = ", i);
+                    print_operand(fn, ins->a, output);
+                    fprintf(output, ";\n");
+                    break;
+
+                case IR_CALL:
+                    fprintf(output, "    ");
+                    if (uses[i] > 0) fprintf(output, "v%d = ", i);
+                    print_call(fn, ins, output);
+                    fprintf(output, ";\n");
+                    break;
+
+                case IR_JUMP:
+                    emit_edge(fn, b, block->succ[0], "    ", output);
+                    if (block->succ[0] != b + 1) fprintf(output, "    goto bb%d;\n", block->succ[0]);
+                    break;
+
+                case IR_BRANCH:
+                    fprintf(output, "    if (");
+                    print_operand(fn, ins->a, output);
+                    if (has_phi_entry(fn, b, block->succ[0])) {
+                        fprintf(output, ") {\n");
+                        emit_edge(fn, b, block->succ[0], "        ", output);
+                        fprintf(output, "        goto bb%d;\n    }\n", block->succ[0]);
+                    } else {
+                        fprintf(output, ") goto bb%d;\n", block->succ[0]);
+                    }
+                    emit_edge(fn, b, block->succ[1], "    ", output);
+                    if (block->succ[1] != b + 1) fprintf(output, "    goto bb%d;\n", block->succ[1]);
+                    break;
+
+                case IR_RET:
+                    fprintf(output, "    return ");
+                    if (ins->a >= 0) print_operand(fn, ins->a, output);
+                    else fprintf(output, "0");
+                    fprintf(output, ";\n");
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+    fprintf(output, "}\n\n");
+
+    ir_free(uses);
+    ir_free(labeled);
+}
+
+
+void emit_ir_c(IRModule* module, FILE* output) {
+    if (!module) return;
+
+    // Prototypes let functions call each other in any order
+    for (int f = 0; f < module->count; f++) {
+        IRFunction* fn = &module->functions[f];
+        fprintf(output, "int %s(", fn->name);
+        for (int p = 0; p < fn->param_count; p++) {
+            fprintf(output, "%sint", p ? ", " : "");
+        }
+        fprintf(output, "%s);\n", fn->param_count ? "" : "void");
+    }
+    fprintf(output, "\n");
+
+    for (int f = 0; f < module->count; f++) {
+        emit_function(&module->functions[f], output);
+    }
+}
+
+
+void free_ir(IRModule* module) {
+    if (!module) return;
+
+    for (int f = 0; f < module->count; f++) {
+        IRFunction* fn = &module->functions[f];
+        for (int i = 0; i < fn->instr_count; i++) ir_free(fn->instrs[i].str);
+        ir_free(fn->instrs);
+        ir_free(fn->blocks);
+        ir_free(fn->operands);
+        ir_free(fn->name);
+    }
+    ir_free(module->functions);
+    ir_free(module);
+}
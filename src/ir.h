@@ -0,0 +1,89 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "ast.h"
+
+
+/* Three-address SSA form of a program. A function keeps its instructions,
+   blocks and operand lists in flat arrays and refers to everything by
+   index: an instruction's index names the value it defines, and a block
+   owns a contiguous run of instructions, phis first and terminator last. */
+
+typedef enum {
+    IR_NOP,         // deleted, dropped by the next compaction
+    IR_UNDEF,       // read of a variable nothing was assigned to
+    IR_CONST,       // imm
+    IR_STR,         // str, a string literal with its quotes
+    IR_PARAM,       // imm = parameter position
+    IR_COPY,        // a
+    IR_BINOP,       // a binop b
+    IR_CALL,        // str(operands[args .. args + nargs))
+    IR_PHI,         // operands hold (predecessor block, value) pairs
+    IR_LOAD,        // variable slot imm, only before SSA construction
+    IR_STORE,       // slot imm = a, only before SSA construction
+    IR_JUMP,        // to succ[0] of the block
+    IR_BRANCH,      // a ? succ[0] : succ[1]
+    IR_RET          // a, or -1 when control falls off the end
+} IROp;
+
+
+typedef enum {
+    IR_ADD, IR_SUB, IR_MUL, IR_DIV,
+    IR_LT, IR_LE, IR_GT, IR_GE, IR_EQ, IR_NE
+} IRBinop;
+
+
+typedef struct {
+    uint8_t op;         // IROp
+    uint8_t binop;      // IRBinop
+    int32_t a;
+    int32_t b;
+    int32_t imm;
+    int32_t args;       // first operand of a call or phi
+    int32_t nargs;      // operands used, two per phi entry
+    char* str;
+} IRInstr;
+
+
+typedef struct {
+    int32_t first;
+    int32_t count;
+    int32_t succ[2];    // -1 when absent
+} IRBlock;
+
+
+typedef struct {
+    char* name;
+    int param_count;
+    int slot_count;     // source variables, until SSA construction
+    IRInstr* instrs;
+    int instr_count;
+    int instr_capacity;
+    IRBlock* blocks;
+    int block_count;
+    int block_capacity;
+    int32_t* operands;
+    int operand_count;
+    int operand_capacity;
+} IRFunction;
+
+
+typedef struct {
+    IRFunction* functions;
+    int count;
+} IRModule;
+
+
+IRModule* lower_to_ir(ASTNode* root);
+
+void optimize_ir(IRModule* module);
+
+void print_ir(IRModule* module, FILE* output);
+
+void emit_ir_c(IRModule* module, FILE* output);
+
+void free_ir(IRModule* module);
+
+#endif
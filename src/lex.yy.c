@@ -351,8 +351,8 @@ static void yynoreturn yy_fatal_error ( const char* msg  );
 	(yy_hold_char) = *yy_cp; \
 	*yy_cp = '\0'; \
 	(yy_c_buf_p) = yy_cp;
-#define YY_NUM_RULES 24
-#define YY_END_OF_BUFFER 25
+#define YY_NUM_RULES 30
+#define YY_END_OF_BUFFER 31
 /* This struct is not used in this scanner,
    but its presence is necessary. */
 struct yy_trans_info
@@ -360,13 +360,13 @@ struct yy_trans_info
 	flex_int32_t yy_verify;
 	flex_int32_t yy_nxt;
 	};
-static const flex_int16_t yy_accept[43] =
+static const flex_int16_t yy_accept[49] =
     {   0,
-        0,    0,   25,   23,   21,   21,   23,    8,    9,   14,
-       12,    7,   13,   15,   20,    6,   16,    5,   19,   19,
-       19,   19,   10,   11,   21,    0,   22,   17,   18,   20,
-       19,   19,    2,   19,   19,    3,    1,   19,   19,   19,
-        4,    0
+        0,    0,   31,   29,   27,   27,   22,   29,    8,    9,
+       14,   12,    7,   13,   15,   26,    6,   16,    5,   18,
+       25,   25,   25,   25,   10,   11,   27,   21,    0,   28,
+       23,   24,   26,   17,   20,   19,   25,   25,    2,   25,
+       25,    3,    1,   25,   25,   25,    4,    0
     } ;
 
 static const YY_CHAR yy_ec[256] =
@@ -374,17 +374,17 @@ static const YY_CHAR yy_ec[256] =
         1,    1,    1,    1,    1,    1,    1,    1,    2,    3,
         1,    1,    2,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    2,    1,    4,    1,    1,    1,    1,    1,    5,
-        6,    7,    8,    9,   10,    1,   11,   12,   12,   12,
-       12,   12,   12,   12,   12,   12,   12,    1,   13,   14,
-       15,    1,    1,    1,   16,   16,   16,   16,   16,   16,
-       16,   16,   16,   16,   16,   16,   16,   16,   16,   16,
-       16,   16,   16,   16,   16,   16,   16,   16,   16,   16,
-        1,    1,    1,    1,   16,    1,   16,   16,   16,   16,
-
-       17,   18,   16,   16,   19,   16,   16,   16,   16,   20,
-       21,   16,   16,   22,   16,   23,   24,   16,   16,   16,
-       16,   16,   25,    1,   26,    1,    1,    1,    1,    1,
+        1,    2,    4,    5,    1,    1,    1,    1,    1,    6,
+        7,    8,    9,   10,   11,    1,   12,   13,   13,   13,
+       13,   13,   13,   13,   13,   13,   13,    1,   14,   15,
+       16,   17,    1,    1,   18,   18,   18,   18,   18,   18,
+       18,   18,   18,   18,   18,   18,   18,   18,   18,   18,
+       18,   18,   18,   18,   18,   18,   18,   18,   18,   18,
+        1,    1,    1,    1,   18,    1,   18,   18,   18,   18,
+
+       19,   20,   18,   18,   21,   18,   18,   18,   18,   22,
+       23,   18,   18,   24,   18,   25,   26,   18,   18,   18,
+       18,   18,   27,    1,   28,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
@@ -401,53 +401,55 @@ static const YY_CHAR yy_ec[256] =
         1,    1,    1,    1,    1
     } ;
 
-static const YY_CHAR yy_meta[27] =
+static const YY_CHAR yy_meta[29] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    2,    1,    1,    1,    2,    2,    2,    2,    2,
-        2,    2,    2,    2,    1,    1
+        1,    1,    2,    1,    1,    1,    1,    2,    2,    2,
+        2,    2,    2,    2,    2,    2,    1,    1
     } ;
 
-static const flex_int16_t yy_base[45] =
+static const flex_int16_t yy_base[51] =
     {   0,
-        0,    0,   52,   53,   25,   27,   47,   53,   53,   53,
-       42,   53,   39,   53,   36,   53,   53,   53,    0,   26,
-       13,   29,   53,   53,   32,   41,   53,   53,   53,   32,
-        0,   21,    0,   19,   18,    0,    0,   16,   17,   18,
-        0,   53,   35,   30
+        0,    0,   58,   59,   27,   29,   41,   51,   59,   59,
+       59,   46,   59,   43,   59,   40,   59,   36,   35,   34,
+        0,   26,   13,   29,   59,   59,   34,   59,   42,   59,
+       59,   59,   33,   59,   59,   59,    0,   21,    0,   19,
+       18,    0,    0,   16,   17,   18,    0,   59,   37,   32
     } ;
 
-static const flex_int16_t yy_def[45] =
+static const flex_int16_t yy_def[51] =
     {   0,
-       42,    1,   42,   42,   42,   42,   43,   42,   42,   42,
-       42,   42,   42,   42,   42,   42,   42,   42,   44,   44,
-       44,   44,   42,   42,   42,   43,   42,   42,   42,   42,
-       44,   44,   44,   44,   44,   44,   44,   44,   44,   44,
-       44,    0,   42,   42
+       48,    1,   48,   48,   48,   48,   48,   49,   48,   48,
+       48,   48,   48,   48,   48,   48,   48,   48,   48,   48,
+       50,   50,   50,   50,   48,   48,   48,   48,   49,   48,
+       48,   48,   48,   48,   48,   48,   50,   50,   50,   50,
+       50,   50,   50,   50,   50,   50,   50,    0,   48,   48
     } ;
 
-static const flex_int16_t yy_nxt[80] =
+static const flex_int16_t yy_nxt[88] =
     {   0,
         4,    5,    6,    7,    8,    9,   10,   11,   12,   13,
-       14,   15,   16,   17,   18,   19,   19,   20,   21,   19,
-       19,   22,   19,   19,   23,   24,   25,   25,   25,   25,
-       33,   31,   34,   25,   25,   26,   26,   41,   40,   39,
-       38,   37,   36,   30,   27,   35,   32,   30,   29,   28,
-       27,   42,    3,   42,   42,   42,   42,   42,   42,   42,
-       42,   42,   42,   42,   42,   42,   42,   42,   42,   42,
-       42,   42,   42,   42,   42,   42,   42,   42,   42
+       14,   15,   16,   17,   18,   19,   20,   21,   21,   22,
+       23,   21,   21,   24,   21,   21,   25,   26,   27,   27,
+       27,   27,   39,   37,   40,   27,   27,   29,   29,   47,
+       46,   45,   44,   43,   42,   33,   30,   41,   38,   36,
+       35,   34,   33,   32,   31,   30,   28,   48,    3,   48,
+       48,   48,   48,   48,   48,   48,   48,   48,   48,   48,
+       48,   48,   48,   48,   48,   48,   48,   48,   48,   48,
+       48,   48,   48,   48,   48,   48,   48
     } ;
 
-static const flex_int16_t yy_chk[80] =
+static const flex_int16_t yy_chk[88] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    1,    1,    1,    5,    5,    6,    6,
-       21,   44,   21,   25,   25,   43,   43,   40,   39,   38,
-       35,   34,   32,   30,   26,   22,   20,   15,   13,   11,
-        7,    3,   42,   42,   42,   42,   42,   42,   42,   42,
-       42,   42,   42,   42,   42,   42,   42,   42,   42,   42,
-       42,   42,   42,   42,   42,   42,   42,   42,   42
+        1,    1,    1,    1,    1,    1,    1,    1,    5,    5,
+        6,    6,   23,   50,   23,   27,   27,   49,   49,   46,
+       45,   44,   41,   40,   38,   33,   29,   24,   22,   20,
+       19,   18,   16,   14,   12,    8,    7,    3,   48,   48,
+       48,   48,   48,   48,   48,   48,   48,   48,   48,   48,
+       48,   48,   48,   48,   48,   48,   48,   48,   48,   48,
+       48,   48,   48,   48,   48,   48,   48
     } ;
 
 static yy_state_type yy_last_accepting_state;
@@ -467,10 +469,18 @@ char *yytext;
 #line 1 "lexer.l"
 #line 2 "lexer.l"
 #include "parser.tab.h"
+#include "memtrack.h"
 #include <string.h>
 #include <stdlib.h>
-#line 473 "lex.yy.c"
-#line 474 "lex.yy.c"
+
+static uint32_t offset = 0;
+
+#define YY_USER_ACTION \
+    yylloc.first = offset; \
+    offset += (uint32_t)yyleng; \
+    yylloc.last = offset;
+#line 483 "lex.yy.c"
+#line 484 "lex.yy.c"
 
 #define INITIAL 0
 
@@ -687,11 +697,11 @@ YY_DECL
 		}
 
 	{
-#line 11 "lexer.l"
+#line 19 "lexer.l"
 
 
 
-#line 695 "lex.yy.c"
+#line 705 "lex.yy.c"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
@@ -718,13 +728,13 @@ yy_match:
 			while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 				{
 				yy_current_state = (int) yy_def[yy_current_state];
-				if ( yy_current_state >= 43 )
+				if ( yy_current_state >= 49 )
 					yy_c = yy_meta[yy_c];
 				}
 			yy_current_state = yy_nxt[yy_base[yy_current_state] + yy_c];
 			++yy_cp;
 			}
-		while ( yy_base[yy_current_state] != 53 );
+		while ( yy_base[yy_current_state] != 59 );
 
 yy_find_action:
 		yy_act = yy_accept[yy_current_state];
@@ -750,127 +760,157 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 14 "lexer.l"
+#line 22 "lexer.l"
 { return KW_INT; }
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 15 "lexer.l"
+#line 23 "lexer.l"
 { return KW_IF; }
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 16 "lexer.l"
+#line 24 "lexer.l"
 { return KW_FOR; }
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 17 "lexer.l"
+#line 25 "lexer.l"
 { return KW_RETURN; }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 20 "lexer.l"
+#line 28 "lexer.l"
 { return ASSIGN; }
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 21 "lexer.l"
+#line 29 "lexer.l"
 { return SEMICOLON; }
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 22 "lexer.l"
+#line 30 "lexer.l"
 { return COMMA; }
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 23 "lexer.l"
+#line 31 "lexer.l"
 { return LPAREN; }
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 24 "lexer.l"
+#line 32 "lexer.l"
 { return RPAREN; }
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 25 "lexer.l"
+#line 33 "lexer.l"
 { return LBRACE; }
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 26 "lexer.l"
+#line 34 "lexer.l"
 { return RBRACE; }
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 27 "lexer.l"
+#line 35 "lexer.l"
 { return PLUS; }
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 28 "lexer.l"
+#line 36 "lexer.l"
 { return MINUS; }
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 29 "lexer.l"
+#line 37 "lexer.l"
 { return MUL; }
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 30 "lexer.l"
+#line 38 "lexer.l"
 { return DIV; }
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 31 "lexer.l"
+#line 39 "lexer.l"
 { return LT; }
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 32 "lexer.l"
-{ return INCR; }
+#line 40 "lexer.l"
+{ return LE; }
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 33 "lexer.l"
-{ return DECR; }
+#line 41 "lexer.l"
+{ return GT; }
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 36 "lexer.l"
-{ yylval.str = strdup(yytext); return IDENTIFIER; }
+#line 42 "lexer.l"
+{ return GE; }
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 37 "lexer.l"
-{ yylval.ival = atoi(yytext); return NUMBER; }
+#line 43 "lexer.l"
+{ return EQ; }
 	YY_BREAK
 case 21:
-/* rule 21 can match eol */
 YY_RULE_SETUP
-#line 40 "lexer.l"
-{  }
+#line 44 "lexer.l"
+{ return NE; }
 	YY_BREAK
 case 22:
-/* rule 22 can match eol */
 YY_RULE_SETUP
-#line 43 "lexer.l"
-{ yylval.str = strdup(yytext); return STRING; }
+#line 45 "lexer.l"
+{ return '!'; }
 	YY_BREAK
 case 23:
 YY_RULE_SETUP
 #line 46 "lexer.l"
-{ return yytext[0]; }
+{ return INCR; }
 	YY_BREAK
 case 24:
 YY_RULE_SETUP
-#line 48 "lexer.l"
+#line 47 "lexer.l"
+{ return DECR; }
+	YY_BREAK
+case 25:
+YY_RULE_SETUP
+#line 50 "lexer.l"
+{ yylval.str = mem_strdup(MEM_LEXER, yytext); return IDENTIFIER; }
+	YY_BREAK
+case 26:
+YY_RULE_SETUP
+#line 51 "lexer.l"
+{ yylval.ival = atoi(yytext); return NUMBER; }
+	YY_BREAK
+case 27:
+/* rule 27 can match eol */
+YY_RULE_SETUP
+#line 54 "lexer.l"
+{  }
+	YY_BREAK
+case 28:
+/* rule 28 can match eol */
+YY_RULE_SETUP
+#line 57 "lexer.l"
+{ yylval.str = mem_strdup(MEM_LEXER, yytext); return STRING; }
+	YY_BREAK
+case 29:
+YY_RULE_SETUP
+#line 60 "lexer.l"
+{ return yytext[0]; }
+	YY_BREAK
+case 30:
+YY_RULE_SETUP
+#line 62 "lexer.l"
 ECHO;
 	YY_BREAK
-#line 874 "lex.yy.c"
+#line 914 "lex.yy.c"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -1167,7 +1207,7 @@ static int yy_get_next_buffer (void)
 		while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 			{
 			yy_current_state = (int) yy_def[yy_current_state];
-			if ( yy_current_state >= 43 )
+			if ( yy_current_state >= 49 )
 				yy_c = yy_meta[yy_c];
 			}
 		yy_current_state = yy_nxt[yy_base[yy_current_state] + yy_c];
@@ -1195,11 +1235,11 @@ static int yy_get_next_buffer (void)
 	while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 		{
 		yy_current_state = (int) yy_def[yy_current_state];
-		if ( yy_current_state >= 43 )
+		if ( yy_current_state >= 49 )
 			yy_c = yy_meta[yy_c];
 		}
 	yy_current_state = yy_nxt[yy_base[yy_current_state] + yy_c];
-	yy_is_jam = (yy_current_state == 42);
+	yy_is_jam = (yy_current_state == 48);
 
 		return yy_is_jam ? 0 : yy_current_state;
 }
@@ -1875,9 +1915,18 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 48 "lexer.l"
+#line 62 "lexer.l"
 
 
 int yywrap() {
     return 1;
 }
+
+
+// Scans `text` instead of yyin, for processes that parse more than one source
+void lexer_set_text(const char* text, size_t length) {
+    static YY_BUFFER_STATE buffer = NULL;
+    if (buffer) yy_delete_buffer(buffer);
+    buffer = yy_scan_bytes(text, (int)length);
+    offset = 0;
+}
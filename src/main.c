@@ -1,38 +1,277 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include "ast.h"
+#include "ast_diff.h"
+#include "ast_store.h"
+#include "daemon.h"
+#include "ir.h"
+#include "memtrack.h"
+#include "srcloc.h"
 
-extern int yyparse();
-extern FILE* yyin;              
+#define CACHE_PATH "ast_cache.bin"
+#define STATS_PATH "stats.json"
+
+int parse_program(void);
+extern FILE* yyin;
 extern ASTNode* ast_root;
+extern int parse_error_count;
+extern FILE* parse_error_output;
+void lexer_set_text(const char* text, size_t length);
+
+static void emit_ir(ASTNode* root, FILE* listing, FILE* code) {
+    IRModule* ir = lower_to_ir(root);
+    optimize_ir(ir);
+    print_ir(ir, listing);
+    emit_ir_c(ir, code);
+    free_ir(ir);
+}
+
+static int write_ir(ASTNode* root) {
+    FILE* listing = fopen("ir.txt", "w");
+    FILE* code = fopen("ir_output.c", "w");
+    if (!listing || !code) {
+        perror(listing ? "ir_output.c" : "ir.txt");
+        if (listing) fclose(listing);
+        if (code) fclose(code);
+        return 1;
+    }
+
+    emit_ir(root, listing, code);
+
+    fclose(listing);
+    fclose(code);
+    return 0;
+}
+
+static void report_parse_errors(FILE* output, int status) {
+    if (status != 0 || parse_error_count > 0) {
+        fprintf(output, "%d parse error(s); %s\n", parse_error_count,
+                ast_root ? "continuing with the partial AST" : "no AST produced");
+    }
+}
+
+// Writes the output.txt report and returns the optimized tree
+static ASTNode* write_report(ASTNode* root, FILE* out, const char* cache_path) {
+    fprintf(out, "Original AST:\n");
+    print_ast(root, out, 0);
+
+    ASTNode* original = deep_copy_ast(root);
+    reset_opt_stats();
+    root=optimize_ast_cached(root, cache_path);
+
+    fprintf(out,"Optimized AST:\n");
+    print_ast(root,out,0);
+
+    ASTDiff* diff = diff_ast(original, root);
+    fprintf(out, "AST Diff:\n");
+    print_ast_diff(diff, out);
+    free_ast_diff(diff);
+
+    fprintf(out, "Provenance:\n");
+    print_provenance(original, root, out);
+    free_ast(original);
+    return root;
+}
+
+// Written once the trees are freed, so live memory is what leaked
+static void print_stats(FILE* output) {
+    OptStats stats;
+    get_opt_stats(&stats);
+    fprintf(output, "{\n  \"optimizer\": ");
+    print_opt_stats_json(&stats, output, 2);
+    fprintf(output, ",\n  \"memory\": ");
+    print_mem_usage_json(output, 2);
+    fprintf(output, "\n}\n");
+}
+
+static int write_stats(void) {
+    FILE* output = fopen(STATS_PATH, "w");
+    if (!output) {
+        perror(STATS_PATH);
+        return 1;
+    }
+    print_stats(output);
+    fclose(output);
+    return 0;
+}
+
+// A tree sent in binary form is the original of its request
+static void claim_nodes(ASTNode* node) {
+    for (; node; node = node->next) {
+        node->origin = node->id;
+        node->pass = PASS_PARSE;
+        for (int i = 0; i < ast_slot_count(node->type); i++) {
+            claim_nodes(node->child[i]);
+        }
+    }
+}
+
+static int handle_request(const DaemonRequest* request, FILE* sections[REPLY_SECTIONS]) {
+    FILE* diagnostics = sections[REPLY_DIAGNOSTICS];
+    int status = 0;
+
+    // The previous request freed all its nodes
+    ast_reset_ids();
+    reset_mem_peaks();
+    ast_root = NULL;
+    parse_error_count = 0;
+
+    if (request->kind == DAEMON_SOURCE) {
+        srcloc_set_text("input.c", request->body, request->length);
+        lexer_set_text(request->body, request->length);
+        parse_error_output = diagnostics;
+        status = parse_program();
+        parse_error_output = NULL;
+        report_parse_errors(diagnostics, status);
+    } else {
+        srcloc_set_text("<ast>", "", 0);
+        FILE* input = request->length ? fmemopen((void*)request->body, request->length, "rb") : NULL;
+        ASTStore* store = input ? ast_store_read(input) : NULL;
+        if (input) fclose(input);
+        if (!store) {
+            fprintf(diagnostics, "Malformed AST\n");
+            return DAEMON_ERROR;
+        }
+        ast_root = ast_store_to_tree(store, 0);
+        free_ast_store(store);
+        claim_nodes(ast_root);
+    }
+
+    const char* cache_path = request->flags & DAEMON_INCREMENTAL ? CACHE_PATH : NULL;
+    ASTNode* root = write_report(ast_root, sections[REPLY_OUTPUT], cache_path);
+    if (request->flags & DAEMON_WANT_IR) {
+        emit_ir(root, sections[REPLY_IR], sections[REPLY_IR_CODE]);
+    }
+    free_ast(root);
+    ast_root = NULL;
+    if (request->flags & DAEMON_STATS) {
+        print_stats(sections[REPLY_STATS]);
+    }
+    report_mem_leaks(stderr, "request");
+    return parse_error_count > 0 || status != 0;
+}
 
-int main() {
-  
-    yyin = fopen("input.c", "r");   
+static char* read_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    size_t capacity = 4096;
+    size_t n;
+    char* text = malloc(capacity);
+    *length = 0;
+    while (text && (n = fread(text + *length, 1, capacity - *length, file)) > 0) {
+        *length += n;
+        if (*length == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+    fclose(file);
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return text;
+}
+
+static int write_file(const char* path, const char* data, size_t length) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+    fwrite(data, 1, length, file);
+    fclose(file);
+    return 0;
+}
+
+// Same files as a local run, produced by a daemon started with --serve
+static int run_client(const char* socket_path, int want_ir, int incremental, int want_stats) {
+    size_t length;
+    char* text = read_file("input.c", &length);
+    if (!text) {
+        perror("input.c");
+        return 1;
+    }
+
+    DaemonRequest request = { DAEMON_SOURCE, 0, text, length };
+    if (want_ir) request.flags |= DAEMON_WANT_IR;
+    if (incremental) request.flags |= DAEMON_INCREMENTAL;
+    if (want_stats) request.flags |= DAEMON_STATS;
+
+    char* sections[REPLY_SECTIONS];
+    size_t lengths[REPLY_SECTIONS];
+    int status = daemon_request(socket_path, &request, sections, lengths);
+    free(text);
+    if (status < 0) return 1;
+
+    fwrite(sections[REPLY_DIAGNOSTICS], 1, lengths[REPLY_DIAGNOSTICS], stderr);
+    int failed = status == DAEMON_ERROR ||
+                 write_file("output.txt", sections[REPLY_OUTPUT], lengths[REPLY_OUTPUT]);
+    if (want_ir && !failed) {
+        failed = write_file("ir.txt", sections[REPLY_IR], lengths[REPLY_IR]) ||
+                 write_file("ir_output.c", sections[REPLY_IR_CODE], lengths[REPLY_IR_CODE]);
+    }
+    if (want_stats && !failed) {
+        failed = write_file(STATS_PATH, sections[REPLY_STATS], lengths[REPLY_STATS]);
+    }
+    for (int s = 0; s < REPLY_SECTIONS; s++) {
+        free(sections[s]);
+    }
+    if (failed) return 1;
+
+    printf("AST saved to output.txt\n");
+    return status;
+}
+
+int main(int argc, char** argv) {
+    int emit_ir = 0;
+    int want_stats = 0;
+    const char* cache_path = NULL;
+    const char* serve_path = NULL;
+    const char* connect_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ir") == 0) emit_ir = 1;
+        else if (strcmp(argv[i], "--incremental") == 0) cache_path = CACHE_PATH;
+        else if (strcmp(argv[i], "--stats") == 0) want_stats = 1;
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) serve_path = argv[++i];
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) connect_path = argv[++i];
+    }
+
+    if (serve_path) return run_daemon(serve_path, handle_request);
+    if (connect_path) return run_client(connect_path, emit_ir, cache_path != NULL, want_stats);
+
+    yyin = fopen("input.c", "r");
     if (!yyin) {
         perror("input.c");
         return 1;
     }
+    srcloc_set_file("input.c");
+
 
-   
     FILE* out = fopen("output.txt", "w");
     if (!out) {
         perror("output.txt");
         return 1;
     }
 
-    yyparse();
+    int status = parse_program();
+    report_parse_errors(stderr, status);
 
-    fprintf(out, "Original AST:\n");
-    print_ast(ast_root, out, 0);
+    ast_root = write_report(ast_root, out, cache_path);
 
-    ast_root=optimize_ast(ast_root);
-    
-    fprintf(out,"Optimized AST:\n");
-    print_ast(ast_root,out,0);
+    if (emit_ir && write_ir(ast_root) != 0) {
+        return 1;
+    }
+    free_ast(ast_root);
+    if (want_stats && write_stats() != 0) {
+        return 1;
+    }
+    report_mem_leaks(stderr, "input.c");
 
     fclose(yyin);
     fclose(out);
 
     printf("AST saved to output.txt\n");
-    return 0;
-}
\ No newline at end of file
+    return parse_error_count > 0 || status != 0;
+}
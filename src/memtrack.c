@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "memtrack.h"
+
+
+typedef struct {
+    long nodes;
+    long bytes;
+    long peak_nodes;
+    long peak_bytes;
+    unsigned long allocations;
+} MemCounters;
+
+static MemCounters counters[MEM_TOTAL + 1];
+
+static __thread MemSubsystem current_subsystem = MEM_OTHER;
+
+
+MemSubsystem mem_enter(MemSubsystem subsystem) {
+    MemSubsystem previous = current_subsystem;
+    current_subsystem = subsystem;
+    return previous;
+}
+
+
+MemSubsystem mem_current(void) {
+    return current_subsystem;
+}
+
+
+static void raise_peak(long* peak, long value) {
+    long seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (value > seen && !__atomic_compare_exchange_n(peak, &seen, value, true,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+
+static void charge(MemCounters* c, long nodes, long bytes) {
+    long live_nodes = __atomic_add_fetch(&c->nodes, nodes, __ATOMIC_RELAXED);
+    long live_bytes = __atomic_add_fetch(&c->bytes, bytes, __ATOMIC_RELAXED);
+    if (bytes > 0) {
+        __atomic_fetch_add(&c->allocations, 1, __ATOMIC_RELAXED);
+        raise_peak(&c->peak_nodes, live_nodes);
+        raise_peak(&c->peak_bytes, live_bytes);
+    }
+}
+
+
+void mem_charge(MemSubsystem subsystem, long nodes, long bytes) {
+    charge(&counters[subsystem], nodes, bytes);
+    charge(&counters[MEM_TOTAL], nodes, bytes);
+}
+
+
+char* mem_strdup(MemSubsystem subsystem, const char* text) {
+    char* copy = strdup(text);
+    if (!copy) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    mem_charge(subsystem, 0, (long)strlen(copy) + 1);
+    return copy;
+}
+
+
+void mem_free_string(MemSubsystem subsystem, char* text) {
+    if (!text) return;
+    mem_charge(subsystem, 0, -((long)strlen(text) + 1));
+    free(text);
+}
+
+
+const char* mem_subsystem_name(MemSubsystem subsystem) {
+    switch (subsystem) {
+        case MEM_LEXER: return "lexer";
+        case MEM_PARSER: return "parser";
+        case MEM_OPTIMIZER: return "optimizer";
+        case MEM_CODEGEN: return "codegen";
+        case MEM_OTHER: return "other";
+        case MEM_TOTAL: return "total";
+        default: return "unknown";
+    }
+}
+
+
+void get_mem_usage(MemSubsystem subsystem, MemUsage* usage) {
+    MemCounters* c = &counters[subsystem];
+    usage->nodes = __atomic_load_n(&c->nodes, __ATOMIC_RELAXED);
+    usage->bytes = __atomic_load_n(&c->bytes, __ATOMIC_RELAXED);
+    usage->peak_nodes = __atomic_load_n(&c->peak_nodes, __ATOMIC_RELAXED);
+    usage->peak_bytes = __atomic_load_n(&c->peak_bytes, __ATOMIC_RELAXED);
+    usage->allocations = __atomic_load_n(&c->allocations, __ATOMIC_RELAXED);
+}
+
+
+void reset_mem_peaks(void) {
+    for (int s = 0; s <= MEM_TOTAL; s++) {
+        MemCounters* c = &counters[s];
+        __atomic_store_n(&c->peak_nodes, __atomic_load_n(&c->nodes, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_store_n(&c->peak_bytes, __atomic_load_n(&c->bytes, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+}
+
+
+void print_mem_usage_json(FILE* output, int indent) {
+    fprintf(output, "{\n");
+    for (int s = 0; s <= MEM_TOTAL; s++) {
+        MemUsage usage;
+        get_mem_usage((MemSubsystem)s, &usage);
+        fprintf(output, "%*s  \"%s\": {\"nodes\": %ld, \"bytes\": %ld, \"peak_nodes\": %ld, "
+                "\"peak_bytes\": %ld, \"allocations\": %lu}%s\n",
+                indent, "", mem_subsystem_name((MemSubsystem)s), usage.nodes, usage.bytes,
+                usage.peak_nodes, usage.peak_bytes, usage.allocations, s < MEM_TOTAL ? "," : "");
+    }
+    fprintf(output, "%*s}", indent, "");
+}
+
+
+int report_mem_leaks(FILE* output, const char* when) {
+    int leaking = 0;
+    for (int s = 0; s < MEM_TOTAL; s++) {
+        MemUsage usage;
+        get_mem_usage((MemSubsystem)s, &usage);
+        if (usage.nodes == 0 && usage.bytes == 0) continue;
+        fprintf(output, "%s: %s leaked %ld node(s), %ld byte(s)\n",
+                when, mem_subsystem_name((MemSubsystem)s), usage.nodes, usage.bytes);
+        leaking++;
+    }
+    return leaking;
+}
@@ -0,0 +1,56 @@
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Allocation accounting by subsystem. An AST node is charged to the
+   subsystem its creating thread was in (see mem_enter()) until it is freed,
+   whoever frees it; token text and IR buffers are charged by the code that
+   owns them. Scratch tables a pass frees before returning are not counted.
+   Counters are relaxed atomics shared by all threads. */
+
+typedef enum {
+    MEM_LEXER,          // token text until the parser consumes it
+    MEM_PARSER,         // nodes built by the grammar actions
+    MEM_OPTIMIZER,      // nodes created by the passes and the cache
+    MEM_CODEGEN,        // the IR of --ir
+    MEM_OTHER,          // everything else, such as the copy kept for the diff
+    MEM_TOTAL           // all of the above together
+} MemSubsystem;
+
+typedef struct {
+    long nodes;                 // AST nodes alive
+    long bytes;                 // bytes alive, nodes and their text included
+    long peak_nodes;            // most alive at once since reset_mem_peaks()
+    long peak_bytes;
+    unsigned long allocations;  // made since the start
+} MemUsage;
+
+
+// Charges nodes the calling thread creates to `subsystem`; returns the previous one
+MemSubsystem mem_enter(MemSubsystem subsystem);
+
+MemSubsystem mem_current(void);
+
+// Records `nodes` and `bytes` more (fewer when negative) alive in `subsystem`
+void mem_charge(MemSubsystem subsystem, long nodes, long bytes);
+
+char* mem_strdup(MemSubsystem subsystem, const char* text);
+
+void mem_free_string(MemSubsystem subsystem, char* text);
+
+const char* mem_subsystem_name(MemSubsystem subsystem);
+
+void get_mem_usage(MemSubsystem subsystem, MemUsage* usage);
+
+// Starts new high-water marks from what is alive now
+void reset_mem_peaks(void);
+
+void print_mem_usage_json(FILE* output, int indent);
+
+/* Writes a line for each subsystem that still has something alive and
+   returns how many did; called once everything should have been freed. */
+int report_mem_leaks(FILE* output, const char* when);
+
+#endif
@@ -1,52 +1,179 @@
 #include "ast.h"
+#include "cfg.h"
+#include "dependence.h"
+#include "incremental.h"
+#include "memtrack.h"
+#include "visitor.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
 
 
-ASTNode* deep_copy_ast(ASTNode* node) {
+static uint64_t pass_nanos[OPT_PASS_COUNT];
+static uint64_t optimize_nanos;
+static unsigned long folded_nodes;
+static unsigned long eliminated_nodes;
+static unsigned long unrolled_loops;
+static unsigned long copied_nodes;
+
+
+static uint64_t now_nanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+
+// Charges the time since `start` to `pass` and returns the current time
+static uint64_t pass_done(OptPass pass, uint64_t start) {
+    uint64_t now = now_nanos();
+    __atomic_fetch_add(&pass_nanos[pass], now - start, __ATOMIC_RELAXED);
+    return now;
+}
+
+
+static void add_count(unsigned long* counter, unsigned long amount) {
+    __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+}
+
+
+static unsigned long read_count(unsigned long* counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+
+void reset_opt_stats(void) {
+    for (int pass = 0; pass < OPT_PASS_COUNT; pass++) {
+        __atomic_store_n(&pass_nanos[pass], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&optimize_nanos, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&folded_nodes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&eliminated_nodes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&unrolled_loops, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&copied_nodes, 0, __ATOMIC_RELAXED);
+}
+
+
+void get_opt_stats(OptStats* stats) {
+    stats->seconds = __atomic_load_n(&optimize_nanos, __ATOMIC_RELAXED) * 1e-9;
+    for (int pass = 0; pass < OPT_PASS_COUNT; pass++) {
+        stats->pass_seconds[pass] = __atomic_load_n(&pass_nanos[pass], __ATOMIC_RELAXED) * 1e-9;
+    }
+    stats->folded = read_count(&folded_nodes);
+    stats->eliminated = read_count(&eliminated_nodes);
+    stats->unrolled = read_count(&unrolled_loops);
+    stats->copied = read_count(&copied_nodes);
+    MemUsage memory;
+    get_mem_usage(MEM_TOTAL, &memory);
+    stats->peak_nodes = memory.peak_nodes;
+}
+
+
+void print_opt_stats_json(const OptStats* stats, FILE* output, int indent) {
+    fprintf(output, "{\n");
+    fprintf(output, "%*s  \"seconds\": %.9f,\n", indent, "", stats->seconds);
+    fprintf(output, "%*s  \"pass_seconds\": {", indent, "");
+    for (int pass = PASS_PARSE + 1; pass < OPT_PASS_COUNT; pass++) {
+        fprintf(output, "%s\"%s\": %.9f", pass > PASS_PARSE + 1 ? ", " : "",
+                get_pass_str((OptPass)pass), stats->pass_seconds[pass]);
+    }
+    fprintf(output, "},\n");
+    fprintf(output, "%*s  \"folded\": %lu,\n", indent, "", stats->folded);
+    fprintf(output, "%*s  \"eliminated\": %lu,\n", indent, "", stats->eliminated);
+    fprintf(output, "%*s  \"unrolled\": %lu,\n", indent, "", stats->unrolled);
+    fprintf(output, "%*s  \"copied\": %lu,\n", indent, "", stats->copied);
+    fprintf(output, "%*s  \"peak_nodes\": %ld\n", indent, "", stats->peak_nodes);
+    fprintf(output, "%*s}", indent, "");
+}
+
+
+static int count_nodes(ASTNode* node) {
+    if (!node) return 0;
+    int count = 1 + count_nodes(node->next);
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        count += count_nodes(node->child[i]);
+    }
+    return count;
+}
+
+
+// Frees a statement the program can do without
+static void eliminate(ASTNode* node) {
+    add_count(&eliminated_nodes, count_nodes(node));
+    free_ast(node);
+}
+
+
+static ASTNode* copy_tree(ASTNode* node, unsigned long* count) {
     if (!node) return NULL;
 
-    ASTNode* copy = create_node(node->type, node->value);
-    copy->left = deep_copy_ast(node->left);
-    copy->right = deep_copy_ast(node->right);
-    copy->next = deep_copy_ast(node->next);
+    ASTNode* copy = derive_node(create_node(node->type, node->value), node, node->pass);
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        copy->child[i] = copy_tree(node->child[i], count);
+    }
+    copy->next = copy_tree(node->next, count);
+    (*count)++;
+    return copy;
+}
+
+
+ASTNode* deep_copy_ast(ASTNode* node) {
+    unsigned long count = 0;
+    ASTNode* copy = copy_tree(node, &count);
+    add_count(&copied_nodes, count);
     return copy;
 }
 
 
+/* Shared by the AST folders and the IR. Arithmetic wraps like the
+   -fwrapv code it is compared against; a division that would trap is left
+   for run time. */
+bool eval_binop(const char* op, int left, int right, int* result) {
+    unsigned int l = (unsigned int)left;
+    unsigned int r = (unsigned int)right;
+
+    if (strcmp(op, "+") == 0) *result = (int)(l + r);
+    else if (strcmp(op, "-") == 0) *result = (int)(l - r);
+    else if (strcmp(op, "*") == 0) *result = (int)(l * r);
+    else if (strcmp(op, "/") == 0) {
+        if (right == 0 || (left == INT_MIN && right == -1)) return false;
+        *result = left / right;
+    }
+    else if (strcmp(op, "<") == 0) *result = left < right;
+    else if (strcmp(op, "<=") == 0) *result = left <= right;
+    else if (strcmp(op, ">") == 0) *result = left > right;
+    else if (strcmp(op, ">=") == 0) *result = left >= right;
+    else if (strcmp(op, "==") == 0) *result = left == right;
+    else if (strcmp(op, "!=") == 0) *result = left != right;
+    else return false;
+    return true;
+}
+
+
 ASTNode* fold_constants(ASTNode* node) {
     if (!node) return NULL;
 
-    node->left = fold_constants(node->left);
-    node->right = fold_constants(node->right);
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        node->child[i] = fold_constants(node->child[i]);
+    }
     node->next = fold_constants(node->next);
 
     if (node->type == NODE_BINOP && node->left && node->right &&
         node->left->type == NODE_INT && node->right->type == NODE_INT) {
 
-        int left_val = atoi(node->left->value);
-        int right_val = atoi(node->right->value);
-        int result = 0;
-        char op = node->value[0];
-
-        switch (op) {
-            case '+': result = left_val + right_val; break;
-            case '-': result = left_val - right_val; break;
-            case '*': result = left_val * right_val; break;
-            case '/': 
-                if (right_val != 0)
-                    result = left_val / right_val; 
-                else 
-                    return node; 
-                break;
-            case '<': result = left_val < right_val; break;
-            default: return node;
+        int result;
+        if (!eval_binop(node->value, atoi(node->left->value), atoi(node->right->value), &result)) {
+            return node;
         }
 
-        ASTNode* folded = make_int_node(result);
+        ASTNode* folded = derive_node(make_int_node(result), node, PASS_FOLD);
         free_ast(node);
+        add_count(&folded_nodes, 1);
         return folded;
     }
 
@@ -54,76 +181,1651 @@ ASTNode* fold_constants(ASTNode* node) {
 }
 
 
-ASTNode* eliminate_dead_code(ASTNode* node) {
+// Whether the statements declare a variable in their own scope
+static bool declares_in_scope(ASTNode* stmts) {
+    if (!stmts) return false;
+    if (stmts->type == NODE_SEQ) {
+        return declares_in_scope(stmts->left) || declares_in_scope(stmts->right);
+    }
+    return stmts->type == NODE_DECL;
+}
+
+
+static ASTNode* remove_constant_ifs(ASTNode* node) {
     if (!node) return NULL;
      if (node->type == NODE_IF &&
         node->left && node->left->type == NODE_INT &&
         strcmp(node->left->value, "0") == 0) {
-        free_ast(node);
+        eliminate(node);
 
         return NULL;
     }
+    /* Any other constant condition always holds. A body declaring
+       variables keeps its block, or its names could clash with the ones
+       around it. */
+    if (node->type == NODE_IF && node->left && node->left->type == NODE_INT &&
+        !declares_in_scope(node->right)) {
+        ASTNode* body = remove_constant_ifs(node->right);
+        node->right = NULL;
+        if (body) {
+            body->next = node->next;
+            node->next = NULL;
+        } else {
+            body = node->next;
+            node->next = NULL;
+        }
+        eliminate(node);
+        return body;
+    }
     if (node->type == NODE_SEQ) {
-        node->left = eliminate_dead_code(node->left);
+        node->left = remove_constant_ifs(node->left);
+        node->right = remove_constant_ifs(node->right);
 
-        if (node->left && node->left->type == NODE_RETURN) {
-            free_ast(node->right);
+        // Collapse sequences that lost one side
+        if (!node->left || !node->right) {
+            ASTNode* rest = node->left ? node->left : node->right;
+            node->left = NULL;
             node->right = NULL;
-        } else {
-            node->right = eliminate_dead_code(node->right);
+            free_ast(node);
+            return rest;
         }
     } else {
-        node->left = eliminate_dead_code(node->left);
-        node->right = eliminate_dead_code(node->right);
-        node->next = eliminate_dead_code(node->next);
+        for (int i = 0; i < ast_slot_count(node->type); i++) {
+            node->child[i] = remove_constant_ifs(node->child[i]);
+        }
+        node->next = remove_constant_ifs(node->next);
     }
 
     return node;
 }
 
 
-ASTNode* unroll_loops(ASTNode* node) {
+/* Drops every statement the function's CFG cannot reach: code after a
+   return at any depth, after a loop that never exits, and the bodies of
+   loops whose condition is constantly false. */
+static ASTNode* drop_unreachable(ASTNode* node, CFG* cfg) {
     if (!node) return NULL;
 
-    node->left = unroll_loops(node->left);
-    node->right = unroll_loops(node->right);
-    node->next = unroll_loops(node->next);
+    if (node->type == NODE_SEQ) {
+        node->left = drop_unreachable(node->left, cfg);
+        node->right = drop_unreachable(node->right, cfg);
+        if (!node->left || !node->right) {
+            ASTNode* rest = node->left ? node->left : node->right;
+            node->left = NULL;
+            node->right = NULL;
+            free_ast(node);
+            return rest;
+        }
+        return node;
+    }
+
+    node->next = drop_unreachable(node->next, cfg);
+    if (cfg_node(cfg, node) >= 0 && !cfg_reachable(cfg, node)) {
+        ASTNode* next = node->next;
+        node->next = NULL;
+        eliminate(node);
+        return next;
+    }
+
+    if (node->type == NODE_IF) {
+        node->right = drop_unreachable(node->right, cfg);
+    } else if (node->type == NODE_FOR) {
+        node->child[FOR_BODY] = drop_unreachable(node->child[FOR_BODY], cfg);
+    }
+    return node;
+}
+
+
+ASTNode* eliminate_dead_code(ASTNode* node) {
+    node = remove_constant_ifs(node);
+    if (!node || node->type != NODE_FUNC_DEF) return node;
+
+    CFG* cfg = build_cfg(node);
+    node->left = drop_unreachable(node->left, cfg);
+    free_cfg(cfg);
+    return node;
+}
+
+
+/* Per-function variable facts, keyed by name. The table keeps its own copy
+   of each name so passes may free nodes while still consulting it; `decl`
+   is only valid until that declaration is dropped. */
+typedef struct {
+    const char* name;
+    int decls;
+    int mentions;       // declarations, parameters, reads and writes
+    bool written;
+    bool param;
+    ASTNode* decl;
+} VarInfo;
+
+typedef struct {
+    VarInfo* slots;
+    int capacity;
+    int count;
+} VarTable;
+
+
+static unsigned long hash_name(const char* name) {
+    unsigned long h = 5381;
+    while (*name) {
+        h = h * 33 + (unsigned char)*name++;
+    }
+    return h;
+}
+
+
+static VarInfo* var_lookup(VarTable* table, const char* name, bool create) {
+    if (create && (table->count + 1) * 2 > table->capacity) {
+        VarTable grown = {0};
+        grown.capacity = table->capacity ? table->capacity * 2 : 32;
+        grown.slots = (VarInfo*)calloc(grown.capacity, sizeof(VarInfo));
+        if (!grown.slots) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        for (int i = 0; i < table->capacity; i++) {
+            if (table->slots[i].name) {
+                int j = (int)(hash_name(table->slots[i].name) & (grown.capacity - 1));
+                while (grown.slots[j].name) j = (j + 1) & (grown.capacity - 1);
+                grown.slots[j] = table->slots[i];
+                grown.count++;
+            }
+        }
+        free(table->slots);
+        *table = grown;
+    }
+    if (!table->capacity) return NULL;
+
+    int mask = table->capacity - 1;
+    for (int i = (int)(hash_name(name) & mask); ; i = (i + 1) & mask) {
+        VarInfo* info = &table->slots[i];
+        if (!info->name) {
+            if (!create) return NULL;
+            info->name = strdup(name);
+            if (!info->name) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            table->count++;
+            return info;
+        }
+        if (strcmp(info->name, name) == 0) return info;
+    }
+}
+
+
+static void free_var_table(VarTable* table) {
+    for (int i = 0; i < table->capacity; i++) {
+        free((char*)table->slots[i].name);
+    }
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+
+static void scan_vars(ASTNode* node, VarTable* vars) {
+    if (!node) return;
+
+    if (node->value) {
+        if (node->type == NODE_DECL) {
+            VarInfo* info = var_lookup(vars, node->value, true);
+            info->decls++;
+            info->mentions++;
+            info->decl = node;
+        } else if (node->type == NODE_PARAM) {
+            VarInfo* info = var_lookup(vars, node->value, true);
+            info->param = true;
+            info->mentions++;
+        } else if (node->type == NODE_VAR) {
+            var_lookup(vars, node->value, true)->mentions++;
+        }
+    }
+    if (node->type == NODE_UNARY && node->left && node->left->type == NODE_VAR) {
+        var_lookup(vars, node->left->value, true)->written = true;
+    }
+    if (node->type == NODE_ASSIGN) {
+        VarInfo* info = var_lookup(vars, node->value, true);
+        info->written = true;
+        info->mentions++;
+    }
+
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        scan_vars(node->child[i], vars);
+    }
+    scan_vars(node->next, vars);
+}
+
+
+static void collect_names(ASTNode* node, VarTable* names) {
+    if (!node) return;
+    if (node->value && (node->type == NODE_VAR || node->type == NODE_DECL ||
+                        node->type == NODE_PARAM || node->type == NODE_ASSIGN)) {
+        var_lookup(names, node->value, true);
+    }
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        collect_names(node->child[i], names);
+    }
+    collect_names(node->next, names);
+}
+
 
-    if (node->type == NODE_FOR && node->left && node->right) {
-        ASTNode* init = node->left;
-        ASTNode* cond = node->right;
-        ASTNode* update = cond->next;
-        ASTNode* body = update ? update->next : NULL;
+/* Returns a copy of `name` with a tag and counter appended that no other
+   variable in `names` uses, and reserves it there. */
+static char* fresh_name(VarTable* names, const char* name, const char* tag, int* counter) {
+    char buffer[256];
+    do {
+        snprintf(buffer, sizeof(buffer), "%s_%s%d", name, tag, ++*counter);
+    } while (var_lookup(names, buffer, false));
+    var_lookup(names, buffer, true);
 
-        if (!init || !cond || !update || !body) return node;
+    char* copy = strdup(buffer);
+    if (!copy) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return copy;
+}
 
-        if (init->left && init->left->type == NODE_INT &&
-            cond->right && cond->right->type == NODE_INT &&
-            strcmp(update->value, "++") == 0) {
 
-            int start = atoi(init->left->value);
-            int end = atoi(cond->right->value);
+static void rename_vars(ASTNode* node, char** from, char** to, int count) {
+    if (!node) return;
 
-            ASTNode* unrolled = NULL;
-            for (int i = start; i < end; i++) {
-                ASTNode* cloned = deep_copy_ast(body);
-                if (unrolled)
-                    unrolled = make_seq_node(unrolled, cloned);
-                else
-                    unrolled = cloned;
+    if (node->value && (node->type == NODE_VAR || node->type == NODE_DECL ||
+                        node->type == NODE_ASSIGN)) {
+        for (int i = 0; i < count; i++) {
+            if (strcmp(node->value, from[i]) == 0) {
+                ast_set_value(node, to[i]);
+                break;
             }
+        }
+    }
+
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        rename_vars(node->child[i], from, to, count);
+    }
+    rename_vars(node->next, from, to, count);
+}
+
+
+static bool has_side_effects(ASTNode* node) {
+    if (!node) return false;
+    if (node->type == NODE_FUNC_CALL || node->type == NODE_UNARY ||
+        node->type == NODE_ASSIGN) return true;
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        if (has_side_effects(node->child[i])) return true;
+    }
+    return has_side_effects(node->next);
+}
+
 
+static ASTNode* constant_value(VarTable* vars, const char* name) {
+    VarInfo* info = var_lookup(vars, name, false);
+    if (!info || info->decls != 1 || info->written || info->param) return NULL;
+    ASTNode* init = info->decl->left;
+    return init && init->type == NODE_INT ? init : NULL;
+}
+
+
+static ASTNode* replace_constant_uses(ASTNode* node, VarTable* vars, bool* changed) {
+    if (!node) return NULL;
+
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        node->child[i] = replace_constant_uses(node->child[i], vars, changed);
+    }
+    node->next = replace_constant_uses(node->next, vars, changed);
+
+    if (node->type == NODE_VAR) {
+        ASTNode* value = constant_value(vars, node->value);
+        if (value) {
+            ASTNode* replacement = derive_node(create_node(NODE_INT, value->value), node, PASS_PROPAGATE);
+            replacement->next = node->next;
+            node->next = NULL;
             free_ast(node);
-            return unrolled;
+            *changed = true;
+            return replacement;
         }
     }
+    return node;
+}
+
+
+static ASTNode* drop_constant_decls(ASTNode* node, VarTable* vars, bool* changed) {
+    if (!node) return NULL;
+
+    if (node->type == NODE_DECL && constant_value(vars, node->value)) {
+        ASTNode* rest = node->next;
+        node->next = NULL;
+        eliminate(node);
+        *changed = true;
+        return drop_constant_decls(rest, vars, changed);
+    }
 
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        node->child[i] = drop_constant_decls(node->child[i], vars, changed);
+    }
+    node->next = drop_constant_decls(node->next, vars, changed);
     return node;
 }
 
-ASTNode* optimize_ast(ASTNode* root) {
-    root = fold_constants(root);
-    root = eliminate_dead_code(root);
-    root = unroll_loops(root);
+
+/* Variables declared once with a constant initializer and never written
+   afterwards are replaced by their value, and their declarations dropped.
+   Returns whether anything changed so the caller can fold again. */
+bool propagate_constants(ASTNode* root) {
+    if (!root || root->type != NODE_FUNC_DEF) return false;
+
+    VarTable vars = {0};
+    scan_vars(root, &vars);
+
+    bool changed = false;
+    root->left = replace_constant_uses(root->left, &vars, &changed);
+    root->left = drop_constant_decls(root->left, &vars, &changed);
+
+    free_var_table(&vars);
+    return changed;
+}
+
+
+static ASTNode* append_to(ASTNode* list, ASTNode* stmt) {
+    if (!list) return stmt;
+    if (!stmt) return list;
+    return make_seq_node(list, stmt);
+}
+
+
+/* A basic induction variable: initialized to a constant, stepped by a
+   constant in the update and compared against a constant bound. */
+#define MAX_UNROLL_TRIPS 32
+
+typedef struct {
+    const char* name;
+    int start;
+    int step;
+    int trips;
+} InductionVar;
+
+
+static bool is_var(ASTNode* node, const char* name) {
+    return node && node->type == NODE_VAR && (!name || strcmp(node->value, name) == 0);
+}
+
+
+static bool is_int(ASTNode* node) {
+    return node && node->type == NODE_INT;
+}
+
+
+static const char* mirror_comparison(const char* op) {
+    if (strcmp(op, "<") == 0) return ">";
+    if (strcmp(op, "<=") == 0) return ">=";
+    if (strcmp(op, ">") == 0) return "<";
+    if (strcmp(op, ">=") == 0) return "<=";
+    return op;
+}
+
+
+/* Exact trip count of `for (i = start; i op bound; i += step)`, or -1 when
+   the loop does not terminate or would overflow the variable. Negative
+   steps are handled by negating the whole iteration space. */
+static long long trip_count(long long start, const char* op, long long bound, long long step) {
+    if (step < 0) {
+        start = -start;
+        bound = -bound;
+        step = -step;
+        op = mirror_comparison(op);
+    }
+
+    long long trips;
+    if (strcmp(op, "<") == 0) {
+        trips = start < bound ? (bound - start + step - 1) / step : 0;
+    } else if (strcmp(op, "<=") == 0) {
+        trips = start <= bound ? (bound - start) / step + 1 : 0;
+    } else if (strcmp(op, "!=") == 0) {
+        if (start == bound) return 0;
+        if (start > bound || (bound - start) % step != 0) return -1;
+        trips = (bound - start) / step;
+    } else if (strcmp(op, "==") == 0) {
+        trips = start == bound ? 1 : 0;
+    } else if (strcmp(op, ">") == 0 || strcmp(op, ">=") == 0) {
+        // Counting up away from the bound: never entered, or never left
+        int entered;
+        eval_binop(op, (int)start, (int)bound, &entered);
+        if (entered) return -1;
+        trips = 0;
+    } else {
+        return -1;
+    }
+
+    // Every value the variable takes, including the one that exits the loop
+    long long last = start + trips * step;
+    if (last > INT_MAX || -last > INT_MAX) return -1;
+    return trips;
+}
+
+
+/* Matches the header of a counted loop. Bounds are constants by the time
+   this runs: symbolic ones have been folded or propagated already. */
+static bool analyze_induction(ASTNode* loop, InductionVar* iv) {
+    ASTNode* init = loop->child[FOR_INIT];
+    ASTNode* cond = loop->child[FOR_COND];
+    ASTNode* update = loop->child[FOR_UPDATE];
+    ASTNode* body = loop->child[FOR_BODY];
+    if (!init || !cond || !update) return false;
+
+    if ((init->type != NODE_DECL && init->type != NODE_ASSIGN) || !is_int(init->left)) return false;
+    iv->name = init->value;
+    iv->start = atoi(init->left->value);
+
+    if (!induction_step(update, iv->name, &iv->step)) return false;
+
+    if (cond->type != NODE_BINOP) return false;
+    const char* op;
+    ASTNode* bound;
+    if (is_var(cond->left, iv->name) && is_int(cond->right)) {
+        op = cond->value;
+        bound = cond->right;
+    } else if (is_int(cond->left) && is_var(cond->right, iv->name)) {
+        op = mirror_comparison(cond->value);
+        bound = cond->left;
+    } else {
+        return false;
+    }
+
+    if (changes_var(def_use(body), iv->name)) return false;
+
+    long long trips = trip_count(iv->start, op, atoi(bound->value), iv->step);
+    if (trips < 0) return false;
+    iv->trips = (int)trips;
+    return true;
+}
+
+
+typedef struct {
+    VarTable names;     // every name in the function being unrolled
+    int counter;
+} UnrollContext;
+
+
+static ASTNode* substitute_var(ASTNode* node, const char* name, int value) {
+    if (!node) return NULL;
+
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        node->child[i] = substitute_var(node->child[i], name, value);
+    }
+    node->next = substitute_var(node->next, name, value);
+
+    if (is_var(node, name)) {
+        ASTNode* constant = derive_node(make_int_node(value), node, PASS_UNROLL);
+        constant->next = node->next;
+        node->next = NULL;
+        free_ast(node);
+        return constant;
+    }
+    return node;
+}
+
+
+/* Clones end up side by side in one scope, so variables the body declares
+   at its top level get a fresh name in every copy. */
+/* Renames `from` in the statements of `body` starting at `decl`; the ones
+   before it still see the variable the declaration shadows. Returns true
+   once `decl` has been reached. */
+static bool rename_from_decl(ASTNode* body, ASTNode* decl, char* from, char* to, bool active) {
+    if (!body) return active;
+
+    if (body->type == NODE_SEQ) {
+        active = rename_from_decl(body->left, decl, from, to, active);
+        return rename_from_decl(body->right, decl, from, to, active);
+    }
+    if (body == decl) active = true;
+    if (active) rename_vars(body, &from, &to, 1);
+    return active;
+}
+
+
+static void rename_body_decls(ASTNode* stmt, ASTNode* clone, UnrollContext* ctx) {
+    if (!stmt) return;
+
+    if (stmt->type == NODE_SEQ) {
+        rename_body_decls(stmt->left, clone, ctx);
+        rename_body_decls(stmt->right, clone, ctx);
+    } else if (stmt->type == NODE_DECL) {
+        // The declaration itself is renamed too, so keep the old name aside
+        char* from = strdup(stmt->value);
+        char* to = fresh_name(&ctx->names, from, "u", &ctx->counter);
+        rename_from_decl(clone, stmt, from, to, false);
+        free(from);
+        free(to);
+    }
+}
+
+
+/* Each copy of the body gets the induction variable replaced by its value
+   in that iteration and is folded on its own, so index arithmetic turns
+   into constants. */
+static ASTNode* unroll_loop(ASTNode* node, void* data) {
+    UnrollContext* ctx = (UnrollContext*)data;
+    InductionVar iv;
+    if (!analyze_induction(node, &iv) || iv.trips > MAX_UNROLL_TRIPS) return node;
+
+    ASTNode* body = node->child[FOR_BODY];
+    ASTNode* unrolled = NULL;
+    int value = iv.start;
+    for (int i = 0; i < iv.trips && body; i++, value += iv.step) {
+        ASTNode* cloned = deep_copy_ast(body);
+        derive_tree(cloned, PASS_UNROLL);
+        rename_body_decls(cloned, cloned, ctx);
+        cloned = fold_constants(substitute_var(cloned, iv.name, value));
+        if (unrolled)
+            unrolled = derive_node(make_seq_node(unrolled, cloned), node, PASS_UNROLL);
+        else
+            unrolled = cloned;
+    }
+
+    /* A variable declared outside the loop must still hold its exit value,
+       even when the body is gone; trip_count() checked it fits an int. */
+    ASTNode* init = node->child[FOR_INIT];
+    if (init->type == NODE_ASSIGN) {
+        int last = (int)(iv.start + (long long)iv.trips * iv.step);
+        ASTNode* exit_value = make_assign_node(init->value, make_int_node(last));
+        derive_node(exit_value, init, PASS_UNROLL);
+        derive_node(exit_value->left, init->left, PASS_UNROLL);
+        unrolled = append_to(unrolled, exit_value);
+    }
+
+    free_ast(node);
+    add_count(&unrolled_loops, 1);
+    return unrolled;
+}
+
+
+ASTNode* unroll_loops(ASTNode* root) {
+    if (!ast_may_contain(root, NODE_FOR)) return root;
+
+    UnrollContext ctx = { {0}, 0 };
+    collect_names(root, &ctx.names);
+    Rewriter rewriter = { .post[NODE_FOR] = unroll_loop, .data = &ctx };
+    root = rewrite_ast(root, &rewriter);
+    free_var_table(&ctx.names);
     return root;
 }
+
+/* Loop-invariant code motion for the loops left after unrolling. Anything
+   built only from names the loop does not change is invariant. Every
+   rewrite invalidates the dependence cache, so the loop's def/use sets
+   always reflect what is still inside it. */
+typedef struct {
+    VarTable vars;      // declarations across the whole function
+    int counter;
+} HoistContext;
+
+
+static bool is_loop_invariant(ASTNode* node, ASTNode* loop) {
+    if (!node) return true;
+
+    switch (node->type) {
+        case NODE_INT:
+        case NODE_STRING:
+            return true;
+        case NODE_VAR:
+            return !changes_var(def_use(loop), node->value);
+        case NODE_BINOP:
+            // Hoisted code runs even when the loop does not, so never divide
+            if (strcmp(node->value, "/") == 0) return false;
+            return is_loop_invariant(node->left, loop) && is_loop_invariant(node->right, loop);
+        default:
+            return false;
+    }
+}
+
+
+static ASTNode* hoist_expr(ASTNode* node, ASTNode* loop, ASTNode** prelude, HoistContext* ctx) {
+    if (!node) return NULL;
+
+    // Constant-only expressions are left to folding
+    if (node->type == NODE_BINOP && def_use(node)->reads.count > 0 && is_loop_invariant(node, loop)) {
+        char name[32];
+        do {
+            snprintf(name, sizeof(name), "licm%d", ctx->counter++);
+        } while (var_lookup(&ctx->vars, name, false));
+        // Declared in the prelude and read where the expression was
+        VarInfo* info = var_lookup(&ctx->vars, name, true);
+        info->decls++;
+        info->mentions += 2;
+
+        ASTNode* next = node->next;
+        node->next = NULL;
+        *prelude = append_to(*prelude, derive_node(make_decl_node(name, node), node, PASS_LICM));
+
+        ASTNode* use = derive_node(make_var_node(name), node, PASS_LICM);
+        use->next = next;
+        dependence_invalidate();
+        return use;
+    }
+
+    node->left = hoist_expr(node->left, loop, prelude, ctx);
+    node->right = hoist_expr(node->right, loop, prelude, ctx);
+    if (node->type == NODE_EXPR_LIST) {
+        node->next = hoist_expr(node->next, loop, prelude, ctx);
+    }
+    return node;
+}
+
+
+/* Walks the statements of a loop body, pulling invariant subexpressions
+   out. Nested loops were already handled, so only their headers and
+   anything they left behind are visited. */
+static void hoist_from_stmt(ASTNode* node, ASTNode* loop, ASTNode** prelude, HoistContext* ctx) {
+    if (!node) return;
+
+    switch (node->type) {
+        case NODE_SEQ:
+            hoist_from_stmt(node->left, loop, prelude, ctx);
+            hoist_from_stmt(node->right, loop, prelude, ctx);
+            break;
+
+        case NODE_IF:
+            node->left = hoist_expr(node->left, loop, prelude, ctx);
+            hoist_from_stmt(node->right, loop, prelude, ctx);
+            break;
+
+        case NODE_FOR: {
+            ASTNode* init = node->child[FOR_INIT];
+            if (init && init->type == NODE_DECL) {
+                init->left = hoist_expr(init->left, loop, prelude, ctx);
+            }
+            node->child[FOR_COND] = hoist_expr(node->child[FOR_COND], loop, prelude, ctx);
+            hoist_from_stmt(node->child[FOR_BODY], loop, prelude, ctx);
+            break;
+        }
+
+        case NODE_DECL:
+        case NODE_ASSIGN:
+        case NODE_RETURN:
+            node->left = hoist_expr(node->left, loop, prelude, ctx);
+            break;
+
+        case NODE_FUNC_CALL:
+            node->left = hoist_expr(node->left, loop, prelude, ctx);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static int count_mentions(ASTNode* node, const char* name) {
+    if (!node) return 0;
+    int count = node->value && strcmp(node->value, name) == 0 &&
+                (node->type == NODE_VAR || node->type == NODE_DECL || node->type == NODE_ASSIGN);
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        count += count_mentions(node->child[i], name);
+    }
+    return count + count_mentions(node->next, name);
+}
+
+
+/* Top-level declarations of the body move out whole when their initializer
+   is invariant and the name appears nowhere outside the loop: hoisted, it
+   would clash with a parameter or another declaration, or change what a
+   later use of the name refers to. LICM only moves nodes around, so the
+   counts taken before it started still hold. */
+static ASTNode* hoist_decls(ASTNode* node, ASTNode* loop, ASTNode** prelude, HoistContext* ctx) {
+    if (!node) return NULL;
+
+    if (node->type == NODE_SEQ) {
+        node->left = hoist_decls(node->left, loop, prelude, ctx);
+        node->right = hoist_decls(node->right, loop, prelude, ctx);
+        if (!node->left || !node->right) {
+            ASTNode* rest = node->left ? node->left : node->right;
+            node->left = node->right = NULL;
+            free_ast(node);
+            dependence_invalidate();
+            return rest;
+        }
+        return node;
+    }
+
+    if (node->type == NODE_DECL && node->left && is_loop_invariant(node->left, loop)) {
+        VarInfo* decl = var_lookup(&ctx->vars, node->value, false);
+        if (decl && decl->decls == 1 && !decl->param && !name_set_has(&def_use(loop)->writes, node->value) &&
+            count_mentions(loop, node->value) == decl->mentions) {
+            derive_node(node, node, PASS_LICM);
+            *prelude = append_to(*prelude, node);
+            dependence_invalidate();
+            return NULL;
+        }
+    }
+    return node;
+}
+
+
+static ASTNode* hoist_loop(ASTNode* node, void* data) {
+    HoistContext* ctx = (HoistContext*)data;
+    if (!node->child[FOR_COND] || !node->child[FOR_UPDATE]) return node;
+
+    ASTNode* prelude = NULL;
+    node->child[FOR_BODY] = hoist_decls(node->child[FOR_BODY], node, &prelude, ctx);
+    node->child[FOR_COND] = hoist_expr(node->child[FOR_COND], node, &prelude, ctx);
+    hoist_from_stmt(node->child[FOR_BODY], node, &prelude, ctx);
+
+    if (!prelude) return node;
+
+    // Uses of the hoisted values are new variables deep in the loop
+    ast_update_kinds(node);
+    dependence_invalidate();
+    return derive_node(make_seq_node(prelude, node), node, PASS_LICM);
+}
+
+
+ASTNode* hoist_loop_invariants(ASTNode* root) {
+    if (!root || root->type != NODE_FUNC_DEF || !ast_may_contain(root, NODE_FOR)) return root;
+
+    HoistContext ctx = { {0}, 0 };
+    scan_vars(root, &ctx.vars);
+    dependence_invalidate();
+    Rewriter rewriter = { .post[NODE_FOR] = hoist_loop, .data = &ctx };
+    root = rewrite_ast(root, &rewriter);
+    free_var_table(&ctx.vars);
+    return root;
+}
+
+
+/* Loop fusion and fission. Bodies only share scalars, so the def/use sets
+   of two pieces of code tell whether they may be reordered. */
+
+
+// Structural equality of two expressions, ignoring their `next` links.
+static bool same_expr(ASTNode* a, ASTNode* b) {
+    if (!a || !b) return a == b;
+    if (a->type != b->type) return false;
+    if ((a->value || b->value) && (!a->value || !b->value || strcmp(a->value, b->value) != 0)) return false;
+    return same_expr(a->left, b->left) && same_expr(a->right, b->right);
+}
+
+
+/* A loop can be split or merged when its header runs the same way no
+   matter what the body does: no calls in it, and nothing it reads is
+   changed by the body. */
+static bool has_movable_header(ASTNode* loop) {
+    ASTNode* init = loop->child[FOR_INIT];
+    if (!init || !loop->child[FOR_COND] || !loop->child[FOR_UPDATE] || !loop->child[FOR_BODY]) return false;
+
+    const DefUse* body = def_use(loop->child[FOR_BODY]);
+    if (body->returns) return false;
+    if (init->value && changes_var(body, init->value)) return false;
+
+    ASTNode* header[3] = { init, loop->child[FOR_COND], loop->child[FOR_UPDATE] };
+    for (int i = 0; i < 3; i++) {
+        const DefUse* part = def_use(header[i]);
+        if (part->calls || name_sets_overlap(&body->writes, &part->reads) ||
+            name_sets_overlap(&body->decls, &part->reads)) return false;
+    }
+    return true;
+}
+
+
+static bool same_header(ASTNode* a, ASTNode* b) {
+    ASTNode* init_a = a->child[FOR_INIT];
+    ASTNode* init_b = b->child[FOR_INIT];
+    if (init_a->type != init_b->type || strcmp(init_a->value, init_b->value) != 0) return false;
+    return same_expr(init_a->left, init_b->left) &&
+           same_expr(a->child[FOR_COND], b->child[FOR_COND]) &&
+           same_expr(a->child[FOR_UPDATE], b->child[FOR_UPDATE]);
+}
+
+
+// First and last statements of a sequence, at any nesting.
+static ASTNode* first_stmt(ASTNode* node) {
+    while (node && node->type == NODE_SEQ) node = node->left;
+    return node;
+}
+
+
+static ASTNode* last_stmt(ASTNode* node) {
+    while (node && node->type == NODE_SEQ) node = node->right;
+    return node;
+}
+
+
+// Unlinks the first statement of a sequence and returns what remains.
+static ASTNode* detach_first_stmt(ASTNode* node) {
+    if (node->type != NODE_SEQ) return NULL;
+
+    node->left = detach_first_stmt(node->left);
+    if (node->left) return node;
+
+    ASTNode* rest = node->right;
+    rest->next = node->next;
+    node->right = node->next = NULL;
+    free_ast(node);
+    return rest;
+}
+
+
+/* Merges `second` into `first` when both run the same iterations, neither
+   body calls anything and the bodies touch disjoint variables. */
+static bool fuse_loops(ASTNode* first, ASTNode* second) {
+    if (first->type != NODE_FOR || second->type != NODE_FOR) return false;
+
+    ASTNode* body_a = first->child[FOR_BODY];
+    ASTNode* body_b = second->child[FOR_BODY];
+    if (!body_a || !body_b) return false;
+
+    const DefUse* a = def_use(body_a);
+    const DefUse* b = def_use(body_b);
+    if (a->calls || b->calls || !independent(a, b)) return false;
+    if (!has_movable_header(first) || !has_movable_header(second) || !same_header(first, second)) return false;
+
+    first->child[FOR_BODY] = derive_node(make_seq_node(body_a, body_b), second, PASS_FUSION);
+    second->child[FOR_BODY] = NULL;
+    derive_node(first, first, PASS_FUSION);
+    dependence_invalidate();
+    return true;
+}
+
+
+static ASTNode* fuse_adjacent_loops(ASTNode* node, void* data) {
+    (void)data;
+    if (!node->left || !node->right) return node;
+
+    ASTNode* second = first_stmt(node->right);
+    if (!fuse_loops(last_stmt(node->left), second)) return node;
+
+    node->right = detach_first_stmt(node->right);
+    free_ast(second);
+    if (!node->right) {
+        ASTNode* rest = node->left;
+        node->left = NULL;
+        free_ast(node);
+        node = rest;
+    }
+    // The first loop's body took in the second's
+    ast_update_kinds(node);
+    return node;
+}
+
+
+static int count_stmts(ASTNode* node) {
+    if (!node) return 0;
+    if (node->type == NODE_SEQ) return count_stmts(node->left) + count_stmts(node->right);
+    return 1;
+}
+
+
+// Moves the statements of a sequence into `stmts` and frees the sequence.
+static void take_stmts(ASTNode* node, ASTNode** stmts, int* count) {
+    if (!node) return;
+    if (node->type == NODE_SEQ) {
+        take_stmts(node->left, stmts, count);
+        take_stmts(node->right, stmts, count);
+        node->left = node->right = NULL;
+        free_ast(node);
+        return;
+    }
+    stmts[(*count)++] = node;
+}
+
+
+static int find_group(int* group, int i) {
+    while (group[i] != i) {
+        group[i] = group[group[i]];
+        i = group[i];
+    }
+    return i;
+}
+
+
+/* Splits a loop whose body mixes calls with independent call-free work
+   into two loops over the same range, so the call-free one can be
+   vectorized. Statements keep their order within each loop. */
+static ASTNode* split_loop(ASTNode* loop, void* data) {
+    (void)data;
+    ASTNode* body = loop->child[FOR_BODY];
+    int count = count_stmts(body);
+    if (count < 2) return loop;
+
+    if (!def_use(body)->calls || !has_movable_header(loop)) return loop;
+
+    ASTNode** stmts = (ASTNode**)malloc(count * sizeof(ASTNode*));
+    const DefUse** effects = (const DefUse**)malloc(count * sizeof(DefUse*));
+    int* group = (int*)malloc(count * sizeof(int));
+    if (!stmts || !effects || !group) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    int taken = 0;
+    loop->child[FOR_BODY] = NULL;
+    take_stmts(body, stmts, &taken);
+
+    // The statements themselves are untouched, so their cached sets hold
+    for (int i = 0; i < count; i++) {
+        effects[i] = def_use(stmts[i]);
+        group[i] = i;
+    }
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            if (!independent(effects[i], effects[j])) group[find_group(group, j)] = find_group(group, i);
+        }
+    }
+
+    // Everything tied to a call stays; the rest moves to its own loop
+    int call_group = -1;
+    for (int i = 0; i < count && call_group < 0; i++) {
+        if (effects[i]->calls) call_group = find_group(group, i);
+    }
+
+    ASTNode* kept = NULL;
+    ASTNode* moved = NULL;
+    bool moved_first = false;
+    for (int i = 0; i < count; i++) {
+        if (find_group(group, i) == call_group) {
+            kept = append_to(kept, stmts[i]);
+        } else {
+            if (!kept && !moved) moved_first = true;
+            moved = append_to(moved, stmts[i]);
+        }
+    }
+    free(stmts);
+    free(effects);
+    free(group);
+
+    loop->child[FOR_BODY] = kept;
+    dependence_invalidate();
+    if (!moved) return loop;
+
+    ASTNode* split = make_for_node(deep_copy_ast(loop->child[FOR_INIT]), deep_copy_ast(loop->child[FOR_COND]),
+                                   deep_copy_ast(loop->child[FOR_UPDATE]), moved);
+    derive_tree(split, PASS_FISSION);
+    derive_node(split, loop, PASS_FISSION);
+
+    ASTNode* result = moved_first ? make_seq_node(split, loop) : make_seq_node(loop, split);
+    return derive_node(result, loop, PASS_FISSION);
+}
+
+
+/* Fission runs first so the call-free loops it produces can be fused with
+   neighbouring call-free loops over the same range. Fusion looks at
+   sequences, but only those holding a loop. */
+ASTNode* restructure_loops(ASTNode* root) {
+    dependence_invalidate();
+    Rewriter fission = { .post[NODE_FOR] = split_loop };
+    Rewriter fusion = { .post[NODE_SEQ] = fuse_adjacent_loops, .needs = AST_KIND(NODE_FOR) };
+    uint64_t start = now_nanos();
+    root = rewrite_ast(root, &fission);
+    start = pass_done(PASS_FISSION, start);
+    root = rewrite_ast(root, &fusion);
+    pass_done(PASS_FUSION, start);
+    return root;
+}
+
+
+/* Marks innermost loops whose iterations are independent so the code
+   generator can ask for SIMD execution: every variable the loop changes
+   must be its induction variable, private to an iteration or a reduction.
+   The loop value becomes "simd" followed by one "<op>:<var>" entry per
+   reduction. */
+#define MAX_SIMD_LABEL 64
+
+static bool vectorizable_loop(ASTNode* loop, char* label) {
+    if (!loop->child[FOR_UPDATE] || !loop->child[FOR_BODY]) return false;
+
+    const DefUse* body = def_use(loop->child[FOR_BODY]);
+    if (body->calls || body->returns || body->loops || !has_movable_header(loop)) return false;
+
+    LoopDeps deps;
+    bool valid = analyze_loop(loop, &deps) && deps.induction;
+
+    strcpy(label, "simd");
+    for (int i = 0; valid && i < deps.var_count; i++) {
+        LoopVar* var = &deps.vars[i];
+        if (var->kind == LOOP_VAR_CARRIED) valid = false;
+        if (var->kind != LOOP_VAR_REDUCTION) continue;
+
+        size_t used = strlen(label);
+        valid = snprintf(label + used, MAX_SIMD_LABEL - used, " %s:%s", var->op, var->name) <
+                (int)(MAX_SIMD_LABEL - used);
+    }
+    free_loop_deps(&deps);
+    return valid;
+}
+
+
+static bool mark_simd(ASTNode* node, void* data) {
+    (void)data;
+    char label[MAX_SIMD_LABEL];
+    if (!node->value && vectorizable_loop(node, label)) {
+        ast_set_value(node, label);
+        derive_node(node, node, PASS_SIMD);
+    }
+    return true;
+}
+
+
+ASTNode* mark_simd_loops(ASTNode* root) {
+    dependence_invalidate();
+    Visitor visitor = { .post[NODE_FOR] = mark_simd };
+    visit_ast(root, &visitor);
+    return root;
+}
+
+
+/* Call graph of a translation unit: one node per FUNCTION_DEF, edges to
+   the functions it calls. Built once, before functions are optimized. */
+#define INLINE_MAX_NODES 40
+
+typedef struct {
+    ASTNode** slot;
+    int* callees;
+    int callee_count;
+    int callee_capacity;
+    int index;
+    int lowlink;
+    bool on_stack;
+    bool recursive;
+} CallNode;
+
+typedef struct {
+    CallNode* nodes;
+    int count;
+    int* by_name;       // node indices sorted by function name
+    int* order;         // callees before their callers
+    int order_count;
+    int* stack;
+    int stack_count;
+    int next_index;
+} CallGraph;
+
+
+static const char* call_node_name(CallGraph* graph, int index) {
+    return (*graph->nodes[index].slot)->value;
+}
+
+
+static CallGraph* sorting_graph;
+
+static int compare_by_name(const void* a, const void* b) {
+    return strcmp(call_node_name(sorting_graph, *(const int*)a),
+                  call_node_name(sorting_graph, *(const int*)b));
+}
+
+
+static int find_function(CallGraph* graph, const char* name) {
+    int lo = 0;
+    int hi = graph->count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(name, call_node_name(graph, graph->by_name[mid]));
+        if (cmp == 0) return graph->by_name[mid];
+        if (cmp < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return -1;
+}
+
+
+static void add_call_edges(CallGraph* graph, int caller, ASTNode* node) {
+    if (!node) return;
+
+    if (node->type == NODE_FUNC_CALL) {
+        int callee = find_function(graph, node->value);
+        CallNode* from = &graph->nodes[caller];
+        if (callee >= 0) {
+            if (from->callee_count == from->callee_capacity) {
+                from->callee_capacity = from->callee_capacity ? from->callee_capacity * 2 : 4;
+                from->callees = (int*)realloc(from->callees, from->callee_capacity * sizeof(int));
+                if (!from->callees) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    exit(1);
+                }
+            }
+            from->callees[from->callee_count++] = callee;
+            if (callee == caller) from->recursive = true;
+        }
+    }
+
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        add_call_edges(graph, caller, node->child[i]);
+    }
+    add_call_edges(graph, caller, node->next);
+}
+
+
+// Tarjan's SCC walk; components come out callees-first, and any function
+// in a component of more than one node is (mutually) recursive.
+static void visit_call_node(CallGraph* graph, int v) {
+    CallNode* node = &graph->nodes[v];
+    node->index = node->lowlink = graph->next_index++;
+    graph->stack[graph->stack_count++] = v;
+    node->on_stack = true;
+
+    for (int i = 0; i < node->callee_count; i++) {
+        int w = node->callees[i];
+        CallNode* callee = &graph->nodes[w];
+        if (callee->index < 0) {
+            visit_call_node(graph, w);
+            if (callee->lowlink < node->lowlink) node->lowlink = callee->lowlink;
+        } else if (callee->on_stack && callee->index < node->lowlink) {
+            node->lowlink = callee->index;
+        }
+    }
+
+    if (node->lowlink == node->index) {
+        int first = graph->stack_count;
+        int w;
+        do {
+            w = graph->stack[--first];
+            graph->nodes[w].on_stack = false;
+        } while (w != v);
+
+        bool cycle = graph->stack_count - first > 1;
+        for (int k = first; k < graph->stack_count; k++) {
+            int member = graph->stack[k];
+            if (cycle) graph->nodes[member].recursive = true;
+            graph->order[graph->order_count++] = member;
+        }
+        graph->stack_count = first;
+    }
+}
+
+
+static CallGraph* build_call_graph(ASTNode*** slots, int count) {
+    CallGraph* graph = (CallGraph*)calloc(1, sizeof(CallGraph));
+    if (graph) {
+        graph->nodes = (CallNode*)calloc(count, sizeof(CallNode));
+        graph->by_name = (int*)malloc(count * sizeof(int));
+        graph->order = (int*)malloc(count * sizeof(int));
+        graph->stack = (int*)malloc(count * sizeof(int));
+    }
+    if (!graph || !graph->nodes || !graph->by_name || !graph->order || !graph->stack) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    graph->count = count;
+    for (int i = 0; i < count; i++) {
+        graph->nodes[i].slot = slots[i];
+        graph->nodes[i].index = -1;
+        graph->by_name[i] = i;
+    }
+    sorting_graph = graph;
+    qsort(graph->by_name, count, sizeof(int), compare_by_name);
+
+    for (int i = 0; i < count; i++) {
+        add_call_edges(graph, i, (*slots[i])->left);
+    }
+    for (int i = 0; i < count; i++) {
+        if (graph->nodes[i].index < 0) visit_call_node(graph, i);
+    }
+    return graph;
+}
+
+
+static void free_call_graph(CallGraph* graph) {
+    for (int i = 0; i < graph->count; i++) {
+        free(graph->nodes[i].callees);
+    }
+    free(graph->nodes);
+    free(graph->by_name);
+    free(graph->order);
+    free(graph->stack);
+    free(graph);
+}
+
+
+static void collect_stmts(ASTNode* node, ASTNode** stmts, int* count, int max) {
+    if (!node) return;
+    if (node->type == NODE_SEQ) {
+        collect_stmts(node->left, stmts, count, max);
+        collect_stmts(node->right, stmts, count, max);
+        return;
+    }
+    if (*count < max) stmts[*count] = node;
+    (*count)++;
+}
+
+
+/* A callee can be inlined when it is small, not recursive, free of side
+   effects and made only of declarations followed by a single return. */
+static bool is_inlinable(CallGraph* graph, int index) {
+    ASTNode* func = *graph->nodes[index].slot;
+    if (graph->nodes[index].recursive || !func->left) return false;
+    if (count_nodes(func->left) > INLINE_MAX_NODES || has_side_effects(func->left)) return false;
+
+    ASTNode* stmts[INLINE_MAX_NODES];
+    int count = 0;
+    collect_stmts(func->left, stmts, &count, INLINE_MAX_NODES);
+    if (count == 0 || count > INLINE_MAX_NODES) return false;
+
+    for (int i = 0; i < count - 1; i++) {
+        if (stmts[i]->type != NODE_DECL || !stmts[i]->left) return false;
+    }
+    return stmts[count - 1]->type == NODE_RETURN && stmts[count - 1]->left;
+}
+
+
+typedef struct {
+    CallGraph* graph;
+    bool* inlinable;
+    VarTable names;     // names already used in the caller
+    int counter;
+} InlineContext;
+
+
+/* Replaces `call` by a renamed copy of the callee's return expression. The
+   parameter bindings and the callee's own declarations are appended to
+   `prelude`, to be placed before the statement holding the call. */
+static ASTNode* inline_call(ASTNode* call, int callee, ASTNode** prelude, InlineContext* ctx) {
+    ASTNode* func = *ctx->graph->nodes[callee].slot;
+
+    int params = 0;
+    for (ASTNode* p = func->right; p; p = p->next) params++;
+    int args = 0;
+    for (ASTNode* a = call->left; a; a = a->next) {
+        if (has_side_effects(a->left)) return call;
+        args++;
+    }
+    if (args != params) return call;
+
+    ASTNode* stmts[INLINE_MAX_NODES];
+    int count = 0;
+    collect_stmts(func->left, stmts, &count, INLINE_MAX_NODES);
+
+    int locals = params + count - 1;
+    char** from = (char**)malloc((locals + 1) * sizeof(char*));
+    char** to = (char**)malloc((locals + 1) * sizeof(char*));
+    if (!from || !to) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    int n = 0;
+    for (ASTNode* p = func->right; p; p = p->next, n++) {
+        from[n] = p->value;
+        to[n] = fresh_name(&ctx->names, p->value, "inl", &ctx->counter);
+    }
+    for (int i = 0; i < count - 1; i++, n++) {
+        from[n] = stmts[i]->value;
+        to[n] = fresh_name(&ctx->names, stmts[i]->value, "inl", &ctx->counter);
+    }
+
+    ASTNode* arg = call->left;
+    for (int i = 0; i < params; i++, arg = arg->next) {
+        ASTNode* binding = derive_node(make_decl_node(to[i], arg->left), call, PASS_INLINE);
+        arg->left = NULL;
+        *prelude = append_to(*prelude, binding);
+    }
+    for (int i = 0; i < count - 1; i++) {
+        ASTNode* decl = deep_copy_ast(stmts[i]);
+        rename_vars(decl, from, to, locals);
+        derive_tree(decl, PASS_INLINE);
+        *prelude = append_to(*prelude, decl);
+    }
+
+    ASTNode* result = deep_copy_ast(stmts[count - 1]->left);
+    rename_vars(result, from, to, locals);
+    derive_tree(result, PASS_INLINE);
+
+    for (int i = 0; i < locals; i++) {
+        free(to[i]);
+    }
+    free(from);
+    free(to);
+    free_ast(call);
+    return result;
+}
+
+
+static ASTNode* inline_expr(ASTNode* node, ASTNode** prelude, InlineContext* ctx) {
+    if (!node) return NULL;
+
+    node->left = inline_expr(node->left, prelude, ctx);
+    node->right = inline_expr(node->right, prelude, ctx);
+    if (node->type == NODE_EXPR_LIST) {
+        node->next = inline_expr(node->next, prelude, ctx);
+    }
+
+    if (node->type == NODE_FUNC_CALL) {
+        int callee = find_function(ctx->graph, node->value);
+        if (callee >= 0 && ctx->inlinable[callee]) {
+            return inline_call(node, callee, prelude, ctx);
+        }
+    }
+    return node;
+}
+
+
+static ASTNode* inline_stmt(ASTNode* node, InlineContext* ctx) {
+    if (!node) return NULL;
+
+    ASTNode* prelude = NULL;
+    switch (node->type) {
+        case NODE_SEQ:
+            node->left = inline_stmt(node->left, ctx);
+            node->right = inline_stmt(node->right, ctx);
+            return node;
+
+        case NODE_IF:
+            node->left = inline_expr(node->left, &prelude, ctx);
+            node->right = inline_stmt(node->right, ctx);
+            break;
+
+        case NODE_FOR: {
+            // Only the init runs once; calls in the condition and update stay.
+            ASTNode* init = node->child[FOR_INIT];
+            if (init && init->type == NODE_DECL) {
+                init->left = inline_expr(init->left, &prelude, ctx);
+            } else {
+                node->child[FOR_INIT] = inline_expr(init, &prelude, ctx);
+            }
+            node->child[FOR_BODY] = inline_stmt(node->child[FOR_BODY], ctx);
+            break;
+        }
+
+        case NODE_DECL:
+        case NODE_RETURN:
+            node->left = inline_expr(node->left, &prelude, ctx);
+            break;
+
+        default: {
+            // Expression statement; an inlined call on its own has no effect.
+            ASTNode* expr = inline_expr(node, &prelude, ctx);
+            if (expr != node && !has_side_effects(expr)) {
+                free_ast(expr);
+                expr = NULL;
+            }
+            node = expr;
+            break;
+        }
+    }
+
+    return append_to(prelude, node);
+}
+
+
+static void mark_active(CallGraph* graph, int index, bool* active) {
+    if (active[index]) return;
+    active[index] = true;
+    for (int i = 0; i < graph->nodes[index].callee_count; i++) {
+        mark_active(graph, graph->nodes[index].callees[i], active);
+    }
+}
+
+
+/* Inlines small leaf functions into their callers. Callers are visited
+   after their callees, so a function whose calls were all inlined can in
+   turn be inlined further up. With `dirty`, only those functions and what
+   they call are touched. */
+static void inline_functions(ASTNode*** slots, int count, const bool* dirty) {
+    int dirty_count = count;
+    for (int i = 0; dirty && i < count; i++) {
+        if (!dirty[i]) dirty_count--;
+    }
+    if (dirty_count == 0) return;
+
+    CallGraph* graph = build_call_graph(slots, count);
+    bool* inlinable = (bool*)calloc(count, sizeof(bool));
+    bool* active = (bool*)calloc(count, sizeof(bool));
+    if (!inlinable || !active) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < count; i++) {
+        if (!dirty || dirty[i]) mark_active(graph, i, active);
+    }
+
+    for (int k = 0; k < graph->order_count; k++) {
+        int index = graph->order[k];
+        ASTNode* func = *graph->nodes[index].slot;
+        if (!active[index]) continue;
+
+        if (graph->nodes[index].callee_count > 0) {
+            InlineContext ctx = { graph, inlinable, {0}, 0 };
+            collect_names(func, &ctx.names);
+            func->left = inline_stmt(func->left, &ctx);
+            free_var_table(&ctx.names);
+        }
+        inlinable[index] = is_inlinable(graph, index);
+    }
+
+    free(inlinable);
+    free(active);
+    free_call_graph(graph);
+}
+
+
+#define MAX_PROPAGATION_ROUNDS 8
+
+static ASTNode* simplify(ASTNode* root) {
+    uint64_t start = now_nanos();
+    root = fold_constants(root);
+    start = pass_done(PASS_FOLD, start);
+    for (int round = 0; round < MAX_PROPAGATION_ROUNDS; round++) {
+        bool changed = propagate_constants(root);
+        start = pass_done(PASS_PROPAGATE, start);
+        if (!changed) break;
+        root = fold_constants(root);
+        start = pass_done(PASS_FOLD, start);
+    }
+    root = eliminate_dead_code(root);
+    pass_done(PASS_DCE, start);
+    return root;
+}
+
+
+/* The loop passes skip code without loops, going by the kind masks that
+   simplify() does not maintain. */
+static ASTNode* optimize_function(ASTNode* root) {
+    root = simplify(root);
+    uint64_t start = now_nanos();
+    ast_update_kinds(root);
+    root = unroll_loops(root);
+    pass_done(PASS_UNROLL, start);
+    // Unrolled copies hold constants where the induction variable was
+    root = simplify(root);
+    ast_update_kinds(root);
+    root = restructure_loops(root);
+    start = now_nanos();
+    root = hoist_loop_invariants(root);
+    start = pass_done(PASS_LICM, start);
+    root = mark_simd_loops(root);
+    pass_done(PASS_SIMD, start);
+    dependence_reset();
+    return root;
+}
+
+
+/* Functions of a translation unit are independent, so each one is a task.
+   Every worker owns a contiguous range of tasks and claims them with an
+   atomic counter; once its range is drained it steals from the others. */
+typedef struct {
+    int next;
+    int end;
+} TaskRange;
+
+typedef struct {
+    ASTNode*** slots;
+    TaskRange* ranges;
+    int workers;
+} FunctionPool;
+
+typedef struct {
+    FunctionPool* pool;
+    int id;
+} Worker;
+
+
+static int claim_task(TaskRange* range) {
+    int index = __atomic_fetch_add(&range->next, 1, __ATOMIC_RELAXED);
+    return index < range->end ? index : -1;
+}
+
+
+static void* run_worker(void* arg) {
+    Worker* worker = (Worker*)arg;
+    FunctionPool* pool = worker->pool;
+    mem_enter(MEM_OPTIMIZER);
+
+    for (int k = 0; k < pool->workers; k++) {
+        TaskRange* range = &pool->ranges[(worker->id + k) % pool->workers];
+        int index;
+        while ((index = claim_task(range)) >= 0) {
+            ASTNode** slot = pool->slots[index];
+            *slot = optimize_function(*slot);
+        }
+    }
+    return NULL;
+}
+
+
+static int worker_count(int tasks) {
+    int workers = 1;
+    const char* env = getenv("COPTIVIZ_THREADS");
+    if (env) {
+        workers = atoi(env);
+    } else {
+#ifdef _SC_NPROCESSORS_ONLN
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+
+    if (workers < 1) workers = 1;
+    if (workers > tasks) workers = tasks;
+    return workers;
+}
+
+
+// Top-level functions are linked through `next`; returns false when the
+// tree is not a list of functions
+static bool all_functions(ASTNode* root, int* count) {
+    *count = 0;
+    for (ASTNode* node = root; node; node = node->next) {
+        if (node->type != NODE_FUNC_DEF) return false;
+        (*count)++;
+    }
+    return true;
+}
+
+
+static void optimize_functions(ASTNode*** slots, int count) {
+    int workers = worker_count(count);
+
+    FunctionPool pool;
+    pool.slots = slots;
+    pool.workers = workers;
+    pool.ranges = (TaskRange*)malloc(workers * sizeof(TaskRange));
+    Worker* args = (Worker*)malloc(workers * sizeof(Worker));
+    pthread_t* threads = (pthread_t*)malloc(workers * sizeof(pthread_t));
+    bool* started = (bool*)calloc(workers, sizeof(bool));
+    if (!pool.ranges || !args || !threads || !started) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    for (int w = 0; w < workers; w++) {
+        pool.ranges[w].next = (int)((long)count * w / workers);
+        pool.ranges[w].end = (int)((long)count * (w + 1) / workers);
+        args[w].pool = &pool;
+        args[w].id = w;
+    }
+
+    // The calling thread is worker 0; if a thread fails to start, its range
+    // is simply stolen by the others.
+    for (int w = 1; w < workers; w++) {
+        started[w] = pthread_create(&threads[w], NULL, run_worker, &args[w]) == 0;
+    }
+    run_worker(&args[0]);
+    for (int w = 1; w < workers; w++) {
+        if (started[w]) pthread_join(threads[w], NULL);
+    }
+
+    free(pool.ranges);
+    free(args);
+    free(threads);
+    free(started);
+}
+
+
+/* With a cache path, functions whose source and callees are unchanged since
+   the last run take their optimized form from the cache and only the rest
+   go through the passes. A tree that is not a list of functions is cached
+   as a whole, and so is a lone function. */
+ASTNode* optimize_ast_cached(ASTNode* root, const char* cache_path) {
+    if (!root) return NULL;
+
+    uint64_t started = now_nanos();
+    MemSubsystem caller = mem_enter(MEM_OPTIMIZER);
+    int count = 0;
+    bool split = all_functions(root, &count);
+    if (!cache_path && (!split || count == 1)) {
+        root = optimize_function(root);
+        __atomic_fetch_add(&optimize_nanos, now_nanos() - started, __ATOMIC_RELAXED);
+        mem_enter(caller);
+        return root;
+    }
+    if (!split) count = 1;
+
+    ASTNode** functions = (ASTNode**)malloc(count * sizeof(ASTNode*));
+    ASTNode*** slots = (ASTNode***)malloc(count * sizeof(ASTNode**));
+    ASTNode*** work = (ASTNode***)malloc(count * sizeof(ASTNode**));
+    bool* dirty = (bool*)malloc(count * sizeof(bool));
+    if (!functions || !slots || !work || !dirty) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    // Passes follow `next`, so each function is unlinked while it is worked on
+    ASTNode* node = root;
+    for (int i = 0; i < count; i++) {
+        functions[i] = node;
+        slots[i] = &functions[i];
+        node = node->next;
+        if (split) functions[i]->next = NULL;
+    }
+
+    OptCache* cache = cache_path ? open_opt_cache(cache_path, slots, count) : NULL;
+    int work_count = 0;
+    for (int i = 0; i < count; i++) {
+        dirty[i] = !cache || !opt_cache_hit(cache, i);
+        if (dirty[i]) work[work_count++] = slots[i];
+    }
+
+    uint64_t start = now_nanos();
+    if (split) inline_functions(slots, count, cache ? dirty : NULL);
+    pass_done(PASS_INLINE, start);
+    if (work_count > 0) optimize_functions(work, work_count);
+
+    if (cache) {
+        for (int i = 0; i < count; i++) {
+            if (dirty[i]) {
+                opt_cache_update(cache, i, *slots[i]);
+            } else {
+                free_ast(*slots[i]);
+                *slots[i] = opt_cache_restore(cache, i);
+            }
+        }
+        save_opt_cache(cache, cache_path);
+        free_opt_cache(cache);
+    }
+    for (int i = 0; i + 1 < count; i++) {
+        functions[i]->next = functions[i + 1];
+    }
+    root = functions[0];
+    free(functions);
+    free(slots);
+    free(work);
+    free(dirty);
+    __atomic_fetch_add(&optimize_nanos, now_nanos() - started, __ATOMIC_RELAXED);
+    mem_enter(caller);
+    return root;
+}
+
+
+ASTNode* optimize_ast(ASTNode* root) {
+    return optimize_ast_cached(root, NULL);
+}
@@ -67,17 +67,59 @@
 
 
 /* First part of user prologue.  */
-#line 5 "parser.y"
+#line 13 "parser.y"
 
 #include <stdio.h>
 #include "ast.h"
+#include "memtrack.h"
+#include "srcloc.h"
+
+/* Spans are byte offsets; every reduction also tells create_node() where
+   the rule started so nodes are stamped without touching the actions. */
+#define YYLLOC_DEFAULT(Cur, Rhs, N)                          \
+    do {                                                     \
+        if (N) {                                             \
+            (Cur).first = YYRHSLOC(Rhs, 1).first;            \
+            (Cur).last = YYRHSLOC(Rhs, N).last;              \
+        } else {                                             \
+            (Cur).first = (Cur).last = YYRHSLOC(Rhs, 0).last; \
+        }                                                    \
+        ast_set_location((Cur).first);                       \
+    } while (0)
 
 extern int yylex();
-void yyerror(const char* s) { fprintf(stderr, "Parse error: %s\n", s); }
 
-ASTNode* ast_root;
+void yyerror(const char* s);
 
-#line 81 "parser.tab.c"
+ASTNode* ast_root = NULL;
+int parse_error_count = 0;
+FILE* parse_error_output = NULL;    // stderr when NULL
+
+// Statements dropped by error recovery come back as NULL.
+static ASTNode* append_stmt(ASTNode* list, ASTNode* stmt) {
+    if (!list) return stmt;
+    if (!stmt) return list;
+    return make_seq_node(list, stmt);
+}
+
+/* Functions are linked through `next` under ast_root rather than nested in
+   SEQ nodes, so each one sits at the top of the tree however many precede it. */
+static ASTNode* last_function = NULL;
+
+static void append_function(ASTNode* function) {
+    if (!function) return;
+    if (last_function) last_function->next = function;
+    else ast_root = function;
+    last_function = function;
+}
+
+// Nodes copy their text, so the token's own copy goes once the node exists
+static ASTNode* release_token(ASTNode* node, char* text) {
+    mem_free_string(MEM_LEXER, text);
+    return node;
+}
+
+#line 123 "parser.tab.c"
 
 # ifndef YY_CAST
 #  ifdef __cplusplus
@@ -127,22 +169,31 @@ enum yysymbol_kind_t
   YYSYMBOL_MUL = 19,                       /* MUL  */
   YYSYMBOL_DIV = 20,                       /* DIV  */
   YYSYMBOL_LT = 21,                        /* LT  */
-  YYSYMBOL_INCR = 22,                      /* INCR  */
-  YYSYMBOL_DECR = 23,                      /* DECR  */
-  YYSYMBOL_YYACCEPT = 24,                  /* $accept  */
-  YYSYMBOL_program = 25,                   /* program  */
-  YYSYMBOL_function = 26,                  /* function  */
-  YYSYMBOL_type = 27,                      /* type  */
-  YYSYMBOL_stmt_list = 28,                 /* stmt_list  */
-  YYSYMBOL_compound_stmt = 29,             /* compound_stmt  */
-  YYSYMBOL_stmt = 30,                      /* stmt  */
-  YYSYMBOL_decl_stmt = 31,                 /* decl_stmt  */
-  YYSYMBOL_if_stmt = 32,                   /* if_stmt  */
-  YYSYMBOL_for_init = 33,                  /* for_init  */
-  YYSYMBOL_for_stmt = 34,                  /* for_stmt  */
-  YYSYMBOL_return_stmt = 35,               /* return_stmt  */
-  YYSYMBOL_expr = 36,                      /* expr  */
-  YYSYMBOL_expr_list = 37                  /* expr_list  */
+  YYSYMBOL_LE = 22,                        /* LE  */
+  YYSYMBOL_GT = 23,                        /* GT  */
+  YYSYMBOL_GE = 24,                        /* GE  */
+  YYSYMBOL_EQ = 25,                        /* EQ  */
+  YYSYMBOL_NE = 26,                        /* NE  */
+  YYSYMBOL_INCR = 27,                      /* INCR  */
+  YYSYMBOL_DECR = 28,                      /* DECR  */
+  YYSYMBOL_YYACCEPT = 29,                  /* $accept  */
+  YYSYMBOL_program = 30,                   /* program  */
+  YYSYMBOL_function_list = 31,             /* function_list  */
+  YYSYMBOL_function = 32,                  /* function  */
+  YYSYMBOL_params = 33,                    /* params  */
+  YYSYMBOL_param_list = 34,                /* param_list  */
+  YYSYMBOL_param = 35,                     /* param  */
+  YYSYMBOL_type = 36,                      /* type  */
+  YYSYMBOL_stmt_list = 37,                 /* stmt_list  */
+  YYSYMBOL_compound_stmt = 38,             /* compound_stmt  */
+  YYSYMBOL_stmt = 39,                      /* stmt  */
+  YYSYMBOL_decl_stmt = 40,                 /* decl_stmt  */
+  YYSYMBOL_if_stmt = 41,                   /* if_stmt  */
+  YYSYMBOL_for_init = 42,                  /* for_init  */
+  YYSYMBOL_for_stmt = 43,                  /* for_stmt  */
+  YYSYMBOL_return_stmt = 44,               /* return_stmt  */
+  YYSYMBOL_expr = 45,                      /* expr  */
+  YYSYMBOL_expr_list = 46                  /* expr_list  */
 };
 typedef enum yysymbol_kind_t yysymbol_kind_t;
 
@@ -340,7 +391,7 @@ typedef int yy_state_fast_t;
 
 #define YY_ASSERT(E) ((void) (0 && (E)))
 
-#if !defined yyoverflow
+#if 1
 
 /* The parser invokes alloca or malloc; define the necessary symbols.  */
 
@@ -405,17 +456,19 @@ void free (void *); /* INFRINGES ON USER NAME SPACE */
 #   endif
 #  endif
 # endif
-#endif /* !defined yyoverflow */
+#endif /* 1 */
 
 #if (! defined yyoverflow \
      && (! defined __cplusplus \
-         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+         || (defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL \
+             && defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
 
 /* A type that is properly aligned for any stack member.  */
 union yyalloc
 {
   yy_state_t yyss_alloc;
   YYSTYPE yyvs_alloc;
+  YYLTYPE yyls_alloc;
 };
 
 /* The size of the maximum gap between one aligned stack and the next.  */
@@ -424,8 +477,9 @@ union yyalloc
 /* The size of an array large to enough to hold all stacks, each with
    N elements.  */
 # define YYSTACK_BYTES(N) \
-     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
-      + YYSTACK_GAP_MAXIMUM)
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE) \
+             + YYSIZEOF (YYLTYPE)) \
+      + 2 * YYSTACK_GAP_MAXIMUM)
 
 # define YYCOPY_NEEDED 1
 
@@ -468,21 +522,21 @@ union yyalloc
 #endif /* !YYCOPY_NEEDED */
 
 /* YYFINAL -- State number of the termination state.  */
-#define YYFINAL  5
+#define YYFINAL  8
 /* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST   109
+#define YYLAST   178
 
 /* YYNTOKENS -- Number of terminals.  */
-#define YYNTOKENS  24
+#define YYNTOKENS  29
 /* YYNNTS -- Number of nonterminals.  */
-#define YYNNTS  14
+#define YYNNTS  18
 /* YYNRULES -- Number of rules.  */
-#define YYNRULES  35
+#define YYNRULES  52
 /* YYNSTATES -- Number of states.  */
-#define YYNSTATES  71
+#define YYNSTATES  99
 
 /* YYMAXUTOK -- Last valid token kind.  */
-#define YYMAXUTOK   278
+#define YYMAXUTOK   283
 
 
 /* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
@@ -523,24 +577,27 @@ static const yytype_int8 yytranslate[] =
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
        5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
-      15,    16,    17,    18,    19,    20,    21,    22,    23
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    27,    28
 };
 
 #if YYDEBUG
 /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
-static const yytype_int8 yyrline[] =
+static const yytype_uint8 yyrline[] =
 {
-       0,    42,    42,    46,    51,    55,    56,    60,    64,    65,
-      66,    67,    68,    72,    74,    78,    83,    84,    85,    86,
-      90,    95,    99,   100,   101,   102,   103,   104,   105,   106,
-     107,   108,   109,   110,   115,   116
+       0,   101,   101,   107,   108,   112,   114,   118,   119,   123,
+     124,   128,   132,   136,   137,   141,   142,   146,   147,   148,
+     149,   150,   151,   152,   156,   158,   162,   167,   168,   169,
+     170,   174,   179,   183,   184,   185,   186,   187,   188,   189,
+     190,   191,   192,   193,   194,   195,   196,   197,   198,   199,
+     200,   205,   206
 };
 #endif
 
 /** Accessing symbol of state STATE.  */
 #define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
 
-#if YYDEBUG || 0
+#if 1
 /* The user-facing name of the symbol whose (internal) number is
    YYSYMBOL.  No bounds checking.  */
 static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
@@ -552,9 +609,11 @@ static const char *const yytname[] =
   "\"end of file\"", "error", "\"invalid token\"", "NUMBER", "IDENTIFIER",
   "STRING", "KW_INT", "KW_IF", "KW_FOR", "KW_RETURN", "LPAREN", "RPAREN",
   "LBRACE", "RBRACE", "SEMICOLON", "ASSIGN", "COMMA", "PLUS", "MINUS",
-  "MUL", "DIV", "LT", "INCR", "DECR", "$accept", "program", "function",
-  "type", "stmt_list", "compound_stmt", "stmt", "decl_stmt", "if_stmt",
-  "for_init", "for_stmt", "return_stmt", "expr", "expr_list", YY_NULLPTR
+  "MUL", "DIV", "LT", "LE", "GT", "GE", "EQ", "NE", "INCR", "DECR",
+  "$accept", "program", "function_list", "function", "params",
+  "param_list", "param", "type", "stmt_list", "compound_stmt", "stmt",
+  "decl_stmt", "if_stmt", "for_init", "for_stmt", "return_stmt", "expr",
+  "expr_list", YY_NULLPTR
 };
 
 static const char *
@@ -564,28 +623,30 @@ yysymbol_name (yysymbol_kind_t yysymbol)
 }
 #endif
 
-#define YYPACT_NINF (-54)
+#define YYPACT_NINF (-29)
 
 #define yypact_value_is_default(Yyn) \
   ((Yyn) == YYPACT_NINF)
 
-#define YYTABLE_NINF (-1)
+#define YYTABLE_NINF (-3)
 
 #define yytable_value_is_error(Yyn) \
   0
 
 /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
    STATE-NUM.  */
-static const yytype_int8 yypact[] =
+static const yytype_int16 yypact[] =
 {
-       1,   -54,    42,   -54,    44,   -54,    36,    33,    37,    96,
-     -54,   -54,    -8,   -54,    64,    59,    66,    32,    25,   -54,
-     -54,   -54,   -54,   -54,    53,     6,   -54,   -54,   -11,    32,
-      20,    61,   -54,   -54,   -54,    32,    32,    32,    32,    32,
-     -54,    40,   -10,   -54,    32,    34,    73,    70,    40,   -54,
-      21,    21,   -54,   -54,    89,   -54,    32,    69,    37,    78,
-      32,    40,   -54,   -54,    32,    77,    40,    32,    45,    37,
-     -54
+      49,    -7,   -29,    15,     8,   -29,    50,   -29,   -29,   -29,
+      56,    62,    85,    53,   -29,    93,    97,    62,   -29,   156,
+     -29,   -29,     9,   -29,    -8,   -29,   106,   112,   113,    58,
+     133,   -29,   -29,   -29,   -29,   -29,    68,   -29,   -29,   -29,
+       0,    58,   -29,   -29,    44,    58,    32,    81,    39,   -29,
+     -29,   -29,    58,    58,    58,    58,    58,    58,    58,    58,
+      58,    58,   -29,   130,    41,   130,   -29,    58,    23,   131,
+     129,   130,   -29,    64,    64,   -29,   -29,   157,   157,   157,
+     157,   149,   149,   -29,    58,    94,    97,   143,    58,   130,
+     -29,   -29,    58,   107,   130,    58,    54,    97,   -29
 };
 
 /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
@@ -593,28 +654,30 @@ static const yytype_int8 yypact[] =
    means the default is an error.  */
 static const yytype_int8 yydefact[] =
 {
-       0,     4,     0,     2,     0,     1,     0,     0,     0,     0,
-       3,    29,    31,    30,     0,     0,     0,     0,     0,     5,
-       8,    10,    11,    12,     0,     0,    27,    28,     0,     0,
-      19,     0,     7,     6,     9,     0,     0,     0,     0,     0,
-      32,    34,     0,    14,     0,     0,     0,     0,    18,    21,
-      22,    23,    24,    25,    26,    33,     0,     0,     0,    17,
-       0,    35,    13,    15,     0,     0,    16,     0,     0,     0,
-      20
+       0,     0,    12,     0,     0,     3,     0,     6,     1,     4,
+       0,     8,     0,     7,     9,     0,     0,     0,    11,     0,
+       5,    10,     0,    46,    48,    47,     0,     0,     0,     0,
+       0,    13,    17,    19,    20,    21,     0,    16,    22,    23,
+       0,     0,    44,    45,     0,     0,    30,     0,     0,    15,
+      14,    18,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,    49,    51,     0,    33,    25,     0,     0,     0,
+       0,    29,    32,    34,    35,    36,    37,    38,    39,    40,
+      41,    42,    43,    50,     0,     0,     0,    28,     0,    52,
+      24,    26,     0,     0,    27,     0,     0,     0,    31
 };
 
 /* YYPGOTO[NTERM-NUM].  */
-static const yytype_int8 yypgoto[] =
+static const yytype_int16 yypgoto[] =
 {
-     -54,   -54,   -54,   -54,   -54,   -53,    67,   -54,   -54,   -54,
-     -54,   -54,   -17,   -54
+     -29,   -29,   -29,   140,   -29,   -29,   128,    -1,   -29,   -16,
+     148,   -29,   -29,   -29,   -29,   -29,   -28,   -29
 };
 
 /* YYDEFGOTO[NTERM-NUM].  */
 static const yytype_int8 yydefgoto[] =
 {
-       0,     2,     3,     4,    18,    10,    19,    20,    21,    47,
-      22,    23,    24,    42
+       0,     3,     4,     5,    12,    13,    14,     6,    30,    39,
+      31,    32,    33,    70,    34,    35,    36,    64
 };
 
 /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
@@ -622,64 +685,84 @@ static const yytype_int8 yydefgoto[] =
    number is the opposite.  If YYTABLE_NINF, syntax error.  */
 static const yytype_int8 yytable[] =
 {
-      31,    55,    25,    43,    44,    63,    56,     1,    41,    11,
-      12,    13,    45,    48,    26,    27,    70,    40,    50,    51,
-      52,    53,    54,    11,    12,    13,    46,    57,    11,    12,
-      13,    14,    15,    16,    17,    11,    12,    13,    32,    61,
-      37,    38,     5,    65,     8,    58,     7,    66,     6,     9,
-      68,    35,    36,    37,    38,    39,    69,    35,    36,    37,
-      38,    39,    35,    36,    37,    38,    39,    34,    28,    29,
-      35,    36,    37,    38,    39,    49,    30,    59,    35,    36,
-      37,    38,    39,    62,    60,    33,    35,    36,    37,    38,
-      39,    67,     0,    64,    35,    36,    37,    38,    39,    11,
-      12,    13,    14,    15,    16,    17,    35,    36,    37,    38
+      20,    47,    40,    23,    24,    25,     7,    41,    -2,     1,
+      15,    62,    63,    65,     2,     8,    15,    68,    71,    42,
+      43,    19,    37,    38,    73,    74,    75,    76,    77,    78,
+      79,    80,    81,    82,    86,    23,    24,    25,    69,    85,
+      52,    53,    54,    55,    56,    57,    58,    59,    60,    61,
+       1,    19,    83,    38,    10,     2,    89,    84,    66,    67,
+      93,    23,    24,    25,    94,    97,    11,    96,     2,    17,
+      91,    52,    53,    54,    55,    56,    57,    58,    59,    60,
+      61,    98,    51,    54,    55,    52,    53,    54,    55,    56,
+      57,    58,    59,    60,    61,    72,    16,    18,    52,    53,
+      54,    55,    56,    57,    58,    59,    60,    61,    90,    19,
+      44,    52,    53,    54,    55,    56,    57,    58,    59,    60,
+      61,    95,    45,    46,    52,    53,    54,    55,    56,    57,
+      58,    59,    60,    61,    48,    87,    23,    24,    25,    26,
+      27,    28,    29,    88,     9,    21,    49,    52,    53,    54,
+      55,    56,    57,    58,    59,    60,    61,    22,    92,    23,
+      24,    25,    26,    27,    28,    29,    52,    53,    54,    55,
+      56,    57,    58,    59,    52,    53,    54,    55,    50
 };
 
 static const yytype_int8 yycheck[] =
 {
-      17,    11,    10,    14,    15,    58,    16,     6,    25,     3,
-       4,     5,    29,    30,    22,    23,    69,    11,    35,    36,
-      37,    38,    39,     3,     4,     5,     6,    44,     3,     4,
-       5,     6,     7,     8,     9,     3,     4,     5,    13,    56,
-      19,    20,     0,    60,    11,    11,    10,    64,     4,    12,
-      67,    17,    18,    19,    20,    21,    11,    17,    18,    19,
-      20,    21,    17,    18,    19,    20,    21,    14,     4,    10,
-      17,    18,    19,    20,    21,    14,    10,     4,    17,    18,
-      19,    20,    21,    14,    14,    18,    17,    18,    19,    20,
-      21,    14,    -1,    15,    17,    18,    19,    20,    21,     3,
-       4,     5,     6,     7,     8,     9,    17,    18,    19,    20
+      16,    29,    10,     3,     4,     5,    13,    15,     0,     1,
+      11,    11,    40,    41,     6,     0,    17,    45,    46,    27,
+      28,    12,    13,    14,    52,    53,    54,    55,    56,    57,
+      58,    59,    60,    61,    11,     3,     4,     5,     6,    67,
+      17,    18,    19,    20,    21,    22,    23,    24,    25,    26,
+       1,    12,    11,    14,     4,     6,    84,    16,    14,    15,
+      88,     3,     4,     5,    92,    11,    10,    95,     6,    16,
+      86,    17,    18,    19,    20,    21,    22,    23,    24,    25,
+      26,    97,    14,    19,    20,    17,    18,    19,    20,    21,
+      22,    23,    24,    25,    26,    14,    11,     4,    17,    18,
+      19,    20,    21,    22,    23,    24,    25,    26,    14,    12,
+       4,    17,    18,    19,    20,    21,    22,    23,    24,    25,
+      26,    14,    10,    10,    17,    18,    19,    20,    21,    22,
+      23,    24,    25,    26,     1,     4,     3,     4,     5,     6,
+       7,     8,     9,    14,     4,    17,    13,    17,    18,    19,
+      20,    21,    22,    23,    24,    25,    26,     1,    15,     3,
+       4,     5,     6,     7,     8,     9,    17,    18,    19,    20,
+      21,    22,    23,    24,    17,    18,    19,    20,    30
 };
 
 /* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
    state STATE-NUM.  */
 static const yytype_int8 yystos[] =
 {
-       0,     6,    25,    26,    27,     0,     4,    10,    11,    12,
-      29,     3,     4,     5,     6,     7,     8,     9,    28,    30,
-      31,    32,    34,    35,    36,    10,    22,    23,     4,    10,
-      10,    36,    13,    30,    14,    17,    18,    19,    20,    21,
-      11,    36,    37,    14,    15,    36,     6,    33,    36,    14,
-      36,    36,    36,    36,    36,    11,    16,    36,    11,     4,
-      14,    36,    14,    29,    15,    36,    36,    14,    36,    11,
-      29
+       0,     1,     6,    30,    31,    32,    36,    13,     0,    32,
+       4,    10,    33,    34,    35,    36,    11,    16,     4,    12,
+      38,    35,     1,     3,     4,     5,     6,     7,     8,     9,
+      37,    39,    40,    41,    43,    44,    45,    13,    14,    38,
+      10,    15,    27,    28,     4,    10,    10,    45,     1,    13,
+      39,    14,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    11,    45,    46,    45,    14,    15,    45,     6,
+      42,    45,    14,    45,    45,    45,    45,    45,    45,    45,
+      45,    45,    45,    11,    16,    45,    11,     4,    14,    45,
+      14,    38,    15,    45,    45,    14,    45,    11,    38
 };
 
 /* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr1[] =
 {
-       0,    24,    25,    26,    27,    28,    28,    29,    30,    30,
-      30,    30,    30,    31,    31,    32,    33,    33,    33,    33,
-      34,    35,    36,    36,    36,    36,    36,    36,    36,    36,
-      36,    36,    36,    36,    37,    37
+       0,    29,    30,    31,    31,    32,    32,    33,    33,    34,
+      34,    35,    36,    37,    37,    38,    38,    39,    39,    39,
+      39,    39,    39,    39,    40,    40,    41,    42,    42,    42,
+      42,    43,    44,    45,    45,    45,    45,    45,    45,    45,
+      45,    45,    45,    45,    45,    45,    45,    45,    45,    45,
+      45,    46,    46
 };
 
 /* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr2[] =
 {
-       0,     2,     1,     5,     1,     1,     2,     3,     1,     2,
-       1,     1,     1,     5,     3,     5,     4,     2,     1,     0,
-       9,     3,     3,     3,     3,     3,     3,     2,     2,     1,
-       1,     1,     3,     4,     1,     3
+       0,     2,     1,     1,     2,     6,     2,     1,     0,     1,
+       3,     2,     1,     1,     2,     3,     3,     1,     2,     1,
+       1,     1,     2,     2,     5,     3,     5,     4,     2,     1,
+       0,     9,     3,     3,     3,     3,     3,     3,     3,     3,
+       3,     3,     3,     3,     2,     2,     1,     1,     1,     3,
+       4,     1,     3
 };
 
 
@@ -717,6 +800,32 @@ enum { YYENOMEM = -2 };
    Use YYerror or YYUNDEF. */
 #define YYERRCODE YYUNDEF
 
+/* YYLLOC_DEFAULT -- Set CURRENT to span from RHS[1] to RHS[N].
+   If N is 0, then set CURRENT to the empty location which ends
+   the previous symbol: RHS[0] (always defined).  */
+
+#ifndef YYLLOC_DEFAULT
+# define YYLLOC_DEFAULT(Current, Rhs, N)                                \
+    do                                                                  \
+      if (N)                                                            \
+        {                                                               \
+          (Current).first_line   = YYRHSLOC (Rhs, 1).first_line;        \
+          (Current).first_column = YYRHSLOC (Rhs, 1).first_column;      \
+          (Current).last_line    = YYRHSLOC (Rhs, N).last_line;         \
+          (Current).last_column  = YYRHSLOC (Rhs, N).last_column;       \
+        }                                                               \
+      else                                                              \
+        {                                                               \
+          (Current).first_line   = (Current).last_line   =              \
+            YYRHSLOC (Rhs, 0).last_line;                                \
+          (Current).first_column = (Current).last_column =              \
+            YYRHSLOC (Rhs, 0).last_column;                              \
+        }                                                               \
+    while (0)
+#endif
+
+#define YYRHSLOC(Rhs, K) ((Rhs)[K])
+
 
 /* Enable debugging if requested.  */
 #if YYDEBUG
@@ -733,6 +842,63 @@ do {                                            \
 } while (0)
 
 
+/* YYLOCATION_PRINT -- Print the location on the stream.
+   This macro was not mandated originally: define only if we know
+   we won't break user code: when these are the locations we know.  */
+
+# ifndef YYLOCATION_PRINT
+
+#  if defined YY_LOCATION_PRINT
+
+   /* Temporary convenience wrapper in case some people defined the
+      undocumented and private YY_LOCATION_PRINT macros.  */
+#   define YYLOCATION_PRINT(File, Loc)  YY_LOCATION_PRINT(File, *(Loc))
+
+#  elif defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL
+
+/* Print *YYLOCP on YYO.  Private, do not rely on its existence. */
+
+YY_ATTRIBUTE_UNUSED
+static int
+yy_location_print_ (FILE *yyo, YYLTYPE const * const yylocp)
+{
+  int res = 0;
+  int end_col = 0 != yylocp->last_column ? yylocp->last_column - 1 : 0;
+  if (0 <= yylocp->first_line)
+    {
+      res += YYFPRINTF (yyo, "%d", yylocp->first_line);
+      if (0 <= yylocp->first_column)
+        res += YYFPRINTF (yyo, ".%d", yylocp->first_column);
+    }
+  if (0 <= yylocp->last_line)
+    {
+      if (yylocp->first_line < yylocp->last_line)
+        {
+          res += YYFPRINTF (yyo, "-%d", yylocp->last_line);
+          if (0 <= end_col)
+            res += YYFPRINTF (yyo, ".%d", end_col);
+        }
+      else if (0 <= end_col && yylocp->first_column < end_col)
+        res += YYFPRINTF (yyo, "-%d", end_col);
+    }
+  return res;
+}
+
+#   define YYLOCATION_PRINT  yy_location_print_
+
+    /* Temporary convenience wrapper in case some people defined the
+       undocumented and private YY_LOCATION_PRINT macros.  */
+#   define YY_LOCATION_PRINT(File, Loc)  YYLOCATION_PRINT(File, &(Loc))
+
+#  else
+
+#   define YYLOCATION_PRINT(File, Loc) ((void) 0)
+    /* Temporary convenience wrapper in case some people defined the
+       undocumented and private YY_LOCATION_PRINT macros.  */
+#   define YY_LOCATION_PRINT  YYLOCATION_PRINT
+
+#  endif
+# endif /* !defined YYLOCATION_PRINT */
 
 
 # define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
@@ -741,7 +907,7 @@ do {                                                                      \
     {                                                                     \
       YYFPRINTF (stderr, "%s ", Title);                                   \
       yy_symbol_print (stderr,                                            \
-                  Kind, Value); \
+                  Kind, Value, Location); \
       YYFPRINTF (stderr, "\n");                                           \
     }                                                                     \
 } while (0)
@@ -753,10 +919,11 @@ do {                                                                      \
 
 static void
 yy_symbol_value_print (FILE *yyo,
-                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, YYLTYPE const * const yylocationp)
 {
   FILE *yyoutput = yyo;
   YY_USE (yyoutput);
+  YY_USE (yylocationp);
   if (!yyvaluep)
     return;
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
@@ -771,12 +938,14 @@ yy_symbol_value_print (FILE *yyo,
 
 static void
 yy_symbol_print (FILE *yyo,
-                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, YYLTYPE const * const yylocationp)
 {
   YYFPRINTF (yyo, "%s %s (",
              yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  yy_symbol_value_print (yyo, yykind, yyvaluep);
+  YYLOCATION_PRINT (yyo, yylocationp);
+  YYFPRINTF (yyo, ": ");
+  yy_symbol_value_print (yyo, yykind, yyvaluep, yylocationp);
   YYFPRINTF (yyo, ")");
 }
 
@@ -809,7 +978,7 @@ do {                                                            \
 `------------------------------------------------*/
 
 static void
-yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp, YYLTYPE *yylsp,
                  int yyrule)
 {
   int yylno = yyrline[yyrule];
@@ -823,7 +992,8 @@ yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
       YYFPRINTF (stderr, "   $%d = ", yyi + 1);
       yy_symbol_print (stderr,
                        YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
-                       &yyvsp[(yyi + 1) - (yynrhs)]);
+                       &yyvsp[(yyi + 1) - (yynrhs)],
+                       &(yylsp[(yyi + 1) - (yynrhs)]));
       YYFPRINTF (stderr, "\n");
     }
 }
@@ -831,7 +1001,7 @@ yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
 # define YY_REDUCE_PRINT(Rule)          \
 do {                                    \
   if (yydebug)                          \
-    yy_reduce_print (yyssp, yyvsp, Rule); \
+    yy_reduce_print (yyssp, yyvsp, yylsp, Rule); \
 } while (0)
 
 /* Nonzero means print parse trace.  It is left uninitialized so that
@@ -862,9 +1032,277 @@ int yydebug;
 #endif
 
 
+/* Context of a parse error.  */
+typedef struct
+{
+  yy_state_t *yyssp;
+  yysymbol_kind_t yytoken;
+  YYLTYPE *yylloc;
+} yypcontext_t;
+
+/* Put in YYARG at most YYARGN of the expected tokens given the
+   current YYCTX, and return the number of tokens stored in YYARG.  If
+   YYARG is null, return the number of expected tokens (guaranteed to
+   be less than YYNTOKENS).  Return YYENOMEM on memory exhaustion.
+   Return 0 if there are more than YYARGN expected tokens, yet fill
+   YYARG up to YYARGN. */
+static int
+yypcontext_expected_tokens (const yypcontext_t *yyctx,
+                            yysymbol_kind_t yyarg[], int yyargn)
+{
+  /* Actual size of YYARG. */
+  int yycount = 0;
+  int yyn = yypact[+*yyctx->yyssp];
+  if (!yypact_value_is_default (yyn))
+    {
+      /* Start YYX at -YYN if negative to avoid negative indexes in
+         YYCHECK.  In other words, skip the first -YYN actions for
+         this state because they are default actions.  */
+      int yyxbegin = yyn < 0 ? -yyn : 0;
+      /* Stay within bounds of both yycheck and yytname.  */
+      int yychecklim = YYLAST - yyn + 1;
+      int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
+      int yyx;
+      for (yyx = yyxbegin; yyx < yyxend; ++yyx)
+        if (yycheck[yyx + yyn] == yyx && yyx != YYSYMBOL_YYerror
+            && !yytable_value_is_error (yytable[yyx + yyn]))
+          {
+            if (!yyarg)
+              ++yycount;
+            else if (yycount == yyargn)
+              return 0;
+            else
+              yyarg[yycount++] = YY_CAST (yysymbol_kind_t, yyx);
+          }
+    }
+  if (yyarg && yycount == 0 && 0 < yyargn)
+    yyarg[0] = YYSYMBOL_YYEMPTY;
+  return yycount;
+}
+
 
 
 
+#ifndef yystrlen
+# if defined __GLIBC__ && defined _STRING_H
+#  define yystrlen(S) (YY_CAST (YYPTRDIFF_T, strlen (S)))
+# else
+/* Return the length of YYSTR.  */
+static YYPTRDIFF_T
+yystrlen (const char *yystr)
+{
+  YYPTRDIFF_T yylen;
+  for (yylen = 0; yystr[yylen]; yylen++)
+    continue;
+  return yylen;
+}
+# endif
+#endif
+
+#ifndef yystpcpy
+# if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
+#  define yystpcpy stpcpy
+# else
+/* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
+   YYDEST.  */
+static char *
+yystpcpy (char *yydest, const char *yysrc)
+{
+  char *yyd = yydest;
+  const char *yys = yysrc;
+
+  while ((*yyd++ = *yys++) != '\0')
+    continue;
+
+  return yyd - 1;
+}
+# endif
+#endif
+
+#ifndef yytnamerr
+/* Copy to YYRES the contents of YYSTR after stripping away unnecessary
+   quotes and backslashes, so that it's suitable for yyerror.  The
+   heuristic is that double-quoting is unnecessary unless the string
+   contains an apostrophe, a comma, or backslash (other than
+   backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
+   null, do not copy; instead, return the length of what the result
+   would have been.  */
+static YYPTRDIFF_T
+yytnamerr (char *yyres, const char *yystr)
+{
+  if (*yystr == '"')
+    {
+      YYPTRDIFF_T yyn = 0;
+      char const *yyp = yystr;
+      for (;;)
+        switch (*++yyp)
+          {
+          case '\'':
+          case ',':
+            goto do_not_strip_quotes;
+
+          case '\\':
+            if (*++yyp != '\\')
+              goto do_not_strip_quotes;
+            else
+              goto append;
+
+          append:
+          default:
+            if (yyres)
+              yyres[yyn] = *yyp;
+            yyn++;
+            break;
+
+          case '"':
+            if (yyres)
+              yyres[yyn] = '\0';
+            return yyn;
+          }
+    do_not_strip_quotes: ;
+    }
+
+  if (yyres)
+    return yystpcpy (yyres, yystr) - yyres;
+  else
+    return yystrlen (yystr);
+}
+#endif
+
+
+static int
+yy_syntax_error_arguments (const yypcontext_t *yyctx,
+                           yysymbol_kind_t yyarg[], int yyargn)
+{
+  /* Actual size of YYARG. */
+  int yycount = 0;
+  /* There are many possibilities here to consider:
+     - If this state is a consistent state with a default action, then
+       the only way this function was invoked is if the default action
+       is an error action.  In that case, don't check for expected
+       tokens because there are none.
+     - The only way there can be no lookahead present (in yychar) is if
+       this state is a consistent state with a default action.  Thus,
+       detecting the absence of a lookahead is sufficient to determine
+       that there is no unexpected or expected token to report.  In that
+       case, just report a simple "syntax error".
+     - Don't assume there isn't a lookahead just because this state is a
+       consistent state with a default action.  There might have been a
+       previous inconsistent state, consistent state with a non-default
+       action, or user semantic action that manipulated yychar.
+     - Of course, the expected token list depends on states to have
+       correct lookahead information, and it depends on the parser not
+       to perform extra reductions after fetching a lookahead from the
+       scanner and before detecting a syntax error.  Thus, state merging
+       (from LALR or IELR) and default reductions corrupt the expected
+       token list.  However, the list is correct for canonical LR with
+       one exception: it will still contain any token that will not be
+       accepted due to an error action in a later state.
+  */
+  if (yyctx->yytoken != YYSYMBOL_YYEMPTY)
+    {
+      int yyn;
+      if (yyarg)
+        yyarg[yycount] = yyctx->yytoken;
+      ++yycount;
+      yyn = yypcontext_expected_tokens (yyctx,
+                                        yyarg ? yyarg + 1 : yyarg, yyargn - 1);
+      if (yyn == YYENOMEM)
+        return YYENOMEM;
+      else
+        yycount += yyn;
+    }
+  return yycount;
+}
+
+/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
+   about the unexpected token YYTOKEN for the state stack whose top is
+   YYSSP.
+
+   Return 0 if *YYMSG was successfully written.  Return -1 if *YYMSG is
+   not large enough to hold the message.  In that case, also set
+   *YYMSG_ALLOC to the required number of bytes.  Return YYENOMEM if the
+   required number of bytes is too large to store.  */
+static int
+yysyntax_error (YYPTRDIFF_T *yymsg_alloc, char **yymsg,
+                const yypcontext_t *yyctx)
+{
+  enum { YYARGS_MAX = 5 };
+  /* Internationalized format string. */
+  const char *yyformat = YY_NULLPTR;
+  /* Arguments of yyformat: reported tokens (one for the "unexpected",
+     one per "expected"). */
+  yysymbol_kind_t yyarg[YYARGS_MAX];
+  /* Cumulated lengths of YYARG.  */
+  YYPTRDIFF_T yysize = 0;
+
+  /* Actual size of YYARG. */
+  int yycount = yy_syntax_error_arguments (yyctx, yyarg, YYARGS_MAX);
+  if (yycount == YYENOMEM)
+    return YYENOMEM;
+
+  switch (yycount)
+    {
+#define YYCASE_(N, S)                       \
+      case N:                               \
+        yyformat = S;                       \
+        break
+    default: /* Avoid compiler warnings. */
+      YYCASE_(0, YY_("syntax error"));
+      YYCASE_(1, YY_("syntax error, unexpected %s"));
+      YYCASE_(2, YY_("syntax error, unexpected %s, expecting %s"));
+      YYCASE_(3, YY_("syntax error, unexpected %s, expecting %s or %s"));
+      YYCASE_(4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
+      YYCASE_(5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
+#undef YYCASE_
+    }
+
+  /* Compute error message size.  Don't count the "%s"s, but reserve
+     room for the terminator.  */
+  yysize = yystrlen (yyformat) - 2 * yycount + 1;
+  {
+    int yyi;
+    for (yyi = 0; yyi < yycount; ++yyi)
+      {
+        YYPTRDIFF_T yysize1
+          = yysize + yytnamerr (YY_NULLPTR, yytname[yyarg[yyi]]);
+        if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
+          yysize = yysize1;
+        else
+          return YYENOMEM;
+      }
+  }
+
+  if (*yymsg_alloc < yysize)
+    {
+      *yymsg_alloc = 2 * yysize;
+      if (! (yysize <= *yymsg_alloc
+             && *yymsg_alloc <= YYSTACK_ALLOC_MAXIMUM))
+        *yymsg_alloc = YYSTACK_ALLOC_MAXIMUM;
+      return -1;
+    }
+
+  /* Avoid sprintf, as that infringes on the user's name space.
+     Don't have undefined behavior even if the translation
+     produced a string with the wrong number of "%s"s.  */
+  {
+    char *yyp = *yymsg;
+    int yyi = 0;
+    while ((*yyp = *yyformat) != '\0')
+      if (*yyp == '%' && yyformat[1] == 's' && yyi < yycount)
+        {
+          yyp += yytnamerr (yyp, yytname[yyarg[yyi++]]);
+          yyformat += 2;
+        }
+      else
+        {
+          ++yyp;
+          ++yyformat;
+        }
+  }
+  return 0;
+}
+
 
 /*-----------------------------------------------.
 | Release the memory associated to this symbol.  |
@@ -872,15 +1310,122 @@ int yydebug;
 
 static void
 yydestruct (const char *yymsg,
-            yysymbol_kind_t yykind, YYSTYPE *yyvaluep)
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, YYLTYPE *yylocationp)
 {
   YY_USE (yyvaluep);
+  YY_USE (yylocationp);
   if (!yymsg)
     yymsg = "Deleting";
   YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
 
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YY_USE (yykind);
+  switch (yykind)
+    {
+    case YYSYMBOL_IDENTIFIER: /* IDENTIFIER  */
+#line 88 "parser.y"
+            { mem_free_string(MEM_LEXER, ((*yyvaluep).str)); }
+#line 1328 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_STRING: /* STRING  */
+#line 88 "parser.y"
+            { mem_free_string(MEM_LEXER, ((*yyvaluep).str)); }
+#line 1334 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_function: /* function  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1340 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_params: /* params  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1346 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_param_list: /* param_list  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1352 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_param: /* param  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1358 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_type: /* type  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1364 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_stmt_list: /* stmt_list  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1370 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_compound_stmt: /* compound_stmt  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1376 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_stmt: /* stmt  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1382 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_decl_stmt: /* decl_stmt  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1388 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_if_stmt: /* if_stmt  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1394 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_for_init: /* for_init  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1400 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_for_stmt: /* for_stmt  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1406 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_return_stmt: /* return_stmt  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1412 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_expr: /* expr  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1418 "parser.tab.c"
+        break;
+
+    case YYSYMBOL_expr_list: /* expr_list  */
+#line 87 "parser.y"
+            { free_ast(((*yyvaluep).node)); }
+#line 1424 "parser.tab.c"
+        break;
+
+      default:
+        break;
+    }
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
@@ -890,6 +1435,12 @@ int yychar;
 
 /* The semantic value of the lookahead symbol.  */
 YYSTYPE yylval;
+/* Location data for the lookahead symbol.  */
+YYLTYPE yylloc
+# if defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL
+  = { 1, 1, 1, 1 }
+# endif
+;
 /* Number of syntax errors so far.  */
 int yynerrs;
 
@@ -923,6 +1474,11 @@ yyparse (void)
     YYSTYPE *yyvs = yyvsa;
     YYSTYPE *yyvsp = yyvs;
 
+    /* The location stack: array, bottom, top.  */
+    YYLTYPE yylsa[YYINITDEPTH];
+    YYLTYPE *yyls = yylsa;
+    YYLTYPE *yylsp = yyls;
+
   int yyn;
   /* The return value of yyparse.  */
   int yyresult;
@@ -931,10 +1487,17 @@ yyparse (void)
   /* The variables used to return semantic value and location from the
      action routines.  */
   YYSTYPE yyval;
+  YYLTYPE yyloc;
 
+  /* The locations where the error started and ended.  */
+  YYLTYPE yyerror_range[3];
 
+  /* Buffer for error messages, and its allocated size.  */
+  char yymsgbuf[128];
+  char *yymsg = yymsgbuf;
+  YYPTRDIFF_T yymsg_alloc = sizeof yymsgbuf;
 
-#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N), yylsp -= (N))
 
   /* The number of symbols on the RHS of the reduced rule.
      Keep to zero when no symbol should be popped.  */
@@ -944,6 +1507,7 @@ yyparse (void)
 
   yychar = YYEMPTY; /* Cause a token to be read.  */
 
+  yylsp[0] = yylloc;
   goto yysetstate;
 
 
@@ -982,6 +1546,7 @@ yysetstate:
            memory.  */
         yy_state_t *yyss1 = yyss;
         YYSTYPE *yyvs1 = yyvs;
+        YYLTYPE *yyls1 = yyls;
 
         /* Each stack pointer address is followed by the size of the
            data in use in that stack, in bytes.  This used to be a
@@ -990,9 +1555,11 @@ yysetstate:
         yyoverflow (YY_("memory exhausted"),
                     &yyss1, yysize * YYSIZEOF (*yyssp),
                     &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yyls1, yysize * YYSIZEOF (*yylsp),
                     &yystacksize);
         yyss = yyss1;
         yyvs = yyvs1;
+        yyls = yyls1;
       }
 # else /* defined YYSTACK_RELOCATE */
       /* Extend the stack our own way.  */
@@ -1011,6 +1578,7 @@ yysetstate:
           YYNOMEM;
         YYSTACK_RELOCATE (yyss_alloc, yyss);
         YYSTACK_RELOCATE (yyvs_alloc, yyvs);
+        YYSTACK_RELOCATE (yyls_alloc, yyls);
 #  undef YYSTACK_RELOCATE
         if (yyss1 != yyssa)
           YYSTACK_FREE (yyss1);
@@ -1019,6 +1587,7 @@ yysetstate:
 
       yyssp = yyss + yysize - 1;
       yyvsp = yyvs + yysize - 1;
+      yylsp = yyls + yysize - 1;
 
       YY_IGNORE_USELESS_CAST_BEGIN
       YYDPRINTF ((stderr, "Stack size increased to %ld\n",
@@ -1072,6 +1641,7 @@ yybackup:
          loop in error recovery. */
       yychar = YYUNDEF;
       yytoken = YYSYMBOL_YYerror;
+      yyerror_range[1] = yylloc;
       goto yyerrlab1;
     }
   else
@@ -1105,6 +1675,7 @@ yybackup:
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
   *++yyvsp = yylval;
   YY_IGNORE_MAYBE_UNINITIALIZED_END
+  *++yylsp = yylloc;
 
   /* Discard the shifted token.  */
   yychar = YYEMPTY;
@@ -1138,216 +1709,314 @@ yyreduce:
      GCC warning that YYVAL may be used uninitialized.  */
   yyval = yyvsp[1-yylen];
 
-
+  /* Default location. */
+  YYLLOC_DEFAULT (yyloc, (yylsp - yylen), yylen);
+  yyerror_range[1] = yyloc;
   YY_REDUCE_PRINT (yyn);
   switch (yyn)
     {
-  case 2: /* program: function  */
-#line 42 "parser.y"
-                                        { ast_root = (yyvsp[0].node); }
-#line 1149 "parser.tab.c"
+  case 3: /* function_list: function  */
+#line 107 "parser.y"
+                                        { append_function((yyvsp[0].node)); }
+#line 1722 "parser.tab.c"
+    break;
+
+  case 4: /* function_list: function_list function  */
+#line 108 "parser.y"
+                                        { append_function((yyvsp[0].node)); }
+#line 1728 "parser.tab.c"
+    break;
+
+  case 5: /* function: type IDENTIFIER LPAREN params RPAREN compound_stmt  */
+#line 113 "parser.y"
+                                        { free_ast((yyvsp[-5].node)); (yyval.node) = release_token(make_function_node((yyvsp[-4].str), (yyvsp[-2].node), (yyvsp[0].node)), (yyvsp[-4].str)); }
+#line 1734 "parser.tab.c"
+    break;
+
+  case 6: /* function: error RBRACE  */
+#line 114 "parser.y"
+                                        { yyerrok; (yyval.node) = NULL; }
+#line 1740 "parser.tab.c"
+    break;
+
+  case 7: /* params: param_list  */
+#line 118 "parser.y"
+                                        { (yyval.node) = (yyvsp[0].node); }
+#line 1746 "parser.tab.c"
+    break;
+
+  case 8: /* params: %empty  */
+#line 119 "parser.y"
+                                        { (yyval.node) = NULL; }
+#line 1752 "parser.tab.c"
+    break;
+
+  case 9: /* param_list: param  */
+#line 123 "parser.y"
+                                        { (yyval.node) = (yyvsp[0].node); }
+#line 1758 "parser.tab.c"
     break;
 
-  case 3: /* function: type IDENTIFIER LPAREN RPAREN compound_stmt  */
-#line 47 "parser.y"
-                                        { (yyval.node) = make_function_node((yyvsp[-3].str), (yyvsp[0].node)); }
-#line 1155 "parser.tab.c"
+  case 10: /* param_list: param_list COMMA param  */
+#line 124 "parser.y"
+                                        { add_sibling((yyvsp[-2].node), (yyvsp[0].node)); (yyval.node) = (yyvsp[-2].node); }
+#line 1764 "parser.tab.c"
     break;
 
-  case 4: /* type: KW_INT  */
-#line 51 "parser.y"
+  case 11: /* param: type IDENTIFIER  */
+#line 128 "parser.y"
+                                        { free_ast((yyvsp[-1].node)); (yyval.node) = release_token(make_param_node((yyvsp[0].str)), (yyvsp[0].str)); }
+#line 1770 "parser.tab.c"
+    break;
+
+  case 12: /* type: KW_INT  */
+#line 132 "parser.y"
                                         { (yyval.node) = make_type_node("int"); }
-#line 1161 "parser.tab.c"
+#line 1776 "parser.tab.c"
     break;
 
-  case 5: /* stmt_list: stmt  */
-#line 55 "parser.y"
+  case 13: /* stmt_list: stmt  */
+#line 136 "parser.y"
                                         { (yyval.node) = (yyvsp[0].node); }
-#line 1167 "parser.tab.c"
+#line 1782 "parser.tab.c"
     break;
 
-  case 6: /* stmt_list: stmt_list stmt  */
-#line 56 "parser.y"
-                                        { (yyval.node) = make_seq_node((yyvsp[-1].node), (yyvsp[0].node)); }
-#line 1173 "parser.tab.c"
+  case 14: /* stmt_list: stmt_list stmt  */
+#line 137 "parser.y"
+                                        { (yyval.node) = append_stmt((yyvsp[-1].node), (yyvsp[0].node)); }
+#line 1788 "parser.tab.c"
     break;
 
-  case 7: /* compound_stmt: LBRACE stmt_list RBRACE  */
-#line 60 "parser.y"
+  case 15: /* compound_stmt: LBRACE stmt_list RBRACE  */
+#line 141 "parser.y"
                                         { (yyval.node) = (yyvsp[-1].node); }
-#line 1179 "parser.tab.c"
+#line 1794 "parser.tab.c"
+    break;
+
+  case 16: /* compound_stmt: LBRACE error RBRACE  */
+#line 142 "parser.y"
+                                        { yyerrok; (yyval.node) = NULL; }
+#line 1800 "parser.tab.c"
     break;
 
-  case 8: /* stmt: decl_stmt  */
-#line 64 "parser.y"
+  case 17: /* stmt: decl_stmt  */
+#line 146 "parser.y"
                                         { (yyval.node) = (yyvsp[0].node); }
-#line 1185 "parser.tab.c"
+#line 1806 "parser.tab.c"
     break;
 
-  case 9: /* stmt: expr SEMICOLON  */
-#line 65 "parser.y"
+  case 18: /* stmt: expr SEMICOLON  */
+#line 147 "parser.y"
                                         { (yyval.node) = (yyvsp[-1].node); }
-#line 1191 "parser.tab.c"
+#line 1812 "parser.tab.c"
     break;
 
-  case 10: /* stmt: if_stmt  */
-#line 66 "parser.y"
+  case 19: /* stmt: if_stmt  */
+#line 148 "parser.y"
                                         { (yyval.node) = (yyvsp[0].node); }
-#line 1197 "parser.tab.c"
+#line 1818 "parser.tab.c"
     break;
 
-  case 11: /* stmt: for_stmt  */
-#line 67 "parser.y"
+  case 20: /* stmt: for_stmt  */
+#line 149 "parser.y"
                                         { (yyval.node) = (yyvsp[0].node); }
-#line 1203 "parser.tab.c"
+#line 1824 "parser.tab.c"
     break;
 
-  case 12: /* stmt: return_stmt  */
-#line 68 "parser.y"
+  case 21: /* stmt: return_stmt  */
+#line 150 "parser.y"
                                         { (yyval.node) = (yyvsp[0].node); }
-#line 1209 "parser.tab.c"
+#line 1830 "parser.tab.c"
+    break;
+
+  case 22: /* stmt: error SEMICOLON  */
+#line 151 "parser.y"
+                                        { yyerrok; (yyval.node) = NULL; }
+#line 1836 "parser.tab.c"
+    break;
+
+  case 23: /* stmt: error compound_stmt  */
+#line 152 "parser.y"
+                                        { yyerrok; free_ast((yyvsp[0].node)); (yyval.node) = NULL; }
+#line 1842 "parser.tab.c"
     break;
 
-  case 13: /* decl_stmt: KW_INT IDENTIFIER ASSIGN expr SEMICOLON  */
-#line 73 "parser.y"
-                                        { (yyval.node) = make_decl_node((yyvsp[-3].str), (yyvsp[-1].node)); }
-#line 1215 "parser.tab.c"
+  case 24: /* decl_stmt: KW_INT IDENTIFIER ASSIGN expr SEMICOLON  */
+#line 157 "parser.y"
+                                        { (yyval.node) = release_token(make_decl_node((yyvsp[-3].str), (yyvsp[-1].node)), (yyvsp[-3].str)); }
+#line 1848 "parser.tab.c"
     break;
 
-  case 14: /* decl_stmt: KW_INT IDENTIFIER SEMICOLON  */
-#line 74 "parser.y"
-                                        { (yyval.node) = make_decl_node((yyvsp[-1].str), NULL); }
-#line 1221 "parser.tab.c"
+  case 25: /* decl_stmt: KW_INT IDENTIFIER SEMICOLON  */
+#line 158 "parser.y"
+                                        { (yyval.node) = release_token(make_decl_node((yyvsp[-1].str), NULL), (yyvsp[-1].str)); }
+#line 1854 "parser.tab.c"
     break;
 
-  case 15: /* if_stmt: KW_IF LPAREN expr RPAREN compound_stmt  */
-#line 79 "parser.y"
+  case 26: /* if_stmt: KW_IF LPAREN expr RPAREN compound_stmt  */
+#line 163 "parser.y"
                                         { (yyval.node) = make_if_node((yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1227 "parser.tab.c"
+#line 1860 "parser.tab.c"
     break;
 
-  case 16: /* for_init: KW_INT IDENTIFIER ASSIGN expr  */
-#line 83 "parser.y"
-                                        { (yyval.node) = make_decl_node((yyvsp[-2].str), (yyvsp[0].node)); }
-#line 1233 "parser.tab.c"
+  case 27: /* for_init: KW_INT IDENTIFIER ASSIGN expr  */
+#line 167 "parser.y"
+                                        { (yyval.node) = release_token(make_decl_node((yyvsp[-2].str), (yyvsp[0].node)), (yyvsp[-2].str)); }
+#line 1866 "parser.tab.c"
     break;
 
-  case 17: /* for_init: KW_INT IDENTIFIER  */
-#line 84 "parser.y"
-                                        { (yyval.node) = make_decl_node((yyvsp[0].str), NULL); }
-#line 1239 "parser.tab.c"
+  case 28: /* for_init: KW_INT IDENTIFIER  */
+#line 168 "parser.y"
+                                        { (yyval.node) = release_token(make_decl_node((yyvsp[0].str), NULL), (yyvsp[0].str)); }
+#line 1872 "parser.tab.c"
     break;
 
-  case 18: /* for_init: expr  */
-#line 85 "parser.y"
+  case 29: /* for_init: expr  */
+#line 169 "parser.y"
                                         { (yyval.node) = (yyvsp[0].node); }
-#line 1245 "parser.tab.c"
+#line 1878 "parser.tab.c"
     break;
 
-  case 19: /* for_init: %empty  */
-#line 86 "parser.y"
+  case 30: /* for_init: %empty  */
+#line 170 "parser.y"
                                         { (yyval.node) = NULL; }
-#line 1251 "parser.tab.c"
+#line 1884 "parser.tab.c"
     break;
 
-  case 20: /* for_stmt: KW_FOR LPAREN for_init SEMICOLON expr SEMICOLON expr RPAREN compound_stmt  */
-#line 91 "parser.y"
+  case 31: /* for_stmt: KW_FOR LPAREN for_init SEMICOLON expr SEMICOLON expr RPAREN compound_stmt  */
+#line 175 "parser.y"
                                         { (yyval.node) = make_for_node((yyvsp[-6].node), (yyvsp[-4].node), (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1257 "parser.tab.c"
+#line 1890 "parser.tab.c"
     break;
 
-  case 21: /* return_stmt: KW_RETURN expr SEMICOLON  */
-#line 95 "parser.y"
+  case 32: /* return_stmt: KW_RETURN expr SEMICOLON  */
+#line 179 "parser.y"
                                         { (yyval.node) = make_return_node((yyvsp[-1].node)); }
-#line 1263 "parser.tab.c"
+#line 1896 "parser.tab.c"
     break;
 
-  case 22: /* expr: expr PLUS expr  */
-#line 99 "parser.y"
-                                        { (yyval.node) = make_binop_node('+', (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1269 "parser.tab.c"
+  case 33: /* expr: IDENTIFIER ASSIGN expr  */
+#line 183 "parser.y"
+                                        { (yyval.node) = release_token(make_assign_node((yyvsp[-2].str), (yyvsp[0].node)), (yyvsp[-2].str)); }
+#line 1902 "parser.tab.c"
     break;
 
-  case 23: /* expr: expr MINUS expr  */
-#line 100 "parser.y"
-                                        { (yyval.node) = make_binop_node('-', (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1275 "parser.tab.c"
+  case 34: /* expr: expr PLUS expr  */
+#line 184 "parser.y"
+                                        { (yyval.node) = make_binop_node("+", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1908 "parser.tab.c"
     break;
 
-  case 24: /* expr: expr MUL expr  */
-#line 101 "parser.y"
-                                        { (yyval.node) = make_binop_node('*', (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1281 "parser.tab.c"
+  case 35: /* expr: expr MINUS expr  */
+#line 185 "parser.y"
+                                        { (yyval.node) = make_binop_node("-", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1914 "parser.tab.c"
     break;
 
-  case 25: /* expr: expr DIV expr  */
-#line 102 "parser.y"
-                                        { (yyval.node) = make_binop_node('/', (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1287 "parser.tab.c"
+  case 36: /* expr: expr MUL expr  */
+#line 186 "parser.y"
+                                        { (yyval.node) = make_binop_node("*", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1920 "parser.tab.c"
     break;
 
-  case 26: /* expr: expr LT expr  */
-#line 103 "parser.y"
-                                        { (yyval.node) = make_binop_node('<', (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1293 "parser.tab.c"
+  case 37: /* expr: expr DIV expr  */
+#line 187 "parser.y"
+                                        { (yyval.node) = make_binop_node("/", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1926 "parser.tab.c"
     break;
 
-  case 27: /* expr: IDENTIFIER INCR  */
-#line 104 "parser.y"
-                                        { (yyval.node) = make_unary_node("++", make_var_node((yyvsp[-1].str))); }
-#line 1299 "parser.tab.c"
+  case 38: /* expr: expr LT expr  */
+#line 188 "parser.y"
+                                        { (yyval.node) = make_binop_node("<", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1932 "parser.tab.c"
     break;
 
-  case 28: /* expr: IDENTIFIER DECR  */
-#line 105 "parser.y"
-                                        { (yyval.node) = make_unary_node("--", make_var_node((yyvsp[-1].str))); }
-#line 1305 "parser.tab.c"
+  case 39: /* expr: expr LE expr  */
+#line 189 "parser.y"
+                                        { (yyval.node) = make_binop_node("<=", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1938 "parser.tab.c"
     break;
 
-  case 29: /* expr: NUMBER  */
-#line 106 "parser.y"
+  case 40: /* expr: expr GT expr  */
+#line 190 "parser.y"
+                                        { (yyval.node) = make_binop_node(">", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1944 "parser.tab.c"
+    break;
+
+  case 41: /* expr: expr GE expr  */
+#line 191 "parser.y"
+                                        { (yyval.node) = make_binop_node(">=", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1950 "parser.tab.c"
+    break;
+
+  case 42: /* expr: expr EQ expr  */
+#line 192 "parser.y"
+                                        { (yyval.node) = make_binop_node("==", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1956 "parser.tab.c"
+    break;
+
+  case 43: /* expr: expr NE expr  */
+#line 193 "parser.y"
+                                        { (yyval.node) = make_binop_node("!=", (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1962 "parser.tab.c"
+    break;
+
+  case 44: /* expr: IDENTIFIER INCR  */
+#line 194 "parser.y"
+                                        { (yyval.node) = make_unary_node("++", release_token(make_var_node((yyvsp[-1].str)), (yyvsp[-1].str))); }
+#line 1968 "parser.tab.c"
+    break;
+
+  case 45: /* expr: IDENTIFIER DECR  */
+#line 195 "parser.y"
+                                        { (yyval.node) = make_unary_node("--", release_token(make_var_node((yyvsp[-1].str)), (yyvsp[-1].str))); }
+#line 1974 "parser.tab.c"
+    break;
+
+  case 46: /* expr: NUMBER  */
+#line 196 "parser.y"
                                         { (yyval.node) = make_int_node((yyvsp[0].ival)); }
-#line 1311 "parser.tab.c"
+#line 1980 "parser.tab.c"
     break;
 
-  case 30: /* expr: STRING  */
-#line 107 "parser.y"
-                                        { (yyval.node) = make_string_node((yyvsp[0].str)); }
-#line 1317 "parser.tab.c"
+  case 47: /* expr: STRING  */
+#line 197 "parser.y"
+                                        { (yyval.node) = release_token(make_string_node((yyvsp[0].str)), (yyvsp[0].str)); }
+#line 1986 "parser.tab.c"
     break;
 
-  case 31: /* expr: IDENTIFIER  */
-#line 108 "parser.y"
-                                        { (yyval.node) = make_var_node((yyvsp[0].str)); }
-#line 1323 "parser.tab.c"
+  case 48: /* expr: IDENTIFIER  */
+#line 198 "parser.y"
+                                        { (yyval.node) = release_token(make_var_node((yyvsp[0].str)), (yyvsp[0].str)); }
+#line 1992 "parser.tab.c"
     break;
 
-  case 32: /* expr: IDENTIFIER LPAREN RPAREN  */
-#line 109 "parser.y"
-                                        { (yyval.node) = make_func_call_node((yyvsp[-2].str), NULL); }
-#line 1329 "parser.tab.c"
+  case 49: /* expr: IDENTIFIER LPAREN RPAREN  */
+#line 199 "parser.y"
+                                        { (yyval.node) = release_token(make_func_call_node((yyvsp[-2].str), NULL), (yyvsp[-2].str)); }
+#line 1998 "parser.tab.c"
     break;
 
-  case 33: /* expr: IDENTIFIER LPAREN expr_list RPAREN  */
-#line 111 "parser.y"
-                                        { (yyval.node) = make_func_call_node((yyvsp[-3].str), (yyvsp[-1].node)); }
-#line 1335 "parser.tab.c"
+  case 50: /* expr: IDENTIFIER LPAREN expr_list RPAREN  */
+#line 201 "parser.y"
+                                        { (yyval.node) = release_token(make_func_call_node((yyvsp[-3].str), (yyvsp[-1].node)), (yyvsp[-3].str)); }
+#line 2004 "parser.tab.c"
     break;
 
-  case 34: /* expr_list: expr  */
-#line 115 "parser.y"
+  case 51: /* expr_list: expr  */
+#line 205 "parser.y"
                                         { (yyval.node) = make_expr_list_node((yyvsp[0].node), NULL); }
-#line 1341 "parser.tab.c"
+#line 2010 "parser.tab.c"
     break;
 
-  case 35: /* expr_list: expr_list COMMA expr  */
-#line 116 "parser.y"
-                                        { (yyval.node) = make_expr_list_node((yyvsp[0].node), (yyvsp[-2].node)); }
-#line 1347 "parser.tab.c"
+  case 52: /* expr_list: expr_list COMMA expr  */
+#line 206 "parser.y"
+                                        { add_sibling((yyvsp[-2].node), make_expr_list_node((yyvsp[0].node), NULL)); (yyval.node) = (yyvsp[-2].node); }
+#line 2016 "parser.tab.c"
     break;
 
 
-#line 1351 "parser.tab.c"
+#line 2020 "parser.tab.c"
 
       default: break;
     }
@@ -1368,6 +2037,7 @@ yyreduce:
   yylen = 0;
 
   *++yyvsp = yyval;
+  *++yylsp = yyloc;
 
   /* Now 'shift' the result of the reduction.  Determine what state
      that goes to, based on the state we popped back to and the rule
@@ -1394,9 +2064,40 @@ yyerrlab:
   if (!yyerrstatus)
     {
       ++yynerrs;
-      yyerror (YY_("syntax error"));
+      {
+        yypcontext_t yyctx
+          = {yyssp, yytoken, &yylloc};
+        char const *yymsgp = YY_("syntax error");
+        int yysyntax_error_status;
+        yysyntax_error_status = yysyntax_error (&yymsg_alloc, &yymsg, &yyctx);
+        if (yysyntax_error_status == 0)
+          yymsgp = yymsg;
+        else if (yysyntax_error_status == -1)
+          {
+            if (yymsg != yymsgbuf)
+              YYSTACK_FREE (yymsg);
+            yymsg = YY_CAST (char *,
+                             YYSTACK_ALLOC (YY_CAST (YYSIZE_T, yymsg_alloc)));
+            if (yymsg)
+              {
+                yysyntax_error_status
+                  = yysyntax_error (&yymsg_alloc, &yymsg, &yyctx);
+                yymsgp = yymsg;
+              }
+            else
+              {
+                yymsg = yymsgbuf;
+                yymsg_alloc = sizeof yymsgbuf;
+                yysyntax_error_status = YYENOMEM;
+              }
+          }
+        yyerror (yymsgp);
+        if (yysyntax_error_status == YYENOMEM)
+          YYNOMEM;
+      }
     }
 
+  yyerror_range[1] = yylloc;
   if (yyerrstatus == 3)
     {
       /* If just tried and failed to reuse lookahead token after an
@@ -1411,7 +2112,7 @@ yyerrlab:
       else
         {
           yydestruct ("Error: discarding",
-                      yytoken, &yylval);
+                      yytoken, &yylval, &yylloc);
           yychar = YYEMPTY;
         }
     }
@@ -1465,9 +2166,9 @@ yyerrlab1:
       if (yyssp == yyss)
         YYABORT;
 
-
+      yyerror_range[1] = *yylsp;
       yydestruct ("Error: popping",
-                  YY_ACCESSING_SYMBOL (yystate), yyvsp);
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, yylsp);
       YYPOPSTACK (1);
       yystate = *yyssp;
       YY_STACK_PRINT (yyss, yyssp);
@@ -1477,6 +2178,9 @@ yyerrlab1:
   *++yyvsp = yylval;
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 
+  yyerror_range[2] = yylloc;
+  ++yylsp;
+  YYLLOC_DEFAULT (*yylsp, yyerror_range, 2);
 
   /* Shift the error token.  */
   YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
@@ -1520,7 +2224,7 @@ yyreturnlab:
          user semantic actions for why this is necessary.  */
       yytoken = YYTRANSLATE (yychar);
       yydestruct ("Cleanup: discarding lookahead",
-                  yytoken, &yylval);
+                  yytoken, &yylval, &yylloc);
     }
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYABORT or YYACCEPT.  */
@@ -1529,14 +2233,40 @@ yyreturnlab:
   while (yyssp != yyss)
     {
       yydestruct ("Cleanup: popping",
-                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp);
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, yylsp);
       YYPOPSTACK (1);
     }
 #ifndef yyoverflow
   if (yyss != yyssa)
     YYSTACK_FREE (yyss);
 #endif
-
+  if (yymsg != yymsgbuf)
+    YYSTACK_FREE (yymsg);
   return yyresult;
 }
 
+#line 209 "parser.y"
+
+
+// Nodes the grammar builds are charged to the parser
+int parse_program(void) {
+    MemSubsystem caller = mem_enter(MEM_PARSER);
+    last_function = NULL;
+    int status = yyparse();
+    mem_enter(caller);
+    return status;
+}
+
+
+void yyerror(const char* s) {
+    parse_error_count++;
+
+    FILE* output = parse_error_output ? parse_error_output : stderr;
+    int line = 0;
+    int column = 0;
+    if (srcloc_lookup(yylloc.first, &line, &column)) {
+        fprintf(output, "%s:%d:%d: Parse error: %s\n", srcloc_name(), line, column, s);
+    } else {
+        fprintf(output, "Parse error: %s\n", s);
+    }
+}
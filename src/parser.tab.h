@@ -49,7 +49,15 @@ extern int yydebug;
 
     #include "ast.h"
 
-#line 53 "parser.tab.h"
+    typedef struct {
+        uint32_t first;
+        uint32_t last;
+    } SrcSpan;
+
+    #define YYLTYPE SrcSpan
+    #define YYLTYPE_IS_DECLARED 1
+
+#line 61 "parser.tab.h"
 
 /* Token kinds.  */
 #ifndef YYTOKENTYPE
@@ -79,8 +87,13 @@ extern int yydebug;
     MUL = 274,                     /* MUL  */
     DIV = 275,                     /* DIV  */
     LT = 276,                      /* LT  */
-    INCR = 277,                    /* INCR  */
-    DECR = 278                     /* DECR  */
+    LE = 277,                      /* LE  */
+    GT = 278,                      /* GT  */
+    GE = 279,                      /* GE  */
+    EQ = 280,                      /* EQ  */
+    NE = 281,                      /* NE  */
+    INCR = 282,                    /* INCR  */
+    DECR = 283                     /* DECR  */
   };
   typedef enum yytokentype yytoken_kind_t;
 #endif
@@ -89,13 +102,13 @@ extern int yydebug;
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
 union YYSTYPE
 {
-#line 15 "parser.y"
+#line 68 "parser.y"
 
     int ival;
     char* str;
     ASTNode* node;
 
-#line 99 "parser.tab.h"
+#line 112 "parser.tab.h"
 
 };
 typedef union YYSTYPE YYSTYPE;
@@ -103,9 +116,23 @@ typedef union YYSTYPE YYSTYPE;
 # define YYSTYPE_IS_DECLARED 1
 #endif
 
+/* Location type.  */
+#if ! defined YYLTYPE && ! defined YYLTYPE_IS_DECLARED
+typedef struct YYLTYPE YYLTYPE;
+struct YYLTYPE
+{
+  int first_line;
+  int first_column;
+  int last_line;
+  int last_column;
+};
+# define YYLTYPE_IS_DECLARED 1
+# define YYLTYPE_IS_TRIVIAL 1
+#endif
 
-extern YYSTYPE yylval;
 
+extern YYSTYPE yylval;
+extern YYLTYPE yylloc;
 
 int yyparse (void);
 
@@ -1,17 +1,70 @@
 %code requires {
     #include "ast.h"
+
+    typedef struct {
+        uint32_t first;
+        uint32_t last;
+    } SrcSpan;
+
+    #define YYLTYPE SrcSpan
+    #define YYLTYPE_IS_DECLARED 1
 }
 
 %{
 #include <stdio.h>
 #include "ast.h"
+#include "memtrack.h"
+#include "srcloc.h"
+
+/* Spans are byte offsets; every reduction also tells create_node() where
+   the rule started so nodes are stamped without touching the actions. */
+#define YYLLOC_DEFAULT(Cur, Rhs, N)                          \
+    do {                                                     \
+        if (N) {                                             \
+            (Cur).first = YYRHSLOC(Rhs, 1).first;            \
+            (Cur).last = YYRHSLOC(Rhs, N).last;              \
+        } else {                                             \
+            (Cur).first = (Cur).last = YYRHSLOC(Rhs, 0).last; \
+        }                                                    \
+        ast_set_location((Cur).first);                       \
+    } while (0)
 
 extern int yylex();
-void yyerror(const char* s) { fprintf(stderr, "Parse error: %s\n", s); }
 
-ASTNode* ast_root;
+void yyerror(const char* s);
+
+ASTNode* ast_root = NULL;
+int parse_error_count = 0;
+FILE* parse_error_output = NULL;    // stderr when NULL
+
+// Statements dropped by error recovery come back as NULL.
+static ASTNode* append_stmt(ASTNode* list, ASTNode* stmt) {
+    if (!list) return stmt;
+    if (!stmt) return list;
+    return make_seq_node(list, stmt);
+}
+
+/* Functions are linked through `next` under ast_root rather than nested in
+   SEQ nodes, so each one sits at the top of the tree however many precede it. */
+static ASTNode* last_function = NULL;
+
+static void append_function(ASTNode* function) {
+    if (!function) return;
+    if (last_function) last_function->next = function;
+    else ast_root = function;
+    last_function = function;
+}
+
+// Nodes copy their text, so the token's own copy goes once the node exists
+static ASTNode* release_token(ASTNode* node, char* text) {
+    mem_free_string(MEM_LEXER, text);
+    return node;
+}
 %}
 
+%locations
+%define parse.error verbose
+
 %union {
     int ival;
     char* str;
@@ -24,13 +77,19 @@ ASTNode* ast_root;
 
 %token KW_INT KW_IF KW_FOR KW_RETURN
 %token LPAREN RPAREN LBRACE RBRACE SEMICOLON ASSIGN COMMA
-%token PLUS MINUS MUL DIV LT
+%token PLUS MINUS MUL DIV LT LE GT GE EQ NE
 %token INCR DECR
 
 %type <node> stmt stmt_list compound_stmt expr expr_list decl_stmt
-               if_stmt for_stmt return_stmt function type program for_init
+               if_stmt for_stmt return_stmt function type for_init
+               params param_list param
+
+%destructor { free_ast($$); } <node>
+%destructor { mem_free_string(MEM_LEXER, $$); } <str>
 
-%left LT
+%right ASSIGN
+%left EQ NE
+%left LT LE GT GE
 %left PLUS MINUS
 %left MUL DIV
 
@@ -39,12 +98,34 @@ ASTNode* ast_root;
 %%
 
 program:
-      function                          { ast_root = $1; }
+      function_list
+    ;
+
+/* Functions go straight into ast_root, so the ones parsed before an
+   unrecoverable error survive the abort. */
+function_list:
+      function                          { append_function($1); }
+    | function_list function            { append_function($2); }
     ;
 
 function:
-      type IDENTIFIER LPAREN RPAREN compound_stmt
-                                        { $$ = make_function_node($2, $5); }
+      type IDENTIFIER LPAREN params RPAREN compound_stmt
+                                        { free_ast($1); $$ = release_token(make_function_node($2, $4, $6), $2); }
+    | error RBRACE                      { yyerrok; $$ = NULL; }
+    ;
+
+params:
+      param_list                        { $$ = $1; }
+    | /* empty */                       { $$ = NULL; }
+    ;
+
+param_list:
+      param                             { $$ = $1; }
+    | param_list COMMA param            { add_sibling($1, $3); $$ = $1; }
+    ;
+
+param:
+      type IDENTIFIER                   { free_ast($1); $$ = release_token(make_param_node($2), $2); }
     ;
 
 type:
@@ -53,11 +134,12 @@ type:
 
 stmt_list:
       stmt                              { $$ = $1; }
-    | stmt_list stmt                    { $$ = make_seq_node($1, $2); }
+    | stmt_list stmt                    { $$ = append_stmt($1, $2); }
     ;
 
 compound_stmt:
       LBRACE stmt_list RBRACE           { $$ = $2; }
+    | LBRACE error RBRACE               { yyerrok; $$ = NULL; }
     ;
 
 stmt:
@@ -66,12 +148,14 @@ stmt:
     | if_stmt                           { $$ = $1; }
     | for_stmt                          { $$ = $1; }
     | return_stmt                       { $$ = $1; }
+    | error SEMICOLON                   { yyerrok; $$ = NULL; }
+    | error compound_stmt               { yyerrok; free_ast($2); $$ = NULL; }
     ;
 
 decl_stmt:
       KW_INT IDENTIFIER ASSIGN expr SEMICOLON
-                                        { $$ = make_decl_node($2, $4); }
-    | KW_INT IDENTIFIER SEMICOLON       { $$ = make_decl_node($2, NULL); }
+                                        { $$ = release_token(make_decl_node($2, $4), $2); }
+    | KW_INT IDENTIFIER SEMICOLON       { $$ = release_token(make_decl_node($2, NULL), $2); }
     ;
 
 if_stmt:
@@ -80,8 +164,8 @@ if_stmt:
     ;
 
 for_init:
-      KW_INT IDENTIFIER ASSIGN expr     { $$ = make_decl_node($2, $4); }
-    | KW_INT IDENTIFIER                 { $$ = make_decl_node($2, NULL); }
+      KW_INT IDENTIFIER ASSIGN expr     { $$ = release_token(make_decl_node($2, $4), $2); }
+    | KW_INT IDENTIFIER                 { $$ = release_token(make_decl_node($2, NULL), $2); }
     | expr                              { $$ = $1; }
     | /* empty */                       { $$ = NULL; }
     ;
@@ -96,22 +180,53 @@ return_stmt:
     ;
 
 expr:
-      expr PLUS expr                    { $$ = make_binop_node('+', $1, $3); }
-    | expr MINUS expr                   { $$ = make_binop_node('-', $1, $3); }
-    | expr MUL expr                     { $$ = make_binop_node('*', $1, $3); }
-    | expr DIV expr                     { $$ = make_binop_node('/', $1, $3); }
-    | expr LT expr                      { $$ = make_binop_node('<', $1, $3); }
-    | IDENTIFIER INCR                   { $$ = make_unary_node("++", make_var_node($1)); }
-    | IDENTIFIER DECR                   { $$ = make_unary_node("--", make_var_node($1)); }
+      IDENTIFIER ASSIGN expr            { $$ = release_token(make_assign_node($1, $3), $1); }
+    | expr PLUS expr                    { $$ = make_binop_node("+", $1, $3); }
+    | expr MINUS expr                   { $$ = make_binop_node("-", $1, $3); }
+    | expr MUL expr                     { $$ = make_binop_node("*", $1, $3); }
+    | expr DIV expr                     { $$ = make_binop_node("/", $1, $3); }
+    | expr LT expr                      { $$ = make_binop_node("<", $1, $3); }
+    | expr LE expr                      { $$ = make_binop_node("<=", $1, $3); }
+    | expr GT expr                      { $$ = make_binop_node(">", $1, $3); }
+    | expr GE expr                      { $$ = make_binop_node(">=", $1, $3); }
+    | expr EQ expr                      { $$ = make_binop_node("==", $1, $3); }
+    | expr NE expr                      { $$ = make_binop_node("!=", $1, $3); }
+    | IDENTIFIER INCR                   { $$ = make_unary_node("++", release_token(make_var_node($1), $1)); }
+    | IDENTIFIER DECR                   { $$ = make_unary_node("--", release_token(make_var_node($1), $1)); }
     | NUMBER                            { $$ = make_int_node($1); }
-    | STRING                            { $$ = make_string_node($1); }
-    | IDENTIFIER                        { $$ = make_var_node($1); }
-    | IDENTIFIER LPAREN RPAREN          { $$ = make_func_call_node($1, NULL); }
+    | STRING                            { $$ = release_token(make_string_node($1), $1); }
+    | IDENTIFIER                        { $$ = release_token(make_var_node($1), $1); }
+    | IDENTIFIER LPAREN RPAREN          { $$ = release_token(make_func_call_node($1, NULL), $1); }
     | IDENTIFIER LPAREN expr_list RPAREN
-                                        { $$ = make_func_call_node($1, $3); }
+                                        { $$ = release_token(make_func_call_node($1, $3), $1); }
     ;
 
 expr_list:
       expr                              { $$ = make_expr_list_node($1, NULL); }
-    | expr_list COMMA expr              { $$ = make_expr_list_node($3, $1); }
-    ;
\ No newline at end of file
+    | expr_list COMMA expr              { add_sibling($1, make_expr_list_node($3, NULL)); $$ = $1; }
+    ;
+
+%%
+
+// Nodes the grammar builds are charged to the parser
+int parse_program(void) {
+    MemSubsystem caller = mem_enter(MEM_PARSER);
+    last_function = NULL;
+    int status = yyparse();
+    mem_enter(caller);
+    return status;
+}
+
+
+void yyerror(const char* s) {
+    parse_error_count++;
+
+    FILE* output = parse_error_output ? parse_error_output : stderr;
+    int line = 0;
+    int column = 0;
+    if (srcloc_lookup(yylloc.first, &line, &column)) {
+        fprintf(output, "%s:%d:%d: Parse error: %s\n", srcloc_name(), line, column, s);
+    } else {
+        fprintf(output, "Parse error: %s\n", s);
+    }
+}
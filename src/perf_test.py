@@ -0,0 +1,120 @@
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+
+# input.c itself, then generated programs from a few KB up to about 3 MB
+CORPUS = [
+    ("input", ["--source", "input.c"], 20),
+    ("gen-10", ["--functions", "10"], 20),
+    ("gen-100", ["--functions", "100"], 10),
+    ("gen-1000", ["--functions", "1000"], 3),
+    ("gen-4000", ["--functions", "4000"], 2),
+]
+
+TIMED_PHASES = ("lex", "parse", "optimize", "ir_lower", "ir_optimize", "ir_emit")
+
+# Timings below this many ns are too noisy to compare as a ratio
+TIME_FLOOR_NS = 200000
+
+def host_key():
+    # Timings only compare on the same hardware, so baselines are kept per CPU
+    model = platform.processor() or platform.machine()
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    model = line.split(":", 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    return f"{model}, {os.cpu_count()} CPUs"
+
+def run_case(bench, args, repeat):
+    # The print phases grow quadratically with the program, so they are skipped
+    command = [bench, "--no-report", "--repeat", str(repeat)] + args
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.exit(f"{' '.join(command)} failed:\n{result.stderr}")
+    report = json.loads(result.stdout)
+
+    phases = report["phases"]
+    measures = {f"{phase}_ns": phases[phase]["ns"] for phase in TIMED_PHASES}
+    measures["peak_rss_kb"] = max(phase["peak_rss_kb"] for phase in phases.values())
+    measures["output_bytes"] = phases["ir_emit"]["output_bytes"]
+    measures["optimized_nodes"] = report["optimized_nodes"]
+    return measures
+
+def compare(name, measures, baseline, time_threshold, size_threshold):
+    regressions = []
+    for key, value in measures.items():
+        if key not in baseline:
+            continue
+        old = baseline[key]
+        if key.endswith("_ns"):
+            limit = max(old * (1 + time_threshold / 100), old + TIME_FLOOR_NS)
+        else:
+            limit = old * (1 + size_threshold / 100)
+        change = (value - old) * 100 / old if old else 0.0
+        status = "REGRESSED" if value > limit else "ok"
+        print(f"  {key:<18} {old:>14} -> {value:>14} {change:+7.1f}%  {status}")
+        if value > limit:
+            regressions.append(f"{name}: {key}")
+    return regressions
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare the pipeline's timings, RSS and output sizes against stored baselines")
+    parser.add_argument("--bench", default="./bench")
+    parser.add_argument("--baseline", default="perf_baseline.json")
+    parser.add_argument("--time-threshold", type=float, default=25, help="percent slower a phase may get")
+    parser.add_argument("--size-threshold", type=float, default=10, help="percent larger RSS and output may get")
+    parser.add_argument("--case", action="append", help="run only this corpus entry (repeatable)")
+    parser.add_argument("--update", action="store_true", help="record the results as the new baseline")
+    parser.add_argument("--host", default=host_key(), help="machine the baselines belong to")
+    options = parser.parse_args()
+
+    hosts = {}
+    if os.path.exists(options.baseline):
+        with open(options.baseline) as f:
+            hosts = json.load(f)["hosts"]
+    elif not options.update:
+        sys.exit(f"{options.baseline} not found; record one with --update")
+
+    if options.host not in hosts and not options.update:
+        print(f"no baseline for host '{options.host}', skipping; record one with --update")
+        for host in sorted(hosts):
+            print(f"  have: {host}")
+        return 0
+    baselines = hosts.setdefault(options.host, {})
+
+    regressions = []
+    for name, args, repeat in CORPUS:
+        if options.case and name not in options.case:
+            continue
+        print(name)
+        measures = run_case(options.bench, args, repeat)
+        if options.update:
+            baselines[name] = measures
+            for key, value in measures.items():
+                print(f"  {key:<18} {value:>14}")
+        elif name in baselines:
+            regressions += compare(name, measures, baselines[name],
+                                   options.time_threshold, options.size_threshold)
+        else:
+            print("  no baseline")
+
+    if options.update:
+        with open(options.baseline, "w") as f:
+            json.dump({"hosts": hosts}, f, indent=2, sort_keys=True)
+            f.write("\n")
+        return 0
+
+    if regressions:
+        print(f"\n{len(regressions)} regression(s): " + ", ".join(regressions))
+        return 1
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
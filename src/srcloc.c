@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "srcloc.h"
+
+
+static char* source_name = NULL;
+static char* source_text = NULL;
+static size_t source_length = 0;
+static int from_file = 0;
+
+static uint32_t* line_starts = NULL;
+static int line_count = 0;
+
+
+static void* srcloc_alloc(void* ptr, size_t size) {
+    void* mem = realloc(ptr, size);
+    if (!mem) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return mem;
+}
+
+
+void srcloc_reset(void) {
+    free(source_name);
+    free(source_text);
+    free(line_starts);
+    source_name = NULL;
+    source_text = NULL;
+    source_length = 0;
+    from_file = 0;
+    line_starts = NULL;
+    line_count = 0;
+}
+
+
+void srcloc_set_file(const char* path) {
+    srcloc_reset();
+    source_name = strdup(path);
+    from_file = 1;
+}
+
+
+void srcloc_set_text(const char* name, const char* text, size_t length) {
+    srcloc_reset();
+    source_name = strdup(name);
+    source_text = srcloc_alloc(NULL, length ? length : 1);
+    memcpy(source_text, text, length);
+    source_length = length;
+}
+
+
+const char* srcloc_name(void) {
+    return source_name ? source_name : "<input>";
+}
+
+
+static int load_file(void) {
+    FILE* file = fopen(source_name, "rb");
+    if (!file) return 0;
+
+    size_t capacity = 4096;
+    size_t n;
+    source_text = srcloc_alloc(NULL, capacity);
+    while ((n = fread(source_text + source_length, 1, capacity - source_length, file)) > 0) {
+        source_length += n;
+        if (source_length == capacity) {
+            capacity *= 2;
+            source_text = srcloc_alloc(source_text, capacity);
+        }
+    }
+
+    fclose(file);
+    return 1;
+}
+
+
+static void build_line_table(void) {
+    if (from_file && !source_text && !load_file()) return;
+    if (!source_text) return;
+
+    int capacity = 64;
+    line_starts = srcloc_alloc(NULL, capacity * sizeof(uint32_t));
+    line_starts[line_count++] = 0;
+
+    for (size_t i = 0; i < source_length; i++) {
+        if (source_text[i] != '\n') continue;
+        if (line_count == capacity) {
+            capacity *= 2;
+            line_starts = srcloc_alloc(line_starts, capacity * sizeof(uint32_t));
+        }
+        line_starts[line_count++] = (uint32_t)(i + 1);
+    }
+}
+
+
+int srcloc_lookup(uint32_t offset, int* line, int* column) {
+    if (!line_starts) build_line_table();
+    if (!line_starts) return 0;
+
+    int lo = 0;
+    int hi = line_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (line_starts[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    *line = lo + 1;
+    *column = (int)(offset - line_starts[lo]) + 1;
+    return 1;
+}
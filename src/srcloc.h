@@ -0,0 +1,21 @@
+#ifndef SRCLOC_H
+#define SRCLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Nodes and tokens only carry a 32-bit byte offset into the source. The
+   offset -> line:column table is built on the first lookup and only for
+   sources that are actually reported on. */
+
+void srcloc_set_file(const char* path);
+
+void srcloc_set_text(const char* name, const char* text, size_t length);
+
+const char* srcloc_name(void);
+
+int srcloc_lookup(uint32_t offset, int* line, int* column);
+
+void srcloc_reset(void);
+
+#endif
@@ -0,0 +1,949 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include "ast.h"
+#include "ast_store.h"
+#include "cfg.h"
+#include "dependence.h"
+#include "incremental.h"
+#include "ir.h"
+#include "memtrack.h"
+#include "srcloc.h"
+#include "visitor.h"
+
+extern ASTNode* ast_root;
+extern int parse_error_count;
+int parse_program(void);
+void lexer_set_text(const char* text, size_t length);
+
+
+/* Behavioural tests of the passes and regression tests for bugs that
+   slipped through review. Each test returns whether it passed and says
+   why not on stderr; ./tests exits with the number of failures. */
+
+typedef struct {
+    const char* name;
+    bool (*run)(void);
+} Test;
+
+
+static bool expect(bool ok, const char* what) {
+    if (!ok) fprintf(stderr, "  %s\n", what);
+    return ok;
+}
+
+
+static ASTNode* parse_text(const char* text) {
+    ast_reset_ids();
+    ast_root = NULL;
+    parse_error_count = 0;
+    srcloc_set_text("test.c", text, strlen(text));
+    lexer_set_text(text, strlen(text));
+    parse_program();
+    ASTNode* root = ast_root;
+    ast_root = NULL;
+    return parse_error_count == 0 ? root : NULL;
+}
+
+
+// print_ast() output in a malloc'ed string
+static char* tree_text(ASTNode* root) {
+    char* text = NULL;
+    size_t length = 0;
+    FILE* output = open_memstream(&text, &length);
+    print_ast(root, output, 0);
+    fclose(output);
+    return text;
+}
+
+
+// Runs the whole pipeline; a crash fails every test after it too
+static bool optimize_and_lower(const char* text) {
+    ASTNode* root = parse_text(text);
+    if (!expect(root != NULL, "parse failed")) return false;
+    root = optimize_ast(root);
+    IRModule* ir = lower_to_ir(root);
+    optimize_ir(ir);
+    free_ir(ir);
+    free_ast(root);
+    return true;
+}
+
+
+static bool test_fold_int_min_division(void) {
+    int result = 0;
+    bool ok = expect(!eval_binop("/", INT_MIN, -1, &result), "INT_MIN / -1 was folded");
+    ok &= expect(eval_binop("+", INT_MAX, 1, &result) && result == INT_MIN, "INT_MAX + 1 does not wrap");
+    ok &= expect(eval_binop("*", 65536, 65536, &result) && result == 0, "65536 * 65536 does not wrap");
+    ok &= optimize_and_lower(
+        "int main() {\n"
+        "    int m = 0 - 2147483647 - 1;\n"
+        "    int n = 0 - 1;\n"
+        "    int c = m / n;\n"
+        "    return c;\n"
+        "}\n");
+    return ok;
+}
+
+
+// First node of the given kind, and value when not NULL, in print_ast() order
+static ASTNode* find_node(ASTNode* node, NodeType type, const char* value) {
+    if (!node) return NULL;
+    if (node->type == type && (!value || (node->value && strcmp(node->value, value) == 0))) return node;
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        ASTNode* found = find_node(node->child[i], type, value);
+        if (found) return found;
+    }
+    return find_node(node->next, type, value);
+}
+
+
+static bool is_int_value(ASTNode* node, int value) {
+    return node && node->type == NODE_INT && atoi(node->value) == value;
+}
+
+
+static bool test_unroll_exit_value(void) {
+    ASTNode* root = optimize_ast(parse_text(
+        "int main() {\n"
+        "    int i = 7;\n"
+        "    for (i = 0; i < 3; i++) {\n"
+        "        if (0) {\n"
+        "            printf(\"%d\", i);\n"
+        "        }\n"
+        "    }\n"
+        "    int j = 0;\n"
+        "    for (j = 10; j > 3; j = j - 2) {\n"
+        "        if (0) {\n"
+        "            printf(\"%d\", j);\n"
+        "        }\n"
+        "    }\n"
+        "    printf(\"%d %d\\n\", i, j);\n"
+        "    return 0;\n"
+        "}\n"));
+    if (!expect(root != NULL, "parse failed")) return false;
+    bool ok = expect(!find_node(root, NODE_FOR, NULL), "loops not unrolled");
+    ASTNode* i = find_node(root, NODE_ASSIGN, "i");
+    ASTNode* j = find_node(root, NODE_ASSIGN, "j");
+    ok &= expect(i && is_int_value(i->left, 3), "emptied loop leaves i at its start value");
+    ok &= expect(j && is_int_value(j->left, 2), "emptied loop counting down leaves j at its start value");
+    free_ast(root);
+    return ok;
+}
+
+
+// The loop `skip` loops after the first one in print_ast() order
+static ASTNode* nth_loop(ASTNode* node, int* skip) {
+    if (!node) return NULL;
+    if (node->type == NODE_FOR && (*skip)-- == 0) return node;
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        ASTNode* found = nth_loop(node->child[i], skip);
+        if (found) return found;
+    }
+    return nth_loop(node->next, skip);
+}
+
+
+static bool test_cfg_finds_unreachable_code(void) {
+    const char* text =
+        "int f(int n) {\n"
+        "    int s = 0;\n"
+        "    int a = 0;\n"
+        "    int b = 0;\n"
+        "    int c = 0;\n"
+        "    int d = 0;\n"
+        "    if (n > 0) {\n"
+        "        s = 1;\n"
+        "        return s;\n"
+        "        a = 1;\n"
+        "    }\n"
+        "    for (int i = 0; 0; i++) {\n"
+        "        b = 2;\n"
+        "    }\n"
+        "    for (int i = 0; 1; i++) {\n"
+        "        if (i > n) {\n"
+        "            return i;\n"
+        "        }\n"
+        "    }\n"
+        "    c = 3;\n"
+        "    return a + b + c + d;\n"
+        "}\n";
+    ASTNode* root = parse_text(text);
+    if (!expect(root != NULL, "parse failed")) return false;
+    CFG* cfg = build_cfg(root);
+    ASTNode* first_if = find_node(root, NODE_IF, NULL);
+    ASTNode* early = find_node(first_if, NODE_ASSIGN, "s");
+
+    bool ok = expect(!cfg_reachable(cfg, find_node(root, NODE_ASSIGN, "a")), "statement after a return reachable");
+    ok &= expect(!cfg_reachable(cfg, find_node(root, NODE_ASSIGN, "b")), "body of a loop that never runs reachable");
+    ok &= expect(!cfg_reachable(cfg, find_node(root, NODE_ASSIGN, "c")), "statement after an endless loop reachable");
+    ok &= expect(cfg_reachable(cfg, early), "statement before a return unreachable");
+    ok &= expect(cfg_dominates(cfg, find_node(root, NODE_DECL, "d"), early), "declaration does not dominate the if");
+    ok &= expect(!cfg_dominates(cfg, early, find_node(root, NODE_FOR, NULL)), "if body dominates what follows the if");
+    free_cfg(cfg);
+    free_ast(root);
+
+    root = optimize_ast(parse_text(text));
+    ok &= expect(!find_node(root, NODE_ASSIGN, "a") && !find_node(root, NODE_ASSIGN, "b") &&
+                 !find_node(root, NODE_ASSIGN, "c"), "unreachable assignments not removed");
+    first_if = find_node(root, NODE_IF, NULL);
+    ok &= expect(first_if && find_node(first_if->right, NODE_RETURN, NULL), "early return removed");
+    free_ast(root);
+    return ok;
+}
+
+
+static bool count_node(ASTNode* node, void* data) {
+    (void)node;
+    (*(int*)data)++;
+    return true;
+}
+
+
+static bool skip_children(ASTNode* node, void* data) {
+    (void)node;
+    (void)data;
+    return false;
+}
+
+
+static bool count_and_stop(ASTNode* node, void* data) {
+    (void)node;
+    (*(int*)data)++;
+    return false;
+}
+
+
+static ASTNode* replace_n(ASTNode* node, void* data) {
+    (void)data;
+    if (strcmp(node->value, "n") != 0) return node;
+    ASTNode* constant = make_int_node(4);
+    free_ast(node);
+    return constant;
+}
+
+
+static ASTNode* drop_node(ASTNode* node, void* data) {
+    (void)data;
+    free_ast(node);
+    return NULL;
+}
+
+
+static bool test_visitor_dispatch_and_masks(void) {
+    ASTNode* root = parse_text(
+        "int f(int n) {\n"
+        "    int s = n + 1;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n"
+        "int g(int n) {\n"
+        "    return n * 2;\n"
+        "}\n");
+    if (!expect(root != NULL, "parse failed")) return false;
+    ast_update_kinds(root);
+    ASTNode* g = root->next;
+
+    int vars = 0;
+    Visitor all_vars = { .pre[NODE_VAR] = count_node, .data = &vars };
+    visit_ast(root, &all_vars);
+    bool ok = expect(vars == 8, "not every variable visited");
+
+    int functions = 0;
+    Visitor loops_only = { .pre[NODE_FUNC_DEF] = count_node, .needs = AST_KIND(NODE_FOR), .data = &functions };
+    visit_ast(root, &loops_only);
+    ok &= expect(functions == 1, "function without loops not skipped");
+
+    int outside = 0;
+    Visitor no_loops = { .pre[NODE_VAR] = count_node, .pre[NODE_FOR] = skip_children, .data = &outside };
+    visit_ast(root, &no_loops);
+    ok &= expect(outside == 3, "children of a node whose pre callback said no visited");
+
+    int first = 0;
+    Visitor stop = { .post[NODE_VAR] = count_and_stop, .data = &first };
+    visit_ast(root, &stop);
+    ok &= expect(first == 1, "walk went on after a post callback ended it");
+
+    Rewriter constants = { .post[NODE_VAR] = replace_n };
+    root = rewrite_ast(root, &constants);
+    ok &= expect(!find_node(root, NODE_VAR, "n"), "variable not replaced");
+    ok &= expect(!ast_may_contain(g, NODE_VAR) && ast_may_contain(root, NODE_VAR), "masks not updated after a rewrite");
+
+    Rewriter drop_loops = { .pre[NODE_FOR] = drop_node };
+    root = rewrite_ast(root, &drop_loops);
+    ok &= expect(!find_node(root, NODE_FOR, NULL) && !ast_may_contain(root, NODE_FOR) &&
+                 find_node(root, NODE_RETURN, NULL), "dropped loop still in the tree or its mask");
+    free_ast(root);
+    return ok;
+}
+
+
+// Whether one of the phi's incoming values is the constant `value`
+static bool phi_takes(IRFunction* fn, IRInstr* phi, int value) {
+    for (int k = 1; k < phi->nargs; k += 2) {
+        IRInstr* from = &fn->instrs[fn->operands[phi->args + k]];
+        if (from->op == IR_CONST && from->imm == value) return true;
+    }
+    return false;
+}
+
+
+/* Phis go where values merge and only for variables live across blocks:
+   i and s at the loop header, t after the if, none for n or u. */
+static bool test_ssa_places_phis(void) {
+    ASTNode* root = parse_text(
+        "int f(int n) {\n"
+        "    int s = 0;\n"
+        "    int t = 5;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        int u = s * 2;\n"
+        "        printf(\"%d\\n\", u);\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    if (n > 3) {\n"
+        "        t = 7;\n"
+        "    }\n"
+        "    return s + t;\n"
+        "}\n");
+    if (!expect(root != NULL, "parse failed")) return false;
+    IRModule* module = lower_to_ir(root);
+    IRFunction* fn = &module->functions[0];
+
+    int phis = 0;
+    int header_phis = 0;
+    int join_phis = 0;
+    bool ok = true;
+    for (int b = 0; b < fn->block_count; b++) {
+        IRBlock* block = &fn->blocks[b];
+        int here = 0;
+        bool from_start = true;
+        bool from_if = true;
+        for (int i = block->first; i < block->first + block->count && fn->instrs[i].op == IR_PHI; i++) {
+            IRInstr* phi = &fn->instrs[i];
+            ok &= expect(phi->nargs == 4, "phi without one entry per predecessor");
+            from_start &= phi_takes(fn, phi, 0);
+            from_if &= phi_takes(fn, phi, 5) && phi_takes(fn, phi, 7);
+            here++;
+        }
+        phis += here;
+        if (here == 2 && from_start) header_phis++;
+        if (here == 1 && from_if) join_phis++;
+    }
+    ok &= expect(phis == 3, "phis placed for values that do not merge");
+    ok &= expect(header_phis == 1, "loop header lacks phis for i and s");
+    ok &= expect(join_phis == 1, "join after the if lacks a phi for t");
+
+    free_ir(module);
+    free_ast(root);
+    return ok;
+}
+
+
+// Values printf() is given after its format, INT_MIN where one is not a constant
+static int printed_values(ASTNode* node, int* values, int count, int max) {
+    for (; node; node = node->next) {
+        if (node->type == NODE_FUNC_CALL && strcmp(node->value, "printf") == 0 && node->left) {
+            for (ASTNode* arg = node->left->next; arg && count < max; arg = arg->next) {
+                values[count++] = arg->left && arg->left->type == NODE_INT ? atoi(arg->left->value) : INT_MIN;
+            }
+        }
+        for (int i = 0; i < ast_slot_count(node->type); i++) {
+            count = printed_values(node->child[i], values, count, max);
+        }
+    }
+    return count;
+}
+
+
+static bool test_unroll_substitutes_induction_var(void) {
+    ASTNode* root = optimize_ast(parse_text(
+        "int main() {\n"
+        "    int x = 5;\n"
+        "    for (int i = 0; i < 3; i++) {\n"
+        "        printf(\"%d\\n\", i * 10 + x);\n"
+        "        int x = i * 2;\n"
+        "        printf(\"%d\\n\", x);\n"
+        "    }\n"
+        "    for (int i = 0; i < 40; i++) {\n"
+        "        printf(\"%d\\n\", i);\n"
+        "    }\n"
+        "    for (int i = 0; i < 3; i++) {\n"
+        "        printf(\"%d\\n\", i);\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n"));
+    if (!expect(root != NULL, "parse failed")) return false;
+
+    // The shadowed x is read before the copy's own x is declared
+    int expected[] = { 5, 0, 15, 2, 25, 4 };
+    int values[8];
+    int count = printed_values(root, values, 0, 8);
+    bool ok = expect(count == 8, "wrong number of printf arguments");
+    for (int k = 0; k < 6 && k < count; k++) {
+        ok &= expect(values[k] == expected[k], "unrolled copy does not print its iteration's constant");
+    }
+
+    int skip = 0;
+    ASTNode* kept = nth_loop(root, &skip);
+    ok &= expect(kept && is_int_value(kept->child[FOR_COND]->right, 40), "loop of 40 iterations unrolled");
+    skip = 1;
+    kept = nth_loop(root, &skip);
+    ok &= expect(kept && find_node(kept->child[FOR_BODY], NODE_ASSIGN, "i"),
+                 "loop whose body steps its induction variable unrolled");
+    free_ast(root);
+    return ok;
+}
+
+
+static bool loop_declares(ASTNode* root, int loop, const char* name) {
+    ASTNode* found = nth_loop(root, &loop);
+    return found && find_node(found->child[FOR_BODY], NODE_DECL, name);
+}
+
+
+static bool test_licm_keeps_shadowing_decls(void) {
+    ASTNode* root = optimize_ast(parse_text(
+        "int f(int t, int n) {\n"
+        "    int s = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        int t = n * 2;\n"
+        "        s = s + t;\n"
+        "    }\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        int u = n * 3;\n"
+        "        s = s + u;\n"
+        "    }\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        int k = n * 4;\n"
+        "        s = s + k;\n"
+        "    }\n"
+        "    int u = s;\n"
+        "    return s + t + u;\n"
+        "}\n"));
+    if (!expect(root != NULL, "parse failed")) return false;
+    bool ok = expect(loop_declares(root, 0, "t"), "declaration shadowing a parameter hoisted");
+    ok &= expect(loop_declares(root, 1, "u"), "declaration of a name declared after the loop hoisted");
+    ok &= expect(!loop_declares(root, 2, "k") && find_node(root, NODE_DECL, "k"),
+                 "declaration only used in the loop not hoisted");
+    free_ast(root);
+    return ok;
+}
+
+
+// Whether the body of the given loop still has an operator `op` in it
+static bool loop_computes(ASTNode* root, int loop, const char* op) {
+    ASTNode* found = nth_loop(root, &loop);
+    return found && find_node(found->child[FOR_BODY], NODE_BINOP, op);
+}
+
+
+static bool test_licm_moves_only_invariants(void) {
+    ASTNode* root = optimize_ast(parse_text(
+        "int f(int n, int m) {\n"
+        "    int s = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        s = s + n * m;\n"
+        "    }\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        s = s + s * m;\n"
+        "    }\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        if (i > 2) {\n"
+        "            int m = i;\n"
+        "            s = s + m;\n"
+        "        }\n"
+        "        s = s + n * m;\n"
+        "    }\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        s = s + n / m;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n"));
+    if (!expect(root != NULL, "parse failed")) return false;
+    int first = 0;
+    ASTNode* loop = nth_loop(root, &first);
+    bool ok = expect(!loop_computes(root, 0, "*") && find_node(root, NODE_DECL, "licm0") &&
+                     find_node(loop->child[FOR_BODY], NODE_VAR, "licm0"),
+                     "invariant product not hoisted out of its loop");
+    ok &= expect(loop_computes(root, 1, "*"), "product reading a variable the loop writes hoisted");
+    ok &= expect(loop_computes(root, 2, "*"), "product reading a name the loop redeclares hoisted");
+    ok &= expect(loop_computes(root, 3, "/"), "division hoisted out of a loop that may not run");
+    free_ast(root);
+    return ok;
+}
+
+
+static bool test_print_marks_empty_loop_slots(void) {
+    ASTNode* root = optimize_ast(parse_text(
+        "int count(int n) {\n"
+        "    int i = 0;\n"
+        "    for (i = 0; i < n; i++) {\n"
+        "        if (0) {\n"
+        "            printf(\"%d\\n\", i);\n"
+        "        }\n"
+        "    }\n"
+        "    return i;\n"
+        "}\n"));
+    if (!expect(root != NULL, "parse failed")) return false;
+
+    char* text = NULL;
+    size_t length = 0;
+    FILE* output = open_memstream(&text, &length);
+    print_ast(find_node(root, NODE_FOR, NULL), output, 0);
+    fclose(output);
+
+    // regen reads the slots by position, so the missing body must show
+    bool ok = expect(strcmp(text,
+        "FOR_STMT\n"
+        "  ASSIGNMENT (i)\n"
+        "    INT (0)\n"
+        "  BINARY_EXPR (<)\n"
+        "    VAR (i)\n"
+        "    VAR (n)\n"
+        "  UNARY_EXPR (++)\n"
+        "    VAR (i)\n"
+        "  " AST_EMPTY_SLOT "\n") == 0, "empty loop body not printed as a placeholder");
+    free(text);
+    free_ast(root);
+    return ok;
+}
+
+
+static int count_loops(ASTNode* node) {
+    int count = 0;
+    for (; node; node = node->next) {
+        if (node->type == NODE_FOR) count++;
+        for (int i = 0; i < ast_slot_count(node->type); i++) {
+            count += count_loops(node->child[i]);
+        }
+    }
+    return count;
+}
+
+
+static int loops_in(ASTNode* root, const char* function) {
+    ASTNode* found = find_node(root, NODE_FUNC_DEF, function);
+    return found ? count_loops(found->left) : -1;
+}
+
+
+static bool test_fusion_and_fission(void) {
+    ASTNode* root = optimize_ast(parse_text(
+        "int fused(int n) {\n"
+        "    int a = 0;\n"
+        "    int b = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        a = a + i;\n"
+        "    }\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        b = b + i * 2;\n"
+        "    }\n"
+        "    return a + b;\n"
+        "}\n"
+        "int carried(int n) {\n"
+        "    int s = 0;\n"
+        "    int t = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        t = t + s;\n"
+        "    }\n"
+        "    return t;\n"
+        "}\n"
+        "int ranges(int n) {\n"
+        "    int a = 0;\n"
+        "    int b = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        a = a + i;\n"
+        "    }\n"
+        "    for (int i = 0; i <= n; i++) {\n"
+        "        b = b + i;\n"
+        "    }\n"
+        "    return a + b;\n"
+        "}\n"
+        "int split(int n) {\n"
+        "    int s = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        printf(\"%d\\n\", i);\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n"
+        "int tied(int n) {\n"
+        "    int s = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        s = s + i;\n"
+        "        printf(\"%d\\n\", s);\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n"));
+    if (!expect(root != NULL, "parse failed")) return false;
+    bool ok = expect(loops_in(root, "fused") == 1, "independent loops over one range not fused");
+    ok &= expect(loops_in(root, "carried") == 2, "loop reading what the one before it computes fused");
+    ok &= expect(loops_in(root, "ranges") == 2, "loops over different ranges fused");
+    ok &= expect(loops_in(root, "split") == 2, "call-free work not split from a call");
+    ok &= expect(loops_in(root, "tied") == 1, "statement split from the call that reads it");
+    free_ast(root);
+    return ok;
+}
+
+
+static const LoopVar* loop_var(const LoopDeps* deps, const char* name) {
+    for (int i = 0; i < deps->var_count; i++) {
+        if (strcmp(deps->vars[i].name, name) == 0) return &deps->vars[i];
+    }
+    return NULL;
+}
+
+
+static bool has_kind(const LoopDeps* deps, const char* name, LoopVarKind kind, const char* op) {
+    const LoopVar* var = loop_var(deps, name);
+    return var && var->kind == kind && (!op || (var->op && strcmp(var->op, op) == 0));
+}
+
+
+static bool test_dependence_classifies_loop_vars(void) {
+    ASTNode* root = parse_text(
+        "int f(int n) {\n"
+        "    int s = 0;\n"
+        "    int p = 1;\n"
+        "    int c = 0;\n"
+        "    int last = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        int t = i * 2;\n"
+        "        s = s + t;\n"
+        "        p = p * i;\n"
+        "        c = c + last;\n"
+        "        last = i;\n"
+        "        printf(\"%d\\n\", t);\n"
+        "    }\n"
+        "    for (int j = 0; j == n; j++) {\n"
+        "        s = s - j;\n"
+        "    }\n"
+        "    return s + p + c;\n"
+        "}\n");
+    if (!expect(root != NULL, "parse failed")) return false;
+    int skip = 0;
+    ASTNode* loop = nth_loop(root, &skip);
+    LoopDeps deps;
+    bool ok = expect(analyze_loop(loop, &deps), "loop not analyzed");
+    ok &= expect(deps.induction && strcmp(deps.induction, "i") == 0 && deps.step == 1 &&
+                 has_kind(&deps, "i", LOOP_VAR_INDUCTION, NULL), "induction variable not found");
+    ok &= expect(has_kind(&deps, "t", LOOP_VAR_PRIVATE, NULL), "body declaration not private");
+    ok &= expect(has_kind(&deps, "s", LOOP_VAR_REDUCTION, "+"), "sum not a reduction");
+    ok &= expect(has_kind(&deps, "p", LOOP_VAR_REDUCTION, "*"), "product not a reduction");
+    ok &= expect(has_kind(&deps, "last", LOOP_VAR_CARRIED, NULL), "value read by the next iteration not carried");
+    ok &= expect(deps.var_count == 6, "wrong number of loop variables");
+    free_loop_deps(&deps);
+
+    skip = 1;
+    ok &= expect(analyze_loop(nth_loop(root, &skip), &deps) && !deps.induction &&
+                 has_kind(&deps, "s", LOOP_VAR_REDUCTION, "+"), "loop testing == given an induction variable");
+    free_loop_deps(&deps);
+
+    // Facts are cached until a rewrite says otherwise
+    ASTNode* body = loop->child[FOR_BODY];
+    const DefUse* facts = def_use(body);
+    ok &= expect(facts->calls && !facts->returns && name_set_has(&facts->decls, "t") &&
+                 name_set_has(&facts->reads, "last") && !name_set_has(&facts->reads, "n"),
+                 "wrong def/use facts for the loop body");
+    ok &= expect(def_use(body) == facts, "def/use facts not cached");
+    ast_set_value(find_node(body, NODE_ASSIGN, "last"), "q");
+    dependence_invalidate();
+    facts = def_use(body);
+    ok &= expect(name_set_has(&facts->writes, "q") && !name_set_has(&facts->writes, "last"),
+                 "def/use facts not recomputed after a rewrite");
+
+    dependence_reset();
+    free_ast(root);
+    return ok;
+}
+
+
+static bool loop_marked_simd(ASTNode* root, int loop) {
+    ASTNode* found = nth_loop(root, &loop);
+    return found && found->value && strncmp(found->value, "simd", 4) == 0;
+}
+
+
+static bool test_simd_needs_canonical_test(void) {
+    ASTNode* root = optimize_ast(parse_text(
+        "int f(int n) {\n"
+        "    int s = 0;\n"
+        "    for (int i = 0; i == n; i++) {\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    for (int i = 0; i < i + n; i++) {\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    for (int i = 0; i != n; i = i + 2) {\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    for (int i = 0; i != n; i++) {\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    for (int i = n; i >= 0; i--) {\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n"));
+    if (!expect(root != NULL, "parse failed")) return false;
+    bool ok = expect(!loop_marked_simd(root, 0), "loop testing == marked");
+    ok &= expect(!loop_marked_simd(root, 1), "loop whose bound reads the induction variable marked");
+    ok &= expect(!loop_marked_simd(root, 2), "loop testing != with a step of 2 marked");
+    ok &= expect(loop_marked_simd(root, 3), "loop testing != with a step of 1 not marked");
+    ok &= expect(loop_marked_simd(root, 4), "loop counting down not marked");
+    free_ast(root);
+    return ok;
+}
+
+
+static ASTStore* store_program(const char* text) {
+    ASTNode* root = parse_text(text);
+    ASTStore* store = ast_store_from_tree(root);
+    free_ast(root);
+    return store;
+}
+
+
+static uint32_t find_entry(const ASTStore* store, NodeType kind, int nth) {
+    for (uint32_t i = 0; i < store->count; i++) {
+        if (store->kinds[i] == kind && nth-- == 0) return i;
+    }
+    return AST_NONE;
+}
+
+
+// Whether ast_store_read() accepts what ast_store_write() makes of `store`
+static bool store_reads_back(const ASTStore* store) {
+    char* buffer = NULL;
+    size_t length = 0;
+    FILE* output = open_memstream(&buffer, &length);
+    ast_store_write(store, output);
+    fclose(output);
+
+    FILE* input = fmemopen(buffer, length, "rb");
+    ASTStore* read = ast_store_read(input);
+    fclose(input);
+    free(buffer);
+
+    bool accepted = read != NULL;
+    if (read) {
+        // What was accepted must also load
+        free_ast(ast_store_to_tree(read, 0));
+        free_ast_store(read);
+    }
+    return accepted;
+}
+
+
+static bool test_store_rejects_missing_value(void) {
+    ASTStore* store = store_program("int main() { return 1 + 2; }\n");
+    bool ok = expect(store_reads_back(store), "valid store rejected");
+    store->payloads[find_entry(store, NODE_BINOP, 0)] = AST_NONE;
+    ok &= expect(!store_reads_back(store), "BINOP without an operator accepted");
+    free_ast_store(store);
+    return ok;
+}
+
+
+static bool test_store_rejects_bad_slot(void) {
+    ASTStore* store = store_program("int main() { return 1; }\n");
+    uint32_t value = store->first_child[find_entry(store, NODE_RETURN, 0)];
+    store->flags[value] = AST_SLOT_START | 1;
+    bool ok = expect(!store_reads_back(store), "RETURN child in slot 1 accepted");
+    free_ast_store(store);
+
+    store = store_program("int main() { return 1 + 2; }\n");
+    uint32_t left = store->first_child[find_entry(store, NODE_BINOP, 0)];
+    store->flags[store->next_sibling[left]] = AST_SLOT_START;
+    ok &= expect(!store_reads_back(store), "two chains in slot 0 accepted");
+    free_ast_store(store);
+    return ok;
+}
+
+
+static bool test_store_rejects_shared_node(void) {
+    ASTStore* store = store_program("int main() { int a = 1; int b = 2; return a; }\n");
+    uint32_t a = find_entry(store, NODE_DECL, 0);
+    uint32_t b = find_entry(store, NODE_DECL, 1);
+    store->first_child[a] = store->first_child[b];
+    bool ok = expect(!store_reads_back(store), "node with two parents accepted");
+    free_ast_store(store);
+    return ok;
+}
+
+
+// Operands that eval_binop() refuses must stay unfolded in both
+static bool test_store_folds_like_tree(void) {
+    const char* text =
+        "int main() {\n"
+        "    int a = 2 * 3 + 4;\n"
+        "    int b = 1 + 2 * a - 1;\n"
+        "    int c = 7 / 0;\n"
+        "    int d = 0 - 2147483647 - 1;\n"
+        "    for (int i = 0; i < 2 * 5; i++) {\n"
+        "        printf(\"%d\\n\", i * 4 - 2 + 10 / 3);\n"
+        "    }\n"
+        "    return a + b + c + d;\n"
+        "}\n";
+    ASTStore* store = store_program(text);
+    uint32_t folded = ast_store_fold_constants(store);
+    ast_store_compact(store);
+    ASTNode* from_store = ast_store_to_tree(store, 0);
+
+    reset_opt_stats();
+    ASTNode* root = fold_constants(parse_text(text));
+    OptStats stats;
+    get_opt_stats(&stats);
+    ASTStore* expected = ast_store_from_tree(root);
+
+    char* tree = tree_text(root);
+    char* scanned = tree_text(from_store);
+    bool ok = expect(strcmp(scanned, tree) == 0, "store folding differs from fold_constants()");
+    ok &= expect(folded == stats.folded && folded == 6, "wrong number of operators folded");
+    ok &= expect(store->count == expected->count, "compaction left orphaned nodes");
+    ok &= expect(store_reads_back(store), "compacted store rejected");
+    free(tree);
+    free(scanned);
+    free_ast(root);
+    free_ast(from_store);
+    free_ast_store(expected);
+    free_ast_store(store);
+    return ok;
+}
+
+
+// How many functions of `text` the cache at `path` would hand back
+static int cache_hits(const char* text, const char* path) {
+    ASTNode* functions[8];
+    ASTNode** slots[8];
+    int count = 0;
+    ASTNode* node = parse_text(text);
+    while (node && count < 8) {
+        functions[count] = node;
+        slots[count] = &functions[count];
+        node = node->next;
+        functions[count++]->next = NULL;
+    }
+    OptCache* cache = open_opt_cache(path, slots, count);
+    int hits = 0;
+    for (int i = 0; i < count; i++) {
+        if (opt_cache_hit(cache, i)) hits++;
+    }
+    free_opt_cache(cache);
+    for (int i = 0; i < count; i++) {
+        free_ast(functions[i]);
+    }
+    return hits;
+}
+
+
+// Fills `path` with the name of a file that does not exist yet
+static bool temp_path(char* path) {
+    int fd = mkstemp(path);
+    if (!expect(fd >= 0, "no temporary file")) return false;
+    close(fd);
+    remove(path);
+    return true;
+}
+
+
+static bool test_cache_reuses_lone_function(void) {
+    const char* text =
+        "int main() {\n"
+        "    int s = 0;\n"
+        "    for (int i = 0; i < 4; i++) {\n"
+        "        s = s + i * 2;\n"
+        "    }\n"
+        "    printf(\"%d\\n\", s);\n"
+        "    return 0;\n"
+        "}\n";
+    char path[] = "/tmp/tests_cache_XXXXXX";
+    if (!temp_path(path)) return false;
+
+    ASTNode* root = optimize_ast(parse_text(text));
+    char* uncached = tree_text(root);
+    free_ast(root);
+
+    root = optimize_ast_cached(parse_text(text), path);
+    char* cold = tree_text(root);
+    free_ast(root);
+    bool ok = expect(cache_hits(text, path) == 1, "lone function not cached");
+
+    root = optimize_ast_cached(parse_text(text), path);
+    char* warm = tree_text(root);
+    free_ast(root);
+    ok &= expect(strcmp(cold, uncached) == 0, "cold run differs from an uncached one");
+    ok &= expect(strcmp(warm, uncached) == 0, "cached tree differs from an uncached one");
+    free(uncached);
+    free(cold);
+    free(warm);
+    remove(path);
+    return ok;
+}
+
+
+static bool test_cache_rejects_corruption(void) {
+    const char* text = "int twice(int x) { return x * 2; }\nint main() { return twice(21); }\n";
+    char path[] = "/tmp/tests_cache_XXXXXX";
+    if (!temp_path(path)) return false;
+
+    free_ast(optimize_ast_cached(parse_text(text), path));
+    bool ok = expect(cache_hits(text, path) == 2, "cache not used on an unchanged program");
+
+    // The last byte is part of a stored tree, not of anything read_entry() checks
+    FILE* file = fopen(path, "r+b");
+    fseek(file, -1, SEEK_END);
+    int byte = fgetc(file);
+    fseek(file, -1, SEEK_END);
+    fputc(byte ^ 1, file);
+    fclose(file);
+    ok &= expect(cache_hits(text, path) == 0, "corrupted cache used");
+
+    free_ast(optimize_ast_cached(parse_text(text), path));
+    ok &= expect(cache_hits(text, path) == 2, "corrupted cache not rewritten by a cold run");
+    remove(path);
+    return ok;
+}
+
+
+static const Test tests[] = {
+    { "fold_int_min_division", test_fold_int_min_division },
+    { "unroll_exit_value", test_unroll_exit_value },
+    { "unroll_substitutes_induction_var", test_unroll_substitutes_induction_var },
+    { "licm_keeps_shadowing_decls", test_licm_keeps_shadowing_decls },
+    { "licm_moves_only_invariants", test_licm_moves_only_invariants },
+    { "print_marks_empty_loop_slots", test_print_marks_empty_loop_slots },
+    { "fusion_and_fission", test_fusion_and_fission },
+    { "dependence_classifies_loop_vars", test_dependence_classifies_loop_vars },
+    { "visitor_dispatch_and_masks", test_visitor_dispatch_and_masks },
+    { "cfg_finds_unreachable_code", test_cfg_finds_unreachable_code },
+    { "ssa_places_phis", test_ssa_places_phis },
+    { "simd_needs_canonical_test", test_simd_needs_canonical_test },
+    { "store_rejects_missing_value", test_store_rejects_missing_value },
+    { "store_rejects_bad_slot", test_store_rejects_bad_slot },
+    { "store_rejects_shared_node", test_store_rejects_shared_node },
+    { "store_folds_like_tree", test_store_folds_like_tree },
+    { "cache_reuses_lone_function", test_cache_reuses_lone_function },
+    { "cache_rejects_corruption", test_cache_rejects_corruption },
+};
+
+
+int main(void) {
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        bool passed = tests[i].run();
+        printf("%-32s %s\n", tests[i].name, passed ? "ok" : "FAILED");
+        if (!passed) failures++;
+    }
+    if (report_mem_leaks(stderr, "tests")) failures++;
+    return failures;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "visitor.h"
+
+
+/* With `trust`, children that already have a mask are taken at their word
+   and only freshly built nodes are scanned. */
+static uint32_t compute_kinds(ASTNode* node, bool trust) {
+    uint32_t kinds = AST_KIND(node->type);
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        for (ASTNode* child = node->child[i]; child; child = child->next) {
+            kinds |= trust && child->kinds ? child->kinds : compute_kinds(child, trust);
+        }
+    }
+    node->kinds = kinds;
+    return kinds;
+}
+
+
+void ast_update_kinds(ASTNode* node) {
+    for (; node; node = node->next) {
+        compute_kinds(node, false);
+    }
+}
+
+
+bool ast_may_contain(ASTNode* node, NodeType type) {
+    return node && (!node->kinds || (node->kinds & AST_KIND(type)));
+}
+
+
+static bool visit_node(ASTNode* node, const Visitor* visitor, uint32_t needs) {
+    if (node->kinds && !(node->kinds & needs)) return true;
+
+    VisitFn pre = visitor->pre[node->type];
+    if (!pre || pre(node, visitor->data)) {
+        for (int i = 0; i < ast_slot_count(node->type); i++) {
+            for (ASTNode* child = node->child[i]; child; child = child->next) {
+                if (!visit_node(child, visitor, needs)) return false;
+            }
+        }
+    }
+
+    VisitFn post = visitor->post[node->type];
+    return !post || post(node, visitor->data);
+}
+
+
+void visit_ast(ASTNode* root, const Visitor* visitor) {
+    uint32_t needs = visitor->needs;
+    for (int k = 0; k < AST_KIND_COUNT && !visitor->needs; k++) {
+        if (visitor->pre[k] || visitor->post[k]) needs |= AST_KIND(k);
+    }
+
+    for (; root; root = root->next) {
+        if (!visit_node(root, visitor, needs)) return;
+    }
+}
+
+
+static ASTNode* rewrite_list(ASTNode* node, const Rewriter* rewriter, uint32_t needs);
+
+
+static ASTNode* finish_node(ASTNode* node, const Rewriter* rewriter, uint32_t needs) {
+    for (int i = 0; i < ast_slot_count(node->type); i++) {
+        node->child[i] = rewrite_list(node->child[i], rewriter, needs);
+    }
+
+    RewriteFn post = rewriter->post[node->type];
+    if (post) node = post(node, rewriter->data);
+    for (ASTNode* result = node; result; result = result->next) {
+        compute_kinds(result, true);
+    }
+    return node;
+}
+
+
+static ASTNode* rewrite_node(ASTNode* node, const Rewriter* rewriter, uint32_t needs) {
+    if (node->kinds && !(node->kinds & needs)) return node;
+
+    RewriteFn pre = rewriter->pre[node->type];
+    if (!pre) return finish_node(node, rewriter, needs);
+
+    ASTNode* head = NULL;
+    ASTNode** tail = &head;
+    ASTNode* replaced = pre(node, rewriter->data);
+    while (replaced) {
+        ASTNode* next = replaced->next;
+        replaced->next = NULL;
+        *tail = finish_node(replaced, rewriter, needs);
+        while (*tail) tail = &(*tail)->next;
+        replaced = next;
+    }
+    return head;
+}
+
+
+static ASTNode* rewrite_list(ASTNode* node, const Rewriter* rewriter, uint32_t needs) {
+    ASTNode* head = NULL;
+    ASTNode** tail = &head;
+    while (node) {
+        ASTNode* next = node->next;
+        node->next = NULL;
+        *tail = rewrite_node(node, rewriter, needs);
+        while (*tail) tail = &(*tail)->next;
+        node = next;
+    }
+    return head;
+}
+
+
+ASTNode* rewrite_ast(ASTNode* root, const Rewriter* rewriter) {
+    uint32_t needs = rewriter->needs;
+    for (int k = 0; k < AST_KIND_COUNT && !rewriter->needs; k++) {
+        if (rewriter->pre[k] || rewriter->post[k]) needs |= AST_KIND(k);
+    }
+    return rewrite_list(root, rewriter, needs);
+}
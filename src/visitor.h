@@ -0,0 +1,56 @@
+#ifndef VISITOR_H
+#define VISITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ast.h"
+
+
+#define AST_KIND_COUNT (NODE_ASSIGN + 1)
+#define AST_KIND(type) ((uint32_t)1 << (type))
+
+_Static_assert(AST_KIND_COUNT <= 16, "ASTNode.kinds has one bit per kind");
+
+
+/* Walks dispatch on the node kind through per-kind tables of callbacks
+   and skip every subtree that holds none of the kinds in `needs` (when 0,
+   the kinds that have a callback). Each node's `kinds` mask says what its
+   subtree holds. rewrite_ast() keeps the masks up to date for whatever it
+   walks. Code that edits children directly must call ast_update_kinds()
+   before the next walk if the edit can bring in new kinds. Nodes whose
+   mask was never computed are always scanned. */
+
+typedef bool (*VisitFn)(ASTNode* node, void* data);
+
+typedef struct {
+    VisitFn pre[AST_KIND_COUNT];    // return false to skip the node's children
+    VisitFn post[AST_KIND_COUNT];   // return false to end the walk
+    uint32_t needs;
+    void* data;
+} Visitor;
+
+
+/* Callbacks get the node detached from the list it is in and return its
+   replacement: the node itself, another tree, a list of several, or NULL
+   to drop it. The rest of the list is relinked after the result. */
+typedef ASTNode* (*RewriteFn)(ASTNode* node, void* data);
+
+typedef struct {
+    RewriteFn pre[AST_KIND_COUNT];  // before the children, which are those of the result
+    RewriteFn post[AST_KIND_COUNT];
+    uint32_t needs;
+    void* data;
+} Rewriter;
+
+
+void visit_ast(ASTNode* root, const Visitor* visitor);
+
+ASTNode* rewrite_ast(ASTNode* root, const Rewriter* rewriter);
+
+// False only when the mask is known and lacks `type`.
+bool ast_may_contain(ASTNode* node, NodeType type);
+
+// Recomputes the masks of `node`, everything below it and the list after it.
+void ast_update_kinds(ASTNode* node);
+
+#endif